@@ -0,0 +1,30 @@
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Không phụ thuộc Arduino để công cụ chạy trên máy tính (tools/) dùng chung.
+
+// Tham số vô tuyến (mặc định của thư viện LoRa), dùng để tính airtime
+#define LORA_SF           7
+#define LORA_BW_HZ        125000
+#define LORA_CR           1     // 4/5
+#define LORA_PREAMBLE_LEN 8
+#define LORA_CRC_ON       0
+
+// Thời gian phát một gói LoRa (µs), công thức Semtech AN1200.13,
+// header tường minh, low data rate optimize khi symbol > 16 ms
+inline uint32_t loraAirtimeUs(size_t frameLen) {
+    const uint32_t tSymUs = ((uint32_t)1 << LORA_SF) * 1000000UL / LORA_BW_HZ;
+    const int de = tSymUs > 16000 ? 1 : 0;
+    int num = 8 * (int)frameLen - 4 * LORA_SF + 28 + 16 * LORA_CRC_ON;
+    int den = 4 * (LORA_SF - 2 * de);
+    int payloadSymb = 8;
+    if (num > 0) payloadSymb += ((num + den - 1) / den) * (LORA_CR + 4);
+    // preamble + 4.25 symbol đồng bộ
+    uint32_t preambleUs = (LORA_PREAMBLE_LEN * 4 + 17) * tSymUs / 4;
+    return preambleUs + payloadSymb * tSymUs;
+}
+
+#endif
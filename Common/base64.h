@@ -0,0 +1,26 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Số ký tự base64 (không tính '\0') của len byte
+#define BASE64_LEN(len) (((len) + 2) / 3 * 4)
+
+// Mã hóa base64 chuẩn có padding, out cần BASE64_LEN(len) + 1 byte.
+// Dùng cho các frame lô nhị phân (khoảng chất lượng điện, sổ lịch sử).
+inline size_t base64Encode(const uint8_t* in, size_t len, char* out) {
+    static const char TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t n = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+        out[n++] = TABLE[v >> 18 & 63];
+        out[n++] = TABLE[v >> 12 & 63];
+        out[n++] = i + 1 < len ? TABLE[v >> 6 & 63] : '=';
+        out[n++] = i + 2 < len ? TABLE[v & 63] : '=';
+    }
+    out[n] = '\0';
+    return n;
+}
+
+#endif
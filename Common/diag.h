@@ -0,0 +1,140 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <Arduino.h>
+
+// Runtime diagnostics shared by the nodes and the Gateway: stack high-water
+// marks and CPU share of the watched tasks, heap headroom and fragmentation,
+// and a histogram of loop() iteration time. diagFormat() writes it as one
+// compact JSON object that fits a LoRa frame next to the node id:
+//
+//   {"up":86400,"hp":[free,min_free,max_block],"lp":[p50,p99,max],
+//    "tk":[["loop",hwm,cpu],...]}
+//
+// hp in KB (max_block far below free means a fragmented heap); lp in ms over
+// the window since the last report; hwm is the least free stack the task
+// ever had, in bytes, and cpu its % of one core since the last report, or -1
+// when FreeRTOS run-time stats are not compiled in. Three tasks fit in a
+// LoRa frame.
+#define DIAG_MAX_TASKS 4
+#define DIAG_LOOP_BOUNDS 12         // loop buckets <= 1, 2, 4 ... 2048 ms, then overflow
+
+#if defined(configGENERATE_RUN_TIME_STATS) && configGENERATE_RUN_TIME_STATS && \
+    defined(configUSE_TRACE_FACILITY) && configUSE_TRACE_FACILITY
+#define DIAG_RUNTIME_STATS 1
+#define DIAG_SYSTEM_TASKS_MAX 24    // ESP32 Arduino runs about 12-16 tasks
+#else
+#define DIAG_RUNTIME_STATS 0
+#endif
+
+struct DiagTask {
+    TaskHandle_t handle;
+    const char* name;       // short, it goes over the air
+    uint32_t runtimePrev;
+};
+
+struct Diag {
+    DiagTask tasks[DIAG_MAX_TASKS];
+    uint8_t numTasks;
+    uint32_t loopCounts[DIAG_LOOP_BOUNDS + 1];
+    uint32_t loopCount;
+    uint32_t loopMaxMs;
+    uint32_t lastTickUs;
+    uint32_t runtimeTotalPrev;
+};
+
+inline Diag& diag() {
+    static Diag d = {};
+    return d;
+}
+
+// Watch a task; handle NULL means the calling task (call from setup() to
+// watch loopTask, whose stack is CONFIG_ARDUINO_LOOP_STACK_SIZE, 8 KB)
+inline void diagWatchTask(TaskHandle_t handle, const char* name) {
+    Diag& d = diag();
+    if (d.numTasks >= DIAG_MAX_TASKS) return;
+    DiagTask& t = d.tasks[d.numTasks++];
+    t.handle = handle ? handle : xTaskGetCurrentTaskHandle();
+    t.name = name;
+    t.runtimePrev = 0;
+}
+
+// Call first thing in loop(): records the previous iteration
+inline void diagLoopTick() {
+    Diag& d = diag();
+    uint32_t now = micros();
+    if (d.lastTickUs) {
+        uint32_t ms = (now - d.lastTickUs) / 1000;
+        uint8_t i = 0;
+        while (i < DIAG_LOOP_BOUNDS && ms > (1UL << i)) i++;
+        d.loopCounts[i]++;
+        d.loopCount++;
+        if (ms > d.loopMaxMs) d.loopMaxMs = ms;
+    }
+    d.lastTickUs = now;
+}
+
+// Upper bound (ms) of the bucket holding the p-th percentile iteration
+inline uint32_t diagLoopPercentile(uint8_t p) {
+    Diag& d = diag();
+    if (!d.loopCount) return 0;
+    uint32_t rank = (d.loopCount * p + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < DIAG_LOOP_BOUNDS; i++) {
+        seen += d.loopCounts[i];
+        if (seen >= rank) return 1UL << i;
+    }
+    return d.loopMaxMs;
+}
+
+// CPU % of one core per watched task since the previous call, -1 if unknown
+inline void diagSampleCpu(int8_t* cpu) {
+    Diag& d = diag();
+    for (uint8_t i = 0; i < d.numTasks; i++) cpu[i] = -1;
+#if DIAG_RUNTIME_STATS
+    static TaskStatus_t status[DIAG_SYSTEM_TASKS_MAX];
+    uint32_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(status, DIAG_SYSTEM_TASKS_MAX, &total);
+    uint32_t elapsed = total - d.runtimeTotalPrev;
+    for (uint8_t i = 0; i < d.numTasks; i++) {
+        for (UBaseType_t k = 0; k < n; k++) {
+            if (status[k].xHandle != d.tasks[i].handle) continue;
+            uint32_t run = status[k].ulRunTimeCounter;
+            if (d.runtimeTotalPrev && elapsed) {
+                uint32_t pct = (uint32_t)((uint64_t)(run - d.tasks[i].runtimePrev) * 100 / elapsed);
+                cpu[i] = pct > 100 ? 100 : (int8_t)pct;
+            }
+            d.tasks[i].runtimePrev = run;
+        }
+    }
+    d.runtimeTotalPrev = total;
+#endif
+}
+
+// Write the diagnostics object (see top of file) and start a new loop
+// window. Returns the length, clamped to cap - 1.
+inline size_t diagFormat(char* out, size_t cap) {
+    Diag& d = diag();
+    int8_t cpu[DIAG_MAX_TASKS];
+    diagSampleCpu(cpu);
+
+    int n = snprintf(out, cap, "{\"up\":%lu,\"hp\":[%lu,%lu,%lu],\"lp\":[%lu,%lu,%lu],\"tk\":[",
+                     millis() / 1000, (unsigned long)ESP.getFreeHeap() / 1024,
+                     (unsigned long)ESP.getMinFreeHeap() / 1024, (unsigned long)ESP.getMaxAllocHeap() / 1024,
+                     (unsigned long)diagLoopPercentile(50), (unsigned long)diagLoopPercentile(99),
+                     (unsigned long)d.loopMaxMs);
+    for (uint8_t i = 0; i < d.numTasks && n > 0 && (size_t)n < cap; i++) {
+        const DiagTask& t = d.tasks[i];
+        n += snprintf(out + n, cap - n, "%s[\"%s\",%lu,%d]", i ? "," : "", t.name,
+                      (unsigned long)uxTaskGetStackHighWaterMark(t.handle), cpu[i]);
+    }
+    if (n > 0 && (size_t)n < cap) n += snprintf(out + n, cap - n, "]}");
+
+    memset(d.loopCounts, 0, sizeof(d.loopCounts));
+    d.loopCount = 0;
+    d.loopMaxMs = 0;
+    if (n < 0) return 0;
+    return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <Arduino.h>
+#include <LoRa.h>
+#include <string.h>
+#include "airtime.h"
+
+// Kích thước tối đa của payload một gói LoRa (không tính 2 byte địa chỉ)
+#define FRAME_PAYLOAD_MAX 128
+
+// View không sở hữu dữ liệu trên một payload đã nhận (kiểu string_view)
+struct MsgView {
+    const char* data;
+    size_t len;
+
+    bool equals(const char* literal) const {
+        size_t n = strlen(literal);
+        return n == len && memcmp(data, literal, n) == 0;
+    }
+};
+
+// Đọc phần còn lại của gói LoRa vào buffer cố định, luôn kết thúc bằng '\0'.
+// Byte vượt quá dung lượng sẽ bị bỏ qua nhưng vẫn được đọc hết khỏi FIFO.
+inline MsgView readLoRaPayload(char* buf, size_t cap) {
+    size_t n = 0;
+    while (LoRa.available()) {
+        int c = LoRa.read();
+        if (n + 1 < cap) buf[n++] = (char)c;
+    }
+    buf[n] = '\0';
+    return MsgView{buf, n};
+}
+
+// Bỏ qua phần còn lại của gói không dành cho mình
+inline void discardLoRaPayload() {
+    while (LoRa.available()) LoRa.read();
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef GATEWAYS_H
+#define GATEWAYS_H
+
+// Dải địa chỉ LoRa dành cho Gateway. Node nhận poll từ bất kỳ Gateway nào
+// trong dải và trả lời đúng Gateway vừa hỏi; Gateway nghe được frame gửi
+// cho Gateway khác thì vẫn chuyển lên backend, backend khử trùng lặp.
+// Mỗi node chỉ do một Gateway poll (GATEWAY_NODES): hai Gateway cùng poll
+// thì cùng một số đo ra hai frame khác seq, backend không gộp được.
+#define GATEWAY_ADDR_FIRST 10
+#define GATEWAY_ADDR_LAST  19
+
+// Node dùng địa chỉ 1..9
+#define NODE_ADDR_FIRST 1
+#define NODE_ADDR_LAST  (GATEWAY_ADDR_FIRST - 1)
+
+inline bool isGatewayAddress(int addr) {
+    return addr >= GATEWAY_ADDR_FIRST && addr <= GATEWAY_ADDR_LAST;
+}
+
+inline bool isNodeAddress(int addr) {
+    return addr >= NODE_ADDR_FIRST && addr <= NODE_ADDR_LAST;
+}
+
+// Địa chỉ của chính Gateway đang build (chỉ Gateway dùng) và các node nó
+// poll, Gateway thứ hai build với -DGATEWAY_ID=11 -DGATEWAY_NODES=3,4.
+// GATEWAY_NODE_VIA là relay của từng node theo cùng thứ tự (Gateway/main.cpp),
+// không định nghĩa thì mọi node đều nghe trực tiếp.
+#ifndef GATEWAY_ID
+#define GATEWAY_ID GATEWAY_ADDR_FIRST
+#endif
+#ifndef GATEWAY_NODES
+#define GATEWAY_NODES 1, 2
+#endif
+
+#define GATEWAY_STR2(x) #x
+#define GATEWAY_STR(x) GATEWAY_STR2(x)
+#define GATEWAY_NAME "gw_" GATEWAY_STR(GATEWAY_ID)
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <math.h>
+#include <string.h>
+#include "log.h"
+
+// Sổ lịch sử trên flash: mỗi HISTORY_INTERVAL_S node ghi số tích lũy hiện
+// tại của các kênh thành một bản ghi đánh số seq tăng dần từ 1, xoay vòng
+// trên một partition. Khi poll getData thất bại số liệu chưa commit chỉ còn
+// là tổng cộng dồn; sổ này giữ lại lúc nào đã dùng bao nhiêu để Gateway lấy
+// bù bằng lệnh history (nodeRuntime.h) khi liên lạc lại.
+//
+// Partition: nhãn "history" (type data) nếu bảng partition của node có,
+// không thì dùng partition SPIFFS của bảng mặc định (node không dùng
+// SPIFFS). 64 KB chứa khoảng 40 ngày, SPIFFS mặc định 1.4 MB hơn hai năm.
+//
+// Bản ghi 16 byte, 256 bản ghi mỗi sector 4 KB; bản ghi seq nằm ở ô
+// (seq - 1) % capacity. Sector được xóa khi ghi bản ghi đầu tiên của nó,
+// nên bản ghi cũ nhất mất theo từng sector. Trường seq ghi sau cùng: bản
+// ghi dở dang do mất điện có seq = 0xFFFFFFFF và bị coi là không có.
+// Chỉ ghi khi đồng hồ node đã đồng bộ với Gateway (ts là epoch UTC).
+
+#define HISTORY_INTERVAL_S    900
+#define HISTORY_CHANNELS      2
+#define HISTORY_SECTOR_SIZE   4096
+#define HISTORY_PARTITION     "history"
+
+struct HistoryRecord {
+    uint32_t seq;
+    uint32_t ts;
+    float v[HISTORY_CHANNELS];      // NAN nếu kênh không có
+};
+
+#define HISTORY_RECORDS_PER_SECTOR (HISTORY_SECTOR_SIZE / sizeof(HistoryRecord))
+
+static const uint32_t HISTORY_SEQ_ERASED = 0xFFFFFFFF;
+
+// Bản ghi khi gửi cho Gateway (lệnh history): 12 byte little-endian, ts
+// (u32) rồi giá trị từng kênh (float), seq suy ra từ vị trí trong frame.
+// Bản ghi không đọc được gửi với ts = 0.
+#define HISTORY_WIRE_BYTES    (4 + 4 * HISTORY_CHANNELS)
+
+// Bản ghi mỗi frame: {"nodeId":N,"h":<seq đầu>,"b":"<base64>"} dưới FRAME_PAYLOAD_MAX
+#define HISTORY_FRAME_RECORDS 5
+
+inline uint8_t* historyPut32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8 & 0xFF;
+    p[2] = v >> 16 & 0xFF;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+inline uint8_t* historyEncode(const HistoryRecord& record, uint8_t* out) {
+    out = historyPut32(out, record.ts);
+    for (int ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        uint32_t bits;
+        memcpy(&bits, &record.v[ch], sizeof(bits));
+        out = historyPut32(out, bits);
+    }
+    return out;
+}
+
+class HistoryLog {
+public:
+    // Tìm partition và bản ghi mới nhất. false nếu không có partition, khi
+    // đó node chạy bình thường nhưng không ghi sổ.
+    bool begin() {
+        part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, HISTORY_PARTITION);
+        if (!part_) part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+        if (!part_ || part_->size < 2 * HISTORY_SECTOR_SIZE) {
+            part_ = NULL;
+            LOGW(TAG_HIST, "No history partition, flash log disabled");
+            return false;
+        }
+        capacity_ = part_->size / HISTORY_SECTOR_SIZE * HISTORY_RECORDS_PER_SECTOR;
+        scan();
+        LOGI(TAG_HIST, "History %u records in %u KB, seq %lu..%lu", (unsigned)capacity_,
+             (unsigned)(part_->size / 1024), (unsigned long)first(), (unsigned long)last_);
+        return true;
+    }
+
+    // Đến lúc ghi bản ghi mới: đã sang khoảng HISTORY_INTERVAL_S khác với
+    // bản ghi mới nhất. epoch = 0 (chưa đồng bộ giờ) thì không bao giờ.
+    bool due(uint32_t epoch) const {
+        return part_ && epoch && epoch / HISTORY_INTERVAL_S != lastTs_ / HISTORY_INTERVAL_S;
+    }
+
+    void append(uint32_t epoch, const float* values) {
+        if (!part_) return;
+        uint32_t seq = last_ + 1;
+        size_t offset = slotOffset(seq);
+        if (offset % HISTORY_SECTOR_SIZE == 0 &&
+            esp_partition_erase_range(part_, offset, HISTORY_SECTOR_SIZE) != ESP_OK) {
+            LOGE(TAG_HIST, "Erase of sector at %u failed", (unsigned)offset);
+            return;
+        }
+
+        HistoryRecord record;
+        record.seq = seq;
+        record.ts = epoch;
+        memcpy(record.v, values, sizeof(record.v));
+        // Phần dữ liệu trước, seq sau cùng
+        const size_t body = sizeof(record.seq);
+        if (esp_partition_write(part_, offset + body, (const uint8_t*)&record + body, sizeof(record) - body) != ESP_OK ||
+            esp_partition_write(part_, offset, &record.seq, body) != ESP_OK) {
+            LOGE(TAG_HIST, "Write of record %lu failed", (unsigned long)seq);
+        }
+        // Ô đã dùng dù ghi lỗi: seq không khớp nên đọc ra là thiếu
+        last_ = seq;
+        lastTs_ = epoch;
+        LOGD(TAG_HIST, "Record %lu at %lu: %.3f, %.3f", (unsigned long)seq, (unsigned long)epoch, values[0],
+             values[1]);
+    }
+
+    // Khoảng seq còn trong sổ; rỗng khi first() > last()
+    uint32_t first() const {
+        if (!last_) return 1;
+        uint32_t inSector = (last_ - 1) % capacity_ % HISTORY_RECORDS_PER_SECTOR;
+        uint32_t kept = capacity_ - (HISTORY_RECORDS_PER_SECTOR - 1 - inSector);
+        return last_ > kept ? last_ - kept + 1 : 1;
+    }
+
+    uint32_t last() const { return last_; }
+
+    // false nếu bản ghi seq không còn hoặc hỏng
+    bool read(uint32_t seq, HistoryRecord& out) const {
+        if (!part_ || seq < first() || seq > last_) return false;
+        return esp_partition_read(part_, slotOffset(seq), &out, sizeof(out)) == ESP_OK && out.seq == seq;
+    }
+
+private:
+    const esp_partition_t* part_ = NULL;
+    uint32_t capacity_ = 0;
+    uint32_t last_ = 0;         // seq mới nhất, 0 khi sổ trống
+    uint32_t lastTs_ = 0;
+
+    size_t slotOffset(uint32_t seq) const {
+        return (size_t)((seq - 1) % capacity_) * sizeof(HistoryRecord);
+    }
+
+    uint32_t seqAt(uint32_t slot) const {
+        uint32_t seq = HISTORY_SEQ_ERASED;
+        esp_partition_read(part_, (size_t)slot * sizeof(HistoryRecord), &seq, sizeof(seq));
+        return seq;
+    }
+
+    // Sector mới nhất là sector có bản ghi đầu mang seq lớn nhất (seq phải
+    // khớp với ô của nó), rồi đi tiếp trong sector đó đến ô trống đầu tiên
+    void scan() {
+        uint32_t sectors = capacity_ / HISTORY_RECORDS_PER_SECTOR;
+        uint32_t newestHead = 0;
+        for (uint32_t s = 0; s < sectors; s++) {
+            uint32_t seq = seqAt(s * HISTORY_RECORDS_PER_SECTOR);
+            if (seq != HISTORY_SEQ_ERASED && seq && (seq - 1) % capacity_ == s * HISTORY_RECORDS_PER_SECTOR &&
+                seq > newestHead) {
+                newestHead = seq;
+            }
+        }
+        last_ = lastTs_ = 0;
+        if (!newestHead) return;
+
+        last_ = newestHead;
+        while ((last_ % capacity_) % HISTORY_RECORDS_PER_SECTOR && seqAt(last_ % capacity_) == last_ + 1) last_++;
+
+        // Ô kế tiếp đã bị ghi dở (mất điện giữa chừng) thì bỏ qua nó
+        if ((last_ % capacity_) % HISTORY_RECORDS_PER_SECTOR && !slotErased(last_ % capacity_)) {
+            LOGW(TAG_HIST, "Partly written record %lu skipped", (unsigned long)(last_ + 1));
+            last_++;
+        }
+
+        HistoryRecord newest;
+        if (read(last_, newest)) lastTs_ = newest.ts;
+    }
+
+    bool slotErased(uint32_t slot) const {
+        uint8_t raw[sizeof(HistoryRecord)];
+        if (esp_partition_read(part_, (size_t)slot * sizeof(HistoryRecord), raw, sizeof(raw)) != ESP_OK) return false;
+        for (size_t i = 0; i < sizeof(raw); i++) {
+            if (raw[i] != 0xFF) return false;
+        }
+        return true;
+    }
+};
+
+#endif
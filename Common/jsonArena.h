@@ -0,0 +1,85 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <ArduinoJson.h>
+#include <string.h>
+
+// Enough for one ArduinoJson 7 slot pool on ESP32 plus a few short strings
+#ifndef JSON_ARENA_SIZE
+#define JSON_ARENA_SIZE 4096
+#endif
+
+// Stack allocator over a fixed static buffer for ArduinoJson 7 documents.
+// Plays the role StaticJsonDocument had in v6: a JsonDocument built with
+// JsonDocument doc(&arena) never touches the heap. Blocks are carved off the
+// top; releasing the top block rewinds over it and over any block below it
+// that was already released, so the arena is empty again once the document
+// goes out of scope. A block released below the top only comes back with
+// the blocks above it. Running out of space makes deserializeJson() return
+// NoMemory.
+template <size_t N = JSON_ARENA_SIZE>
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override {
+        size_t total = HEADER + align(size);
+        if (used_ + total > N) return nullptr;
+        Block* b = blockAt(used_);
+        b->size = size;
+        b->below = used_ ? last_ : 0;
+        last_ = used_;
+        used_ += total;
+        return b + 1;
+    }
+
+    void deallocate(void* ptr) override {
+        if (!ptr) return;
+        blockAt(offsetOf(ptr))->size = RELEASED;
+        while (used_ && blockAt(last_)->size == RELEASED) {
+            used_ = last_;
+            last_ = blockAt(last_)->below;
+        }
+    }
+
+    void* reallocate(void* ptr, size_t newSize) override {
+        if (!ptr) return allocate(newSize);
+        size_t offset = offsetOf(ptr);
+        Block* b = blockAt(offset);
+
+        // Top block: grow or shrink in place
+        if (offset == last_) {
+            if (offset + HEADER + align(newSize) > N) return nullptr;
+            b->size = newSize;
+            used_ = offset + HEADER + align(newSize);
+            return ptr;
+        }
+
+        void* fresh = allocate(newSize);
+        if (!fresh) return nullptr;
+        memcpy(fresh, ptr, b->size < newSize ? b->size : newSize);
+        deallocate(ptr);
+        return fresh;
+    }
+
+    size_t used() const { return used_; }
+    size_t capacity() const { return N; }
+
+private:
+    struct Block {
+        size_t size;    // RELEASED once deallocated
+        size_t below;   // offset of the block under this one, 0 for the first
+    };
+    static const size_t HEADER = sizeof(Block);  // keeps payloads 8-byte aligned
+    static const size_t RELEASED = ~size_t(0);
+
+    static size_t align(size_t n) { return (n + 7) & ~size_t(7); }
+    size_t offsetOf(void* ptr) const {
+        return reinterpret_cast<uint8_t*>(ptr) - buffer_ - HEADER;
+    }
+    Block* blockAt(size_t offset) { return reinterpret_cast<Block*>(buffer_ + offset); }
+
+    alignas(8) uint8_t buffer_[N];
+    size_t used_ = 0;
+    size_t last_ = 0;   // offset of the top block, valid while used_ > 0
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef LBT_H
+#define LBT_H
+
+#include <stdint.h>
+
+// Tham số listen-before-talk (CAD + backoff lũy thừa). Không phụ thuộc
+// Arduino để công cụ mô phỏng kênh (tools/channel-sim) dùng cùng giá trị.
+#define LBT_SLOT_MS        20   // một slot backoff, cỡ airtime của gói ngắn
+#define LBT_CW_MIN_SLOTS   4    // cửa sổ backoff lần đầu
+#define LBT_CW_MAX_SLOTS   128
+#define LBT_MAX_ATTEMPTS   6    // sau số lần CAD bận này vẫn phát để không treo
+#define LBT_CAD_TIMEOUT_MS 10   // CAD ở SF7/125 kHz mất khoảng 2 symbol (~2 ms)
+
+// Số slot chờ sau lần CAD bận thứ attempt (bắt đầu từ 0); rnd là số ngẫu
+// nhiên bất kỳ. Cửa sổ nhân đôi mỗi lần, chặn trên ở LBT_CW_MAX_SLOTS.
+inline uint32_t lbtBackoffSlots(int attempt, uint32_t rnd) {
+    uint32_t cw = LBT_CW_MIN_SLOTS;
+    for (int i = 0; i < attempt && cw < LBT_CW_MAX_SLOTS; i++) cw *= 2;
+    return rnd % cw;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Compile-time log levels. Calls above LOG_LEVEL expand to nothing, so their
+// arguments are never evaluated. Override per sketch with -DLOG_LEVEL=...
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// 1: lines go into a RAM ring drained to Serial by a low-priority task,
+// 0: lines are written to Serial directly (blocking)
+#ifndef LOG_DEFERRED
+#define LOG_DEFERRED 1
+#endif
+
+#define LOG_RING_SIZE 32
+#define LOG_LINE_MAX  96
+
+// Module tags
+#define TAG_LORA   "LORA"
+#define TAG_SENSOR "SENS"
+#define TAG_HTTP   "HTTP"
+#define TAG_MQTT   "MQTT"
+#define TAG_POLL   "POLL"
+#define TAG_EEPROM "EEPR"
+#define TAG_TIME   "TIME"
+#define TAG_WIFI   "WIFI"
+#define TAG_HIST   "HIST"
+
+struct LogRing {
+    char lines[LOG_RING_SIZE][LOG_LINE_MAX];
+    uint8_t lens[LOG_RING_SIZE];
+    volatile uint16_t head;     // next slot to write
+    volatile uint16_t tail;     // next slot to drain
+    volatile uint32_t dropped;  // lines lost because the ring was full
+    portMUX_TYPE lock;
+};
+
+inline LogRing& logRing() {
+    static LogRing ring = {{{0}}, {0}, 0, 0, 0, portMUX_INITIALIZER_UNLOCKED};
+    return ring;
+}
+
+// "<level> <tag> <message>\n" into line (LOG_LINE_MAX bytes, message
+// truncated to fit), returns its length
+inline size_t logFormat(char* line, char level, const char* tag, const char* fmt, va_list args) {
+    int n = snprintf(line, LOG_LINE_MAX, "%c %s ", level, tag);
+    int m = vsnprintf(line + n, LOG_LINE_MAX - n - 1, fmt, args);
+    if (m < 0) m = 0;
+    n += m;
+    if (n > LOG_LINE_MAX - 2) n = LOG_LINE_MAX - 2;
+    line[n++] = '\n';
+    return n;
+}
+
+// Queue a formatted line for logTask(), counted as dropped if the ring is full
+inline void logPush(const char* line, size_t n) {
+    LogRing& ring = logRing();
+    portENTER_CRITICAL(&ring.lock);
+    uint16_t next = (ring.head + 1) % LOG_RING_SIZE;
+    if (next == ring.tail) {
+        ring.dropped++;
+    } else {
+        memcpy(ring.lines[ring.head], line, n);
+        ring.lens[ring.head] = n;
+        ring.head = next;
+    }
+    portEXIT_CRITICAL(&ring.lock);
+}
+
+// Formats one line at the call site (arguments may point into reused
+// packet buffers) and defers the slow UART transfer to logTask().
+inline void logWrite(char level, const char* tag, const char* fmt, ...) {
+    char line[LOG_LINE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    size_t n = logFormat(line, level, tag, fmt, args);
+    va_end(args);
+#if LOG_DEFERRED
+    logPush(line, n);
+#else
+    Serial.write((const uint8_t*)line, n);
+#endif
+}
+
+// Write the queued lines to Serial
+inline void logDrain() {
+    LogRing& ring = logRing();
+    while (ring.tail != ring.head) {
+        Serial.write((const uint8_t*)ring.lines[ring.tail], ring.lens[ring.tail]);
+        portENTER_CRITICAL(&ring.lock);
+        ring.tail = (ring.tail + 1) % LOG_RING_SIZE;
+        portEXIT_CRITICAL(&ring.lock);
+    }
+}
+
+// Drain task: lowest priority, only runs when nothing else needs the CPU
+inline void logTask(void* pvParameters) {
+    (void)pvParameters;
+    LogRing& ring = logRing();
+    uint32_t reportedDrops = 0;
+    while (1) {
+        logDrain();
+        if (ring.dropped != reportedDrops) {
+            reportedDrops = ring.dropped;
+            Serial.printf("W LOG %u lines dropped\n", (unsigned)reportedDrops);
+        }
+        vTaskDelay(20 / portTICK_PERIOD_MS);
+    }
+}
+
+// Drain task handle, NULL when logging is direct (for diag.h)
+inline TaskHandle_t& logTaskHandle() {
+    static TaskHandle_t handle = NULL;
+    return handle;
+}
+
+// Start the drain task; call once from setup() after Serial.begin()
+inline void logInit() {
+#if LOG_DEFERRED && LOG_LEVEL > LOG_LEVEL_NONE
+    xTaskCreate(logTask, "LogTask", 2048, NULL, 0, &logTaskHandle());
+#endif
+}
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOGE(tag, ...) logWrite('E', tag, __VA_ARGS__)
+#else
+#define LOGE(tag, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOGW(tag, ...) logWrite('W', tag, __VA_ARGS__)
+#else
+#define LOGW(tag, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOGI(tag, ...) logWrite('I', tag, __VA_ARGS__)
+#else
+#define LOGI(tag, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOGD(tag, ...) logWrite('D', tag, __VA_ARGS__)
+#else
+#define LOGD(tag, ...) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Chuyển tiếp nhiều chặng (relay). Không phụ thuộc Arduino để công cụ mô
+// phỏng (tools/relay-sim) dùng chung bảng định tuyến và cache chống trùng.
+//
+// Frame thường là [node][gateway][payload]: byte đầu luôn là địa chỉ node,
+// chỉ dùng giữa node và Gateway nghe trực tiếp. Frame định tuyến bắt đầu
+// bằng MESH_MARK (không phải địa chỉ node nào) nên firmware cũ bỏ qua:
+//
+//   [MESH_MARK][linkDst][linkSrc][origin][dest][hops][ttl][msgId][payload]
+//
+//   linkDst/linkSrc  chặng hiện tại: nút nhận kế tiếp và nút vừa phát
+//   origin/dest      hai đầu của frame
+//   hops             số lần đã được chuyển tiếp, 0 khi rời origin
+//   ttl              giảm mỗi chặng, hết thì bỏ frame (chống vòng lặp)
+//   msgId            bộ đếm 8 bit của origin, cùng origin là khóa chống trùng
+//
+// Chỉ nút có địa chỉ linkDst xử lý frame; nút khác nghe được thì chỉ học
+// đường đi từ RSSI. Node với node luôn dùng frame định tuyến.
+
+#define MESH_MARK          0xA5
+#define MESH_HEADER_LEN    8
+#define MESH_TTL_DEFAULT   4
+
+// Frame gộp của relay: "agg<R>" rồi từng dòng '\n' là một frame của node con
+// ({...}), "end<N>" khi node con N trả lời xong, "to<N>" khi N không trả lời.
+// Gateway trả "ag<R>" cho mỗi frame gộp. Vẫn dưới 255 byte của một gói LoRa.
+// Frame gộp không được ack giữ lại trong relay (node con đã commit) và gửi
+// lại đầu lần pollSub sau với đầu "agl<R>": Gateway chỉ lấy các frame dữ
+// liệu nó chưa đẩy lên backend, bỏ các dòng trạng thái của lần poll cũ.
+#define MESH_AGG_MAX       230
+
+// Relay chờ mỗi frame của node con tối đa ngần này khi poll cây con, và
+// gửi frame gộp tối đa RELAY_AGG_ATTEMPTS lần nếu Gateway không trả "ag<R>"
+#define RELAY_CHILD_TIMEOUT_MS 3000
+#define RELAY_ACK_TIMEOUT_MS   2000
+#define RELAY_AGG_ATTEMPTS     3
+#define RELAY_MAX_CHILDREN     8
+#define RELAY_AGG_BACKLOG      4
+
+// Bảng định tuyến: chi phí một chặng, tính bằng dB để so với RSSI. Đường
+// trực tiếp có RSSI dưới MESH_RSSI_GOOD bị phạt theo số dB thiếu, nên một
+// đường hai chặng tốt thắng một chặng sát ngưỡng thu (SF7 khoảng -123 dBm).
+#define MESH_HOP_COST      10
+#define MESH_RSSI_GOOD     (-105)
+#define MESH_ROUTE_TTL_MS  (30UL * 60 * 1000)
+#define MESH_ROUTES_MAX    16
+
+#define MESH_DUP_ENTRIES   16
+#define MESH_DUP_WINDOW_MS 60000UL
+
+struct MeshHeader {
+    uint8_t linkDst;
+    uint8_t linkSrc;
+    uint8_t origin;
+    uint8_t dest;
+    uint8_t hops;
+    uint8_t ttl;
+    uint8_t msgId;
+};
+
+inline void meshEncode(const MeshHeader& h, uint8_t* out) {
+    out[0] = MESH_MARK;
+    out[1] = h.linkDst;
+    out[2] = h.linkSrc;
+    out[3] = h.origin;
+    out[4] = h.dest;
+    out[5] = h.hops;
+    out[6] = h.ttl;
+    out[7] = h.msgId;
+}
+
+// in[0] phải là MESH_MARK
+inline MeshHeader meshDecode(const uint8_t* in) {
+    MeshHeader h = {in[1], in[2], in[3], in[4], in[5], in[6], in[7]};
+    return h;
+}
+
+// Frame mới rời origin
+inline MeshHeader meshOriginate(uint8_t origin, uint8_t dest, uint8_t nextHop, uint8_t msgId) {
+    MeshHeader h = {nextHop, origin, origin, dest, 0, MESH_TTL_DEFAULT, msgId};
+    return h;
+}
+
+// Cache (origin, msgId) đã thấy gần đây: một lần phát chỉ được xử lý hoặc
+// chuyển tiếp một lần dù nghe lại (frame vòng về, phát lại trùng).
+class MeshDupCache {
+public:
+    // true nếu frame đã thấy trong MESH_DUP_WINDOW_MS; nếu chưa thì ghi nhận
+    bool seen(uint8_t origin, uint8_t msgId, uint32_t nowMs) {
+        for (int i = 0; i < MESH_DUP_ENTRIES; i++) {
+            const Entry& e = entries_[i];
+            if (e.used && e.origin == origin && e.msgId == msgId && nowMs - e.atMs < MESH_DUP_WINDOW_MS) {
+                return true;
+            }
+        }
+        Entry& slot = entries_[next_];
+        next_ = (next_ + 1) % MESH_DUP_ENTRIES;
+        slot.origin = origin;
+        slot.msgId = msgId;
+        slot.atMs = nowMs;
+        slot.used = true;
+        return false;
+    }
+
+private:
+    struct Entry {
+        uint8_t origin;
+        uint8_t msgId;
+        bool used;
+        uint32_t atMs;
+    };
+    Entry entries_[MESH_DUP_ENTRIES] = {};
+    int next_ = 0;
+};
+
+// Bảng next-hop học từ các frame nghe được: frame của origin O đến qua nút
+// L sau h lần chuyển tiếp cho biết O đi được qua L với h + 1 chặng, chất
+// lượng chặng cuối là RSSI đo được. Giữ đường có chi phí thấp nhất; đường
+// hiện tại luôn được cập nhật bằng mẫu mới, kể cả khi xấu đi.
+class MeshRoutes {
+public:
+    void observe(uint8_t dest, uint8_t via, uint8_t links, int rssi, uint32_t nowMs) {
+        int cost = routeCost(links, rssi);
+        Route* r = find(dest);
+        if (!r) {
+            r = freeSlot(nowMs);
+            r->dest = dest;
+        } else if (r->via != via && nowMs - r->atMs < MESH_ROUTE_TTL_MS && cost >= r->cost) {
+            return;
+        }
+        r->via = via;
+        r->links = links;
+        r->cost = cost;
+        r->atMs = nowMs;
+        r->used = true;
+    }
+
+    // Nút kế tiếp về phía dest; chưa biết đường (hoặc đã hết hạn) thì thử
+    // phát thẳng cho dest
+    uint8_t nextHop(uint8_t dest, uint32_t nowMs) const {
+        const Route* r = find(dest);
+        return r && nowMs - r->atMs < MESH_ROUTE_TTL_MS ? r->via : dest;
+    }
+
+    // Số chặng của đường đang dùng, 0 nếu chưa biết
+    uint8_t links(uint8_t dest, uint32_t nowMs) const {
+        const Route* r = find(dest);
+        return r && nowMs - r->atMs < MESH_ROUTE_TTL_MS ? r->links : 0;
+    }
+
+    static int routeCost(uint8_t links, int rssi) {
+        return links * MESH_HOP_COST + (rssi < MESH_RSSI_GOOD ? MESH_RSSI_GOOD - rssi : 0);
+    }
+
+private:
+    struct Route {
+        uint8_t dest;
+        uint8_t via;
+        uint8_t links;
+        bool used;
+        int cost;
+        uint32_t atMs;
+    };
+    Route routes_[MESH_ROUTES_MAX] = {};
+
+    Route* find(uint8_t dest) {
+        for (Route& r : routes_) if (r.used && r.dest == dest) return &r;
+        return NULL;
+    }
+
+    const Route* find(uint8_t dest) const {
+        for (const Route& r : routes_) if (r.used && r.dest == dest) return &r;
+        return NULL;
+    }
+
+    // Ô trống, hoặc đường cũ nhất khi bảng đầy
+    Route* freeSlot(uint32_t nowMs) {
+        Route* oldest = &routes_[0];
+        for (Route& r : routes_) {
+            if (!r.used) return &r;
+            if (nowMs - r.atMs > nowMs - oldest->atMs) oldest = &r;
+        }
+        return oldest;
+    }
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef NODE_CLOCK_H
+#define NODE_CLOCK_H
+
+#include <Arduino.h>
+
+// Đồng hồ epoch (UTC, giây) trên node, đồng bộ theo thời gian NTP mà
+// Gateway gửi kèm trong lệnh poll. Giữa hai lần đồng bộ, thời gian được
+// nội suy từ millis() và hiệu chỉnh theo độ trôi (ppm) đo được.
+class NodeClock {
+public:
+    // Epoch chỉ chính xác đến giây nên mỗi lần đo độ trôi sai tới ±1 s:
+    // trên 10 phút là ~1700 ppm, vượt cả mức kẹp. Độ trôi vì thế đo trên
+    // khoảng từ mốc driftEpoch_ (không đặt lại mỗi lần đồng bộ) dài ít nhất
+    // 6 giờ, sai số còn ~46 ppm.
+    static const uint32_t MIN_DRIFT_BASELINE_MS = 6UL * 3600 * 1000;
+    static const int32_t MAX_DRIFT_PPM = 500;
+
+    void sync(uint32_t epoch) {
+        uint32_t ms = millis();
+        if (!synced_) {
+            driftEpoch_ = epoch;
+            driftMillis_ = ms;
+        } else {
+            uint32_t elapsedMs = ms - driftMillis_;
+            if (elapsedMs >= MIN_DRIFT_BASELINE_MS) {
+                // Độ trôi của millis() so với Gateway trên cả khoảng -> ppm (EMA 1/2)
+                int64_t errorMs = (int64_t)(int32_t)(epoch - driftEpoch_) * 1000 - elapsedMs;
+                int32_t measuredPpm = (int32_t)(errorMs * 1000000 / elapsedMs);
+                driftPpm_ = (driftPpm_ + measuredPpm) / 2;
+                if (driftPpm_ > MAX_DRIFT_PPM) driftPpm_ = MAX_DRIFT_PPM;
+                if (driftPpm_ < -MAX_DRIFT_PPM) driftPpm_ = -MAX_DRIFT_PPM;
+                driftEpoch_ = epoch;
+                driftMillis_ = ms;
+            }
+        }
+        refEpoch_ = epoch;
+        refMillis_ = ms;
+        synced_ = true;
+    }
+
+    // Epoch hiện tại, 0 nếu chưa từng đồng bộ
+    uint32_t now() const {
+        if (!synced_) return 0;
+        uint32_t elapsedMs = millis() - refMillis_;
+        int64_t corrected = (int64_t)elapsedMs + (int64_t)elapsedMs * driftPpm_ / 1000000;
+        return refEpoch_ + (uint32_t)(corrected / 1000);
+    }
+
+    bool synced() const { return synced_; }
+    int32_t driftPpm() const { return driftPpm_; }
+
+private:
+    uint32_t refEpoch_ = 0;
+    uint32_t refMillis_ = 0;
+    uint32_t driftEpoch_ = 0;   // mốc đo độ trôi
+    uint32_t driftMillis_ = 0;
+    int32_t driftPpm_ = 0;
+    bool synced_ = false;
+};
+
+#endif
@@ -0,0 +1,729 @@
+#ifndef NODE_RUNTIME_H
+#define NODE_RUNTIME_H
+
+#include <Arduino.h>
+#include <LoRa.h>
+#include <stdlib.h>
+#include "base64.h"
+#include "diag.h"
+#include "frame.h"
+#include "gateways.h"
+#include "historyLog.h"
+#include "log.h"
+#include "mesh.h"
+#include "nodeClock.h"
+#include "radio.h"
+#include "reportFilter.h"
+
+// Lõi chung của các node cảm biến: nhận lệnh từ Gateway, chọn kênh theo
+// report-by-exception, gửi từng kênh và chờ "ok<N>", gửi cảnh báo ưu tiên
+// chờ "ak<N>", trả lời getRSSI/getDiag. Phần riêng của mỗi node là một
+// Sensor policy truyền qua template, có dạng:
+//
+//   struct Sensor {
+//       typedef ... Alert;                          // struct rỗng nếu node không có cảnh báo
+//       static const int CHANNELS = 2;
+//       void begin();                               // đọc EEPROM, khởi động task đo
+//       const char* id(int ch) const;
+//       Deadband deadband(int ch) const;
+//       void sample(const NodeClock& clock);        // chốt số liệu cho lần poll
+//       float value(int ch) const;                  // giá trị so với deadband
+//       uint32_t epoch(int ch) const;               // thời điểm đo, 0 nếu chưa đồng bộ
+//       int formatFields(char* out, size_t cap, int ch) const;           // "Water":1.000
+//       void commit();                              // lưu EEPROM khi Gateway đã nhận đủ
+//       bool takeAlert(Alert& alert);               // cảnh báo mới, không chặn
+//       int formatAlert(char* out, size_t cap, const Alert& alert) const; // "alert":"burst",...
+//       bool batchPending() const;                  // có bản ghi tồn đọng (ví dụ khoảng đo)
+//       int formatBatch(char* out, size_t cap);     // trường của frame lô kế tiếp
+//       void batchSent();                           // Gateway đã ack lô vừa gửi
+//       void historyValues(float* out) const;       // tổng tích lũy hiện tại, cho sổ lịch sử
+//   };
+//
+// Trong một lần poll, sau các kênh dữ liệu node gửi tiếp tối đa
+// NODE_BATCH_FRAMES_MAX frame lô, mỗi frame chờ ok<N> như một kênh, rồi "end".
+//
+// Mỗi HISTORY_INTERVAL_S node ghi historyValues() vào sổ lịch sử trên flash
+// (historyLog.h). Sau mỗi lần poll Gateway lấy các bản ghi nó chưa có bằng
+// lệnh "history", nên số liệu của những lần poll thất bại vẫn về đủ.
+//
+// Lệnh được so bằng hash FNV-1a tính lúc biên dịch trong một switch, kể cả
+// lệnh mang số node ("ok1", "getData2"), nên không có chuỗi strcmp và không
+// cần ArduinoJson: lệnh JSON của Gateway chỉ được đọc trường "command" và
+// "time". Hai lệnh trùng hash là lỗi biên dịch (case trùng giá trị).
+//
+// Node ngoài tầm Gateway nhận lệnh qua một relay bằng frame định tuyến
+// (mesh.h) và trả lời về đúng nơi đã hỏi theo bảng next-hop. Node bật
+// NODE_RELAY (node cắm điện) thì chuyển tiếp frame của node khác và nhận
+// lệnh "pollSub": tự poll các node con rồi gửi Gateway frame gộp.
+
+// Firmware bật vai trò relay bằng #define NODE_RELAY 1 trước khi include
+#ifndef NODE_RELAY
+#define NODE_RELAY 0
+#endif
+
+#ifndef NODE_SS_PIN
+#define NODE_SS_PIN    5
+#define NODE_RST_PIN   4
+#define NODE_DIO0_PIN  2
+#endif
+
+// Cảnh báo: gửi ngay không chờ poll, giữ lại đến khi Gateway trả "ak<N>"
+#define ALERT_RETRY_MS 5000
+#define ALERT_MAX_ATTEMPTS 5
+
+// Lượt gửi dữ liệu không nhận được ok<N> sau chừng này (bằng thời gian chờ
+// poll của Gateway) coi như bỏ, để cảnh báo không bị chặn đến lần poll sau.
+// Giá trị chưa commit vẫn giữ cho lần poll sau.
+#define NODE_EXCHANGE_TIMEOUT_MS 10000
+
+// Số frame lô tối đa mỗi lần poll, phần còn lại chờ lần poll sau
+#define NODE_BATCH_FRAMES_MAX 64
+
+// Số frame lịch sử tối đa trả lời một lệnh history
+#define HISTORY_WINDOW_MAX 16
+
+// FNV-1a 32 bit, dạng một return để là constexpr trong C++11
+constexpr uint32_t cmdHashStep(uint32_t h, char c) {
+    return (h ^ (uint8_t)c) * 16777619u;
+}
+
+constexpr uint32_t cmdHash(const char* s, uint32_t h = 2166136261u) {
+    return *s ? cmdHash(s + 1, cmdHashStep(h, *s)) : h;
+}
+
+// Nối số thập phân vào hash: cmdHashNum(cmdHash("ok"), 1) == cmdHash("ok1")
+constexpr uint32_t cmdHashNum(uint32_t h, unsigned n) {
+    return n < 10 ? cmdHashStep(h, (char)('0' + n))
+                  : cmdHashStep(cmdHashNum(h, n / 10), (char)('0' + n % 10));
+}
+
+// Hash lúc chạy của token nhận được, cùng thuật toán
+inline uint32_t cmdHashOf(MsgView token) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < token.len; i++) h = cmdHashStep(h, token.data[i]);
+    return h;
+}
+
+// Lệnh dạng chữ ("Hi", "ok1") là cả payload; lệnh JSON của Gateway
+// {"command":"getData1",...} lấy chuỗi trong trường "command".
+// Payload do readLoRaPayload() đọc luôn kết thúc bằng '\0'.
+inline MsgView commandToken(MsgView message) {
+    if (!message.len || message.data[0] != '{') return message;
+    static const char KEY[] = "\"command\":\"";
+    const char* start = strstr(message.data, KEY);
+    if (!start) return MsgView{message.data, 0};
+    start += sizeof(KEY) - 1;
+    const char* end = strchr(start, '"');
+    return end ? MsgView{start, (size_t)(end - start)} : MsgView{message.data, 0};
+}
+
+// Trường số nguyên không dấu của một lệnh JSON, 0 nếu không có
+inline uint32_t commandUintField(MsgView message, const char* key) {
+    if (!message.len || message.data[0] != '{') return 0;
+    const char* p = strstr(message.data, key);
+    return p ? strtoul(p + strlen(key), NULL, 10) : 0;
+}
+
+template <int Address, class Sensor>
+class NodeRuntime {
+    static_assert(Sensor::CHANNELS <= HISTORY_CHANNELS, "History records hold HISTORY_CHANNELS channels");
+
+public:
+    Sensor sensor;
+
+    // Gọi trong setup() sau Serial.begin(), logInit() và EEPROM.begin()
+    void begin() {
+        diagWatchTask(NULL, "loop");
+        diagWatchTask(logTaskHandle(), "log");
+        for (int ch = 0; ch < Sensor::CHANNELS; ch++) reportFilters_[ch] = ReportFilter(sensor.deadband(ch));
+        sensor.begin();
+        history_.begin();
+        initLoRa();
+    }
+
+    // Gọi mỗi vòng loop()
+    void loop() {
+        diagLoopTick();
+        receiveMessage();
+        sendPendingAlert();
+        historyTick();
+    }
+
+    const NodeClock& clock() const { return clock_; }
+
+private:
+    enum SendState {
+        IDLE,
+        SENDING,        // đã gửi kênh sentChannel_, chờ ok<N>
+        COMPLETED
+    };
+
+    typedef typename Sensor::Alert Alert;
+
+    // Buffer tĩnh cho gói nhận/gửi, không cấp phát heap theo từng gói.
+    // Gói nhận có thể là frame gộp mà relay chuyển tiếp.
+    char rxBuffer_[MESH_AGG_MAX + 1];
+    char txBuffer_[FRAME_PAYLOAD_MAX + 1];
+
+    // Đồng hồ đồng bộ theo Gateway
+    NodeClock clock_;
+    HistoryLog history_;
+    int gatewayAddress_ = GATEWAY_ADDR_FIRST;  // Gateway gần nhất đã liên lạc
+    int replyTo_ = GATEWAY_ADDR_FIRST;         // nơi gửi lệnh đang xử lý: Gateway hoặc relay
+
+    // Frame định tuyến
+    MeshRoutes routes_;
+    MeshDupCache dups_;
+    uint8_t meshMsgId_ = 0;
+
+#if NODE_RELAY
+    // Frame gộp đang dựng trong một lần pollSub
+    char aggBuffer_[MESH_AGG_MAX + 1];
+    size_t aggLen_ = 0;
+
+    // Frame gộp Gateway chưa ack, cũ nhất trước
+    char backlog_[RELAY_AGG_BACKLOG][MESH_AGG_MAX + 1];
+    size_t backlogLen_[RELAY_AGG_BACKLOG];
+    uint8_t backlogCount_ = 0;
+#endif
+
+    // Số thứ tự frame dữ liệu/cảnh báo; các Gateway cùng nghe một frame gửi
+    // lên cùng seq, backend dựa vào đó để bỏ bản trùng
+    uint16_t frameSeq_ = 0;
+
+    SendState state_ = IDLE;
+    ReportFilter reportFilters_[Sensor::CHANNELS];
+    uint8_t reportMask_ = 0;    // bit i = kênh i được gửi trong lần poll này
+    int sentChannel_ = -1;      // Sensor::CHANNELS = frame lô
+    uint8_t batchFrames_ = 0;   // frame lô đã được ack trong lần poll này
+    unsigned long sendingSince_ = 0;    // lúc gửi frame đang chờ ok<N>
+
+    Alert alert_;
+    bool alertPending_ = false;
+    uint32_t alertEpoch_ = 0;
+    uint16_t alertSeq_ = 0;     // giữ nguyên khi gửi lại để backend bỏ bản trùng
+    uint8_t alertAttempts_ = 0;
+    unsigned long lastAlertSend_ = 0;
+
+    void initLoRa() {
+        LoRa.setPins(NODE_SS_PIN, NODE_RST_PIN, NODE_DIO0_PIN);
+        if (!LoRa.begin(433E6)) {
+            Serial.println("LoRa initialization failed!");
+            while(1);
+        }
+        LoRa.setSyncWord(0xF3);
+        radioInit();
+        Serial.printf("Node %d LoRa initialized!\n", Address);
+    }
+
+    void receiveMessage() {
+        int from;
+        MsgView message;
+        if (receiveFrame(from, message)) {
+            LOGD(TAG_LORA, "Received from %d: %s", from, message.data);
+            dispatch(message);
+        }
+    }
+
+    // Đọc một gói nếu có. true khi payload dành cho node này, from là nơi
+    // gửi: Gateway, hoặc origin của frame định tuyến.
+    bool receiveFrame(int& from, MsgView& message) {
+        int packetSize = LoRa.parsePacket();
+        if (!packetSize) return false;
+        int targetAddr = LoRa.read();
+        if (targetAddr == MESH_MARK) return receiveRouted(from, message);
+        int senderAddr = LoRa.read();
+
+        // Nhận từ bất kỳ Gateway nào trong dải, trả lời Gateway vừa hỏi
+        if (targetAddr == Address && isGatewayAddress(senderAddr)) {
+            gatewayAddress_ = replyTo_ = from = senderAddr;
+            routes_.observe(senderAddr, senderAddr, 1, LoRa.packetRssi(), millis());
+            message = readLoRaPayload(rxBuffer_, sizeof(rxBuffer_));
+            return true;
+        }
+        // Clear buffer nếu không phải message dành cho node này
+        discardLoRaPayload();
+        return false;
+    }
+
+    // Frame định tuyến, byte MESH_MARK đã được đọc. Mọi frame nghe được đều
+    // cập nhật bảng next-hop; chỉ frame có linkDst là node này được xử lý.
+    bool receiveRouted(int& from, MsgView& message) {
+        uint8_t raw[MESH_HEADER_LEN] = {MESH_MARK};
+        for (int i = 1; i < MESH_HEADER_LEN; i++) raw[i] = (uint8_t)LoRa.read();
+        MeshHeader header = meshDecode(raw);
+        uint32_t now = millis();
+        int rssi = LoRa.packetRssi();
+
+        if (header.origin != Address) routes_.observe(header.origin, header.linkSrc, header.hops + 1, rssi, now);
+        if (header.linkSrc != header.origin) routes_.observe(header.linkSrc, header.linkSrc, 1, rssi, now);
+
+        // Chỉ ghi nhận vào cache chống trùng frame gửi cho mình: bản gốc
+        // nghe lỏm không được che mất bản relay chuyển tới
+        if (header.linkDst != Address || dups_.seen(header.origin, header.msgId, now)) {
+            discardLoRaPayload();
+            return false;
+        }
+        if (header.dest != Address) {
+            forwardRouted(header);
+            return false;
+        }
+
+        replyTo_ = from = header.origin;
+        if (isGatewayAddress(header.origin)) gatewayAddress_ = header.origin;
+        message = readLoRaPayload(rxBuffer_, sizeof(rxBuffer_));
+        return true;
+    }
+
+    // Chuyển frame sang chặng kế tiếp; node không phải relay thì bỏ
+    void forwardRouted(MeshHeader header) {
+#if NODE_RELAY
+        if (header.ttl <= 1) {
+            LOGW(TAG_LORA, "Routed frame %d->%d dropped, TTL expired", header.origin, header.dest);
+            discardLoRaPayload();
+            return;
+        }
+        MsgView payload = readLoRaPayload(rxBuffer_, sizeof(rxBuffer_));
+        header.linkSrc = Address;
+        header.linkDst = routes_.nextHop(header.dest, millis());
+        header.hops++;
+        header.ttl--;
+        LOGD(TAG_LORA, "Forward %d->%d via %d, hop %d", header.origin, header.dest, header.linkDst, header.hops);
+        if (!radioSendRouted(header, payload.data, payload.len)) LOGE(TAG_LORA, "Failed to forward frame");
+#else
+        (void)header;
+        discardLoRaPayload();
+#endif
+    }
+
+    void dispatch(MsgView message) {
+        // Gateway gửi kèm thời gian NTP (epoch UTC) trong lệnh poll
+        uint32_t gatewayTime = commandUintField(message, "\"time\":");
+        if (gatewayTime) clock_.sync(gatewayTime);
+
+        switch (cmdHashOf(commandToken(message))) {
+        case cmdHash("Hi"):
+            LOGI(TAG_LORA, "Received initialization message");
+            sendToGateway("Done");
+            break;
+        case cmdHash("getRSSI"):
+            handleGetRssi();
+            break;
+        case cmdHash("getDiag"):
+            handleGetDiag();
+            break;
+        case cmdHashNum(cmdHash("ok"), Address):
+            handleOk();
+            break;
+        case cmdHashNum(cmdHash("ak"), Address):
+            LOGI(TAG_LORA, "Gateway acknowledged alert");
+            alertPending_ = false;
+            break;
+        case cmdHashNum(cmdHash("getData"), Address):
+            LOGI(TAG_LORA, "Received getData%d command from Gateway", Address);
+            handleGetData();
+            break;
+        case cmdHash("history"):
+            handleHistory(message);
+            break;
+#if NODE_RELAY
+        case cmdHash("pollSub"):
+            handlePollSub(message);
+            break;
+#endif
+        default:
+            LOGW(TAG_LORA, "Unknown command: %.*s", (int)message.len, message.data);
+            break;
+        }
+    }
+
+    void handleGetRssi() {
+        int rssi = LoRa.packetRssi();  // RSSI của gói tin gần nhất từ Gateway
+        int len = snprintf(txBuffer_, sizeof(txBuffer_),
+                           "{\"nodeId\":%d,\"status\":\"online\",\"rssi\":%d}", Address, rssi);
+        sendToGateway(txBuffer_, advance(0, len));
+    }
+
+    void handleGetDiag() {
+        // Chừa 1 byte cho '}' đóng object ngoài
+        size_t len = advance(0, snprintf(txBuffer_, sizeof(txBuffer_), "{\"nodeId\":%d,\"diag\":", Address));
+        len += diagFormat(txBuffer_ + len, sizeof(txBuffer_) - len - 1);
+        txBuffer_[len++] = '}';
+        txBuffer_[len] = '\0';
+        sendToGateway(txBuffer_, len);
+    }
+
+    void handleGetData() {
+        state_ = IDLE;
+        batchFrames_ = 0;
+        sensor.sample(clock_);
+
+        // Chọn các kênh cần gửi
+        uint32_t nowSec = millis() / 1000;
+        reportMask_ = 0;
+        for (int ch = 0; ch < Sensor::CHANNELS; ch++) {
+            if (!REPORT_BY_EXCEPTION || reportFilters_[ch].shouldReport(sensor.value(ch), nowSec)) {
+                reportMask_ |= 1 << ch;
+            }
+        }
+
+        if (!reportMask_ && !sensor.batchPending()) {
+            if (sendToGateway(REPORT_NO_CHANGE)) {
+                LOGI(TAG_LORA, "No change beyond deadband, sent '%s'", REPORT_NO_CHANGE);
+                sensor.commit();
+                state_ = COMPLETED;
+            }
+            return;
+        }
+        sendNextChannel(0);
+    }
+
+    void handleOk() {
+        if (state_ == SENDING) {
+            if (sentChannel_ == Sensor::CHANNELS) {
+                sensor.batchSent();
+                batchFrames_++;
+            }
+            sendNextChannel(sentChannel_ + 1);
+        } else {
+            LOGW(TAG_LORA, "Received unexpected ok%d command", Address);
+        }
+    }
+
+    // Gửi kênh kế tiếp trong reportMask_, hết kênh thì gửi "end"
+    void sendNextChannel(int fromChannel) {
+        for (int ch = fromChannel; ch < Sensor::CHANNELS; ch++) {
+            if (!(reportMask_ & (1 << ch))) continue;
+
+            if (sendToGateway(txBuffer_, formatReading(ch))) {
+                LOGD(TAG_LORA, "Sent %s data successfully", sensor.id(ch));
+                sentChannel_ = ch;
+                state_ = SENDING;
+                sendingSince_ = millis();
+            } else {
+                LOGE(TAG_LORA, "Failed to send %s data", sensor.id(ch));
+                state_ = IDLE;
+            }
+            return;
+        }
+
+        // Frame lô, sentChannel_ = Sensor::CHANNELS đánh dấu đang chờ ack lô
+        if (batchFrames_ < NODE_BATCH_FRAMES_MAX && sensor.batchPending()) {
+            size_t len = formatBatch();
+            if (len && sendToGateway(txBuffer_, len)) {
+                sentChannel_ = Sensor::CHANNELS;
+                state_ = SENDING;
+                sendingSince_ = millis();
+                return;
+            }
+            LOGE(TAG_LORA, "Failed to send batch frame");
+        }
+
+        if (sendToGateway("end")) {
+            uint32_t nowSec = millis() / 1000;
+            for (int ch = 0; ch < Sensor::CHANNELS; ch++) {
+                if (reportMask_ & (1 << ch)) reportFilters_[ch].markReported(sensor.value(ch), nowSec);
+            }
+
+            // Commit temp values vào EEPROM sau khi gửi thành công
+            sensor.commit();
+            LOGI(TAG_LORA, "Data transmission completed and values committed");
+            state_ = COMPLETED;
+        } else {
+            LOGE(TAG_LORA, "Failed to send end signal");
+        }
+    }
+
+    // Ghi một bản ghi khi sang khoảng HISTORY_INTERVAL_S mới, chỉ khi đồng
+    // hồ đã đồng bộ
+    void historyTick() {
+        uint32_t now = clock_.now();
+        if (!history_.due(now)) return;
+        float values[HISTORY_CHANNELS];
+        for (int ch = 0; ch < HISTORY_CHANNELS; ch++) values[ch] = NAN;
+        sensor.historyValues(values);
+        history_.append(now, values);
+    }
+
+    // {"command":"history","since":S,"win":W}: tối đa W frame liền nhau
+    // {"nodeId":N,"h":<seq đầu>,"b":"<base64>"} từ bản ghi S (hoặc bản ghi
+    // cũ nhất còn lại), không chờ ack từng frame, rồi frame kết thúc
+    // {"nodeId":N,"hnext":<seq chưa gửi>,"hfirst":F,"hlast":L}. Node không
+    // giữ trạng thái: Gateway thiếu frame nào thì hỏi lại từ đó. W = 0 chỉ
+    // hỏi vị trí của sổ.
+    void handleHistory(MsgView message) {
+        uint32_t next = commandUintField(message, "\"since\":");
+        uint32_t window = commandUintField(message, "\"win\":");
+        if (window > HISTORY_WINDOW_MAX) window = HISTORY_WINDOW_MAX;
+        if (next < history_.first()) next = history_.first();
+        LOGI(TAG_HIST, "History from %lu, %lu frames requested", (unsigned long)next, (unsigned long)window);
+
+        for (uint32_t frame = 0; frame < window && next <= history_.last(); frame++) {
+            uint32_t start = next;
+            if (!sendToGateway(txBuffer_, formatHistory(next))) {
+                next = start;
+                break;
+            }
+        }
+        int len = snprintf(txBuffer_, sizeof(txBuffer_), "{\"nodeId\":%d,\"hnext\":%lu,\"hfirst\":%lu,\"hlast\":%lu}",
+                           Address, (unsigned long)next, (unsigned long)history_.first(),
+                           (unsigned long)history_.last());
+        sendToGateway(txBuffer_, advance(0, len));
+    }
+
+    // Frame lịch sử từ bản ghi next, next tiến qua các bản ghi đã đưa vào
+    size_t formatHistory(uint32_t& next) {
+        uint8_t bytes[HISTORY_FRAME_RECORDS * HISTORY_WIRE_BYTES];
+        uint8_t* p = bytes;
+        uint32_t start = next;
+        for (int i = 0; i < HISTORY_FRAME_RECORDS && next <= history_.last(); i++, next++) {
+            HistoryRecord record;
+            if (!history_.read(next, record)) {
+                record.ts = 0;
+                for (int ch = 0; ch < HISTORY_CHANNELS; ch++) record.v[ch] = NAN;
+            }
+            p = historyEncode(record, p);
+        }
+        char encoded[BASE64_LEN(sizeof(bytes)) + 1];
+        base64Encode(bytes, p - bytes, encoded);
+        return advance(0, snprintf(txBuffer_, sizeof(txBuffer_), "{\"nodeId\":%d,\"h\":%lu,\"b\":\"%s\"}", Address,
+                                   (unsigned long)start, encoded));
+    }
+
+    void sendPendingAlert() {
+        if (!alertPending_) {
+            if (!sensor.takeAlert(alert_)) return;
+            alertPending_ = true;
+            alertEpoch_ = clock_.now();
+            alertSeq_ = ++frameSeq_;
+            alertAttempts_ = 0;
+        }
+
+        // Không chen vào giữa một lượt gửi dữ liệu còn đang chờ ack
+        if (state_ == SENDING) {
+            if (millis() - sendingSince_ < NODE_EXCHANGE_TIMEOUT_MS) return;
+            LOGW(TAG_LORA, "No ok%d within %d ms, data exchange abandoned", Address, NODE_EXCHANGE_TIMEOUT_MS);
+            state_ = IDLE;
+        }
+        if (alertAttempts_ && millis() - lastAlertSend_ < ALERT_RETRY_MS) return;
+        if (alertAttempts_ >= ALERT_MAX_ATTEMPTS) {
+            LOGE(TAG_LORA, "Alert not acknowledged after %d attempts, dropped", alertAttempts_);
+            alertPending_ = false;
+            return;
+        }
+
+        size_t len = advance(0, snprintf(txBuffer_, sizeof(txBuffer_), "{\"nodeId\":%d,", Address));
+        len = advance(len, sensor.formatAlert(txBuffer_ + len, sizeof(txBuffer_) - len, alert_));
+        sendTo(gatewayAddress_, txBuffer_, closeFrame(len, alertSeq_, alertEpoch_));
+        alertAttempts_++;
+        lastAlertSend_ = millis();
+    }
+
+    // {"nodeId":N,"sensorId":"...",<trường của Sensor>,"seq":S,"ts":T}
+    size_t formatReading(int ch) {
+        unsigned seq = ++frameSeq_;
+        size_t len = advance(0, snprintf(txBuffer_, sizeof(txBuffer_), "{\"nodeId\":%d,\"sensorId\":\"%s\",",
+                                         Address, sensor.id(ch)));
+        len = advance(len, sensor.formatFields(txBuffer_ + len, sizeof(txBuffer_) - len, ch));
+        len = closeFrame(len, seq, sensor.epoch(ch));
+        LOGD(TAG_SENSOR, "Sensor data: %s", txBuffer_);
+        return len;
+    }
+
+    // {"nodeId":N,<lô của Sensor>,"seq":S}, 0 nếu Sensor không còn gì để gửi
+    size_t formatBatch() {
+        size_t len = advance(0, snprintf(txBuffer_, sizeof(txBuffer_), "{\"nodeId\":%d,", Address));
+        size_t body = advance(len, sensor.formatBatch(txBuffer_ + len, sizeof(txBuffer_) - len));
+        if (body == len) return 0;
+        return closeFrame(body, ++frameSeq_, 0);
+    }
+
+    // Thêm seq và ts rồi đóng object. ts = 0 (chưa đồng bộ giờ) thì bỏ
+    // trường "ts", backend dùng giờ nhận.
+    size_t closeFrame(size_t len, unsigned seq, uint32_t ts) {
+        int n = ts ? snprintf(txBuffer_ + len, sizeof(txBuffer_) - len, ",\"seq\":%u,\"ts\":%lu}", seq,
+                              (unsigned long)ts)
+                   : snprintf(txBuffer_ + len, sizeof(txBuffer_) - len, ",\"seq\":%u}", seq);
+        return advance(len, n);
+    }
+
+    // Cộng độ dài snprintf vào len, kẹp trong txBuffer_
+    size_t advance(size_t len, int written) const {
+        if (written < 0) return len;
+        size_t end = len + (size_t)written;
+        return end < sizeof(txBuffer_) ? end : sizeof(txBuffer_) - 1;
+    }
+
+    bool sendToGateway(const char* message) {
+        return sendToGateway(message, strlen(message));
+    }
+
+    // Trả lời nơi gửi lệnh đang xử lý (Gateway, hoặc relay khi poll cây con)
+    bool sendToGateway(const char* message, size_t len) {
+        return sendTo(replyTo_, message, len);
+    }
+
+    // Frame thường nếu dest là Gateway nghe trực tiếp, còn lại frame định
+    // tuyến qua next hop trong bảng
+    bool sendTo(int dest, const char* message, size_t len) {
+        LOGD(TAG_LORA, "Sending to %d: %.*s", dest, (int)len, message);
+
+        // Nghe trước khi phát (radio.h) thay cho delay ngẫu nhiên
+        uint8_t via = routes_.nextHop(dest, millis());
+        bool success = isGatewayAddress(dest) && via == dest
+            ? radioSend(Address, dest, message, len)
+            : radioSendRouted(meshOriginate(Address, dest, via, ++meshMsgId_), message, len);
+        if (!success) LOGE(TAG_LORA, "Failed to send message");
+        return success;
+    }
+
+#if NODE_RELAY
+    // {"command":"pollSub","nodes":[1,3],"time":T}: poll từng node con như
+    // Gateway làm với node trực tiếp, gộp frame của chúng vào frame
+    // "agg<R>" (mesh.h) với một ack "ag<R>" mỗi frame gộp, thay cho một
+    // lượt getData/ok qua hai chặng cho mỗi frame, rồi "end"
+    void handlePollSub(MsgView message) {
+        uint8_t children[RELAY_MAX_CHILDREN];
+        int count = parseChildren(message, children);
+        int gateway = replyTo_;
+        LOGI(TAG_LORA, "Polling %d child nodes for Gateway %d", count, gateway);
+
+        aggLen_ = 0;
+        flushBacklog(gateway);
+        for (int i = 0; i < count; i++) pollChild(children[i], gateway);
+        flushAggregate(gateway);
+        replyTo_ = gateway;
+        sendToGateway("end");
+    }
+
+    static int parseChildren(MsgView message, uint8_t* out) {
+        static const char KEY[] = "\"nodes\":[";
+        const char* p = strstr(message.data, KEY);
+        if (!p) return 0;
+        p += sizeof(KEY) - 1;
+        int count = 0;
+        while (count < RELAY_MAX_CHILDREN) {
+            char* end;
+            unsigned long node = strtoul(p, &end, 10);
+            if (end == p) break;
+            out[count++] = (uint8_t)node;
+            p = *end == ',' ? end + 1 : end;
+        }
+        return count;
+    }
+
+    // Thời gian gửi node con lấy từ đồng hồ của relay, vừa đồng bộ theo pollSub
+    void pollChild(int child, int gateway) {
+        char command[72];
+        uint32_t now = clock_.now();
+        int len = now ? snprintf(command, sizeof(command), "{\"command\":\"getData%d\",\"nodeId\":%d,\"time\":%lu}",
+                                 child, child, (unsigned long)now)
+                      : snprintf(command, sizeof(command), "{\"command\":\"getData%d\",\"nodeId\":%d}", child, child);
+        if (!sendTo(child, command, len)) {
+            appendStatus(gateway, "to", child);
+            return;
+        }
+
+        MsgView reply;
+        while (awaitFrame(child, reply, RELAY_CHILD_TIMEOUT_MS)) {
+            if (reply.equals("end") || reply.equals(REPORT_NO_CHANGE)) {
+                appendStatus(gateway, "end", child);
+                return;
+            }
+            // rxBuffer_ bị ghi đè nếu phải chờ ack của frame gộp trước
+            size_t len = reply.len < FRAME_PAYLOAD_MAX ? reply.len : FRAME_PAYLOAD_MAX;
+            memcpy(txBuffer_, reply.data, len);
+            appendAggregate(gateway, txBuffer_, len);
+            char ok[8];
+            sendTo(child, ok, snprintf(ok, sizeof(ok), "ok%d", child));
+        }
+        LOGW(TAG_LORA, "Child node %d timed out", child);
+        appendStatus(gateway, "to", child);
+    }
+
+    // Chờ frame kế tiếp từ from, vẫn chuyển tiếp frame của nút khác
+    bool awaitFrame(int from, MsgView& reply, unsigned long timeoutMs) {
+        unsigned long start = millis();
+        while (millis() - start < timeoutMs) {
+            int sender;
+            if (receiveFrame(sender, reply) && sender == from) return true;
+        }
+        return false;
+    }
+
+    // Thêm một dòng vào frame gộp, gửi frame đang dựng trước nếu không đủ chỗ
+    void appendAggregate(int gateway, const char* line, size_t len) {
+        if (aggLen_ && aggLen_ + 1 + len > MESH_AGG_MAX) flushAggregate(gateway);
+        if (!aggLen_) aggLen_ = (size_t)snprintf(aggBuffer_, sizeof(aggBuffer_), "agg%d", Address);
+        if (aggLen_ + 1 + len > MESH_AGG_MAX) {
+            LOGE(TAG_LORA, "Child frame of %u bytes does not fit an aggregate", (unsigned)len);
+            return;
+        }
+        aggBuffer_[aggLen_++] = '\n';
+        memcpy(aggBuffer_ + aggLen_, line, len);
+        aggLen_ += len;
+        aggBuffer_[aggLen_] = '\0';
+    }
+
+    void appendStatus(int gateway, const char* kind, int child) {
+        char line[12];
+        appendAggregate(gateway, line, (size_t)snprintf(line, sizeof(line), "%s%d", kind, child));
+    }
+
+    // Node con đã nhận ok và commit trước khi frame gộp được ack, nên frame
+    // gộp không được ack thì giữ lại cho lần pollSub sau chứ không bỏ
+    bool flushAggregate(int gateway) {
+        if (!aggLen_) return true;
+        bool acked = sendAggregate(gateway, aggBuffer_, aggLen_);
+        if (!acked) retainAggregate();
+        aggLen_ = 0;
+        return acked;
+    }
+
+    // Frame gộp gửi lại khi mất ack; Gateway có thể nhận một frame con hai
+    // lần trong vài giây, backend bỏ bản trùng theo seq
+    bool sendAggregate(int gateway, const char* data, size_t len) {
+        char ack[8];
+        snprintf(ack, sizeof(ack), "ag%d", Address);
+        for (int attempt = 0; attempt < RELAY_AGG_ATTEMPTS; attempt++) {
+            MsgView reply;
+            if (sendTo(gateway, data, len) && awaitFrame(gateway, reply, RELAY_ACK_TIMEOUT_MS) && reply.equals(ack)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Đưa frame gộp đang dựng vào backlog_ với đầu "agl<R>", đầy thì bỏ
+    // frame cũ nhất. Có thể Gateway đã nhận và chỉ mất ack: bản gửi lại ở
+    // lần pollSub sau đến muộn hơn cửa sổ khử trùng của backend, Gateway tự
+    // bỏ các frame nó đã đẩy lên (Gateway/pushedFrames.h)
+    void retainAggregate() {
+        if (backlogCount_ == RELAY_AGG_BACKLOG) {
+            LOGE(TAG_LORA, "Aggregate backlog full, %u bytes dropped", (unsigned)backlogLen_[0]);
+            dropBacklog(1);
+        }
+        aggBuffer_[2] = 'l';
+        memcpy(backlog_[backlogCount_], aggBuffer_, aggLen_ + 1);
+        backlogLen_[backlogCount_++] = aggLen_;
+        LOGW(TAG_LORA, "Aggregate not acknowledged, %u bytes kept for the next poll", (unsigned)aggLen_);
+    }
+
+    // Gửi backlog_ theo thứ tự, dừng ở frame đầu tiên không được ack
+    void flushBacklog(int gateway) {
+        int sent = 0;
+        while (sent < backlogCount_ && sendAggregate(gateway, backlog_[sent], backlogLen_[sent])) sent++;
+        if (!sent) return;
+        LOGI(TAG_LORA, "%d kept aggregates delivered", sent);
+        dropBacklog(sent);
+    }
+
+    void dropBacklog(int count) {
+        backlogCount_ -= count;
+        memmove(backlog_[0], backlog_[count], backlogCount_ * sizeof(backlog_[0]));
+        memmove(backlogLen_, backlogLen_ + count, backlogCount_ * sizeof(backlogLen_[0]));
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef RADIO_H
+#define RADIO_H
+
+#include <Arduino.h>
+#include <LoRa.h>
+#include "lbt.h"
+#include "log.h"
+#include "mesh.h"
+
+// Chính sách phát:
+//   TX_POLICY_RANDOM_DELAY - chờ ngẫu nhiên 100-500 ms rồi phát (cách cũ)
+//   TX_POLICY_LBT_CAD      - nghe trước bằng CAD của SX127x, kênh bận thì
+//                            backoff lũy thừa (lbt.h), kênh rảnh thì phát ngay
+#define TX_POLICY_RANDOM_DELAY 0
+#define TX_POLICY_LBT_CAD      1
+
+#ifndef RADIO_TX_POLICY
+#define RADIO_TX_POLICY TX_POLICY_LBT_CAD
+#endif
+
+// Header chỉ được include bởi một file .cpp mỗi firmware, nên trạng thái
+// static dưới đây chỉ có một bản.
+static volatile bool radioCadDone = false;
+static volatile bool radioCadDetected = false;
+
+// Ngắt CadDone trên DIO0. Sau CAD, DIO0 vẫn map vào CadDone nên không phát
+// sinh ngắt khi parsePacket() nhận ở chế độ polling.
+static void IRAM_ATTR radioOnCadDone(bool detected) {
+    radioCadDetected = detected;
+    radioCadDone = true;
+}
+
+// Gọi sau LoRa.begin()
+inline void radioInit() {
+#if RADIO_TX_POLICY == TX_POLICY_LBT_CAD
+    LoRa.onCadDone(radioOnCadDone);
+#endif
+}
+
+// Một lần CAD; quá thời gian thì coi như kênh rảnh
+inline bool radioChannelBusy() {
+    radioCadDone = false;
+    LoRa.channelActivityDetection();
+    unsigned long start = millis();
+    while (!radioCadDone) {
+        if (millis() - start >= LBT_CAD_TIMEOUT_MS) return false;
+        delayMicroseconds(100);
+    }
+    return radioCadDetected;
+}
+
+// Chờ kênh rảnh theo chính sách phát
+inline void radioWaitClear() {
+#if RADIO_TX_POLICY == TX_POLICY_LBT_CAD
+    for (int attempt = 0; attempt < LBT_MAX_ATTEMPTS; attempt++) {
+        if (!radioChannelBusy()) return;
+        uint32_t slots = lbtBackoffSlots(attempt, (uint32_t)random(0x7FFFFFFF));
+        LOGD(TAG_LORA, "Channel busy, backoff %lu slots", (unsigned long)slots);
+        delay(slots * LBT_SLOT_MS);
+    }
+    LOGW(TAG_LORA, "Channel still busy after %d CAD, sending anyway", LBT_MAX_ATTEMPTS);
+#else
+    delay(random(100, 500)); // Random delay để tránh collision
+#endif
+}
+
+// Phát một frame: 2 byte địa chỉ theo thứ tự giao thức của nơi gọi, rồi payload
+inline bool radioSend(uint8_t addr0, uint8_t addr1, const char* payload, size_t len) {
+    radioWaitClear();
+    LoRa.beginPacket();
+    LoRa.write(addr0);
+    LoRa.write(addr1);
+    LoRa.write((const uint8_t*)payload, len);
+    return LoRa.endPacket();
+}
+
+// Phát một frame định tuyến (mesh.h): header rồi payload
+inline bool radioSendRouted(const MeshHeader& header, const char* payload, size_t len) {
+    uint8_t raw[MESH_HEADER_LEN];
+    meshEncode(header, raw);
+    radioWaitClear();
+    LoRa.beginPacket();
+    LoRa.write(raw, MESH_HEADER_LEN);
+    LoRa.write((const uint8_t*)payload, len);
+    return LoRa.endPacket();
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef REPORT_FILTER_H
+#define REPORT_FILTER_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Report-by-exception: khi bật, node chỉ gửi các kênh đã thay đổi vượt
+// ngưỡng (hoặc quá lâu chưa gửi); nếu không kênh nào cần gửi thì trả lời
+// Gateway bằng một frame "nc" (no change). Tắt = gửi mọi kênh mỗi lần poll.
+#ifndef REPORT_BY_EXCEPTION
+#define REPORT_BY_EXCEPTION 1
+#endif
+
+// Frame trả lời khi không có kênh nào cần gửi, thay cho dữ liệu + "end"
+#define REPORT_NO_CHANGE "nc"
+
+struct Deadband {
+    float absolute;         // ngưỡng tuyệt đối theo đơn vị của kênh, 0 = không dùng
+    float percent;          // ngưỡng tương đối, % của giá trị đã gửi lần trước, 0 = không dùng
+    uint32_t heartbeatSec;  // gửi lại sau tối đa ngần này giây dù không đổi, 0 = không heartbeat
+};
+
+// Trạng thái báo cáo của một kênh. Không phụ thuộc Arduino: thời gian do
+// nơi gọi truyền vào (giây, đơn điệu), để mô phỏng trên máy tính dùng chung.
+class ReportFilter {
+public:
+    explicit ReportFilter(const Deadband& band) : band_(band) {}
+
+    // Không ngưỡng: gửi khi có bất kỳ thay đổi nào (NodeRuntime gán ngưỡng lúc begin())
+    ReportFilter() : band_() {}
+
+    bool shouldReport(float value, uint32_t nowSec) const {
+        if (!reported_) return true;
+        if (band_.heartbeatSec && nowSec - lastSec_ >= band_.heartbeatSec) return true;
+
+        float delta = fabsf(value - last_);
+        if (band_.absolute <= 0 && band_.percent <= 0) return delta > 0;
+        if (band_.absolute > 0 && delta >= band_.absolute) return true;
+        if (band_.percent > 0 && delta >= fabsf(last_) * band_.percent / 100.0f) return true;
+        return false;
+    }
+
+    // Chỉ gọi khi Gateway đã nhận đủ (sau "end"), để lần gửi lỗi được gửi lại
+    void markReported(float value, uint32_t nowSec) {
+        last_ = value;
+        lastSec_ = nowSec;
+        reported_ = true;
+    }
+
+private:
+    Deadband band_;
+    float last_ = 0;
+    uint32_t lastSec_ = 0;
+    bool reported_ = false;
+};
+
+#endif
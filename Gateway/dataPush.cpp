@@ -1,150 +1,211 @@
 #include "dataPush.h"
+#include "metrics.h"
+#include "payload.h"
+#if UPLINK_MQTT
+#include "mqttUplink.h"
+#endif
+#include "../Common/gateways.h"
+#include "../Common/log.h"
 
 WiFiManager wifiManager;
-String serverUrl = "http://192.168.0.150:3000/stream_data";
-
-void internetInit(){
-    // WiFi.mode(WIFI_STA);
-    // wm.setConfigPortalBlocking(false);
-    // wm.setConfigPortalTimeout(60);
-    // bool res;
-    // res = wm.autoConnect("Gateway1", "mesh1234");
-    // if (!res){
-    //     Serial.println("Failed to connect!");
-    // }
-    // else {
-    //     Serial.println("Connected!");
-    // }
-
-    wifiManager.setConfigPortalTimeout(180);
-    if(!wifiManager.autoConnect("GATEWAY-01","12345678")) {
-        Serial.println("failed to connect and hit timeout");
-        delay(3000);
-        //reset and try again, or maybe put it to deep sleep
-        delay(5000);
-      } 
-}
-
-void PusherE(const String &nodeId ,const String &sensorId, float power, float voltage = 0){
-     if (WiFi.status() == WL_CONNECTED)
-    {
-        HTTPClient http;
+const char* serverUrl = "http://192.168.0.150:3000/stream_data";
+const char* metricsUrl = "http://192.168.0.150:3000/metrics";
+
+// Buffer tĩnh cho payload JSON gửi lên server
+static char payloadBuffer[192];
+
+// WiFi state machine, see internetTick()
+enum WifiState : uint8_t {
+    WIFI_CONNECTING,
+    WIFI_UP,
+    WIFI_BACKOFF,
+    WIFI_PORTAL,
+};
+static WifiState wifiState = WIFI_CONNECTING;
+static unsigned long wifiSince = 0;
+static unsigned long wifiBackoffMs = WIFI_BACKOFF_MIN_MS;
+static uint8_t wifiFails = 0;
+
+// Join the network WiFiManager saved
+static void wifiConnect() {
+    WiFi.begin();
+    wifiState = WIFI_CONNECTING;
+    wifiSince = millis();
+}
 
-         // Thay bằng IP của server
-        http.begin(serverUrl);
-        http.addHeader("Content-Type", "application/json");
+static void wifiStartPortal() {
+    LOGW(TAG_WIFI, "Config portal open: %s", WIFI_PORTAL_SSID);
+    wifiManager.startConfigPortal(WIFI_PORTAL_SSID, WIFI_PORTAL_PASSWORD);
+    wifiState = WIFI_PORTAL;
+    wifiSince = millis();
+}
 
-        // Tạo JSON string
-        String jsonPayload = "{";
-        jsonPayload += "\"node_id\":\"" + nodeId + "\",";
-        jsonPayload += "\"sensor_id\":\"" + sensorId + "\",";       
-        jsonPayload += "\"power\":" + String(power);
-        if (voltage > 0)
-        {
-            jsonPayload += ",\"voltage\":" + String(voltage);
-        }
-        jsonPayload += "}";
+static void wifiConnected() {
+    LOGI(TAG_WIFI, "Connected, IP %s", WiFi.localIP().toString().c_str());
+    metrics.wifiConnects++;
+    wifiState = WIFI_UP;
+    wifiFails = 0;
+    wifiBackoffMs = WIFI_BACKOFF_MIN_MS;
+}
 
-        // Gửi POST request
-        Serial.println(jsonPayload);
-        int httpResponseCode = http.POST(jsonPayload);
+static void wifiFailed() {
+    WiFi.disconnect();
+    if (++wifiFails >= WIFI_PORTAL_AFTER_FAILS) {
+        wifiFails = 0;
+        wifiStartPortal();
+        return;
+    }
+    LOGW(TAG_WIFI, "Connect failed (%u), retry in %lu ms", wifiFails, wifiBackoffMs);
+    wifiState = WIFI_BACKOFF;
+    wifiSince = millis();
+}
 
-        Serial.print("HTTP Response code: ");
-        Serial.println(httpResponseCode);
+void internetInit(){
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);   // reconnects go through internetTick(), with backoff
+    wifiManager.setConfigPortalBlocking(false);
+    wifiManager.setConfigPortalTimeout(WIFI_PORTAL_TIMEOUT_S);
+    if (wifiManager.getWiFiIsSaved()) {
+        wifiConnect();
+    } else {
+        wifiStartPortal();
+    }
+    uplink().begin();
+}
 
-        if (httpResponseCode == 200)
-        {
-            Serial.println("✅ Gửi dữ liệu thành công\n");
+void internetTick() {
+    unsigned long now = millis();
+    switch (wifiState) {
+    case WIFI_CONNECTING:
+        if (WiFi.status() == WL_CONNECTED) {
+            wifiConnected();
+        } else if (now - wifiSince >= WIFI_CONNECT_TIMEOUT_MS) {
+            wifiFailed();
         }
-        else
-        {
-            Serial.println("❌ Gửi dữ liệu thất bại\n");
+        break;
+    case WIFI_UP:
+        if (WiFi.status() != WL_CONNECTED) {
+            LOGW(TAG_WIFI, "Link lost, reconnecting");
+            wifiConnect();
         }
-
-        http.end();
-    }
-    else
-    {
-        Serial.println("⚠️ WiFi chưa kết nối!");
+        break;
+    case WIFI_BACKOFF:
+        if (now - wifiSince >= wifiBackoffMs) {
+            wifiBackoffMs = wifiBackoffMs * 2 < WIFI_BACKOFF_MAX_MS ? wifiBackoffMs * 2 : WIFI_BACKOFF_MAX_MS;
+            wifiConnect();
+        }
+        break;
+    case WIFI_PORTAL:
+        // process() is true once a network was configured and joined
+        if (wifiManager.process()) {
+            wifiConnected();
+        } else if (!wifiManager.getConfigPortalActive()) {
+            wifiConnect();
+        }
+        break;
     }
 }
 
-void PusherW(const String &nodeId,const String &sensorId, float water){
-    if (WiFi.status() == WL_CONNECTED)
+// POST một payload JSON đã mã hóa sẵn lên server
+static bool postPayload(const char* url, const char* payload, size_t len) {
+    bool ok = false;
+     if (WiFi.status() == WL_CONNECTED)
     {
         HTTPClient http;
+        unsigned long startTime = millis();
 
          // Thay bằng IP của server
-        http.begin(serverUrl);
+        http.begin(url);
         http.addHeader("Content-Type", "application/json");
 
-        // Tạo JSON string
-        String jsonPayload = "{";
-        jsonPayload += "\"node_id\":\"" + nodeId + "\",";
-        jsonPayload += "\"sensor_id\":\"" + sensorId + "\",";
-        jsonPayload += "\"water\":" + String(water);
-        jsonPayload += "}";
-
         // Gửi POST request
-        Serial.println(jsonPayload);
-        int httpResponseCode = http.POST(jsonPayload);
-
-        Serial.print("HTTP Response code: ");
-        Serial.println(httpResponseCode);
+        LOGD(TAG_HTTP, "%.*s", (int)len, payload);
+        int httpResponseCode = http.POST((uint8_t*)payload, len);
 
         if (httpResponseCode == 200)
         {
-            Serial.println("✅ Gửi dữ liệu thành công\n");
+            metrics.httpOk++;
+            ok = true;
+            LOGD(TAG_HTTP, "✅ Gửi dữ liệu thành công");
         }
         else
         {
-            Serial.println("❌ Gửi dữ liệu thất bại\n");
+            metrics.httpFail++;
+            LOGE(TAG_HTTP, "❌ Gửi dữ liệu thất bại, HTTP Response code: %d", httpResponseCode);
         }
 
         http.end();
+        metrics.httpLatency.observe(millis() - startTime);
     }
     else
     {
-        Serial.println("⚠️ WiFi chưa kết nối!");
+        LOGW(TAG_HTTP, "⚠️ WiFi chưa kết nối!");
     }
+    return ok;
 }
 
-void PushRssi(String const &nodeId,int rssi){
-        if (WiFi.status() == WL_CONNECTED)
-    {
-        HTTPClient http;
+// Uplink HTTP: mỗi payload là một POST riêng
+class HttpUplink : public Uplink {
+public:
+    bool publish(UplinkChannel channel, const char* source, const char* payload, size_t len) override {
+        return postPayload(channel == UPLINK_METRICS ? metricsUrl : serverUrl, payload, len);
+    }
+};
+
+Uplink& uplink() {
+#if UPLINK_MQTT
+    static MqttUplink instance;
+#else
+    static HttpUplink instance;
+#endif
+    return instance;
+}
 
-        // Thay bằng IP của server
-        http.begin(serverUrl);
-        http.addHeader("Content-Type", "application/json");
+void PusherE(const char* nodeId, const char* sensorId, float power, float voltage, uint32_t ts,
+             const PayloadLink& link){
+    size_t len = formatPayloadE(payloadBuffer, sizeof(payloadBuffer), nodeId, sensorId, power, voltage, ts,
+                                &link);
+    uplink().publish(UPLINK_READING, nodeId, payloadBuffer, len);
+}
 
-        // Tạo JSON string
-        String jsonPayload = "{";
-        jsonPayload += "\"node_id\":\"" + nodeId + "\",";
-        jsonPayload += "\"sensor_id\":\"rssi\",";  // chọn collection
-        jsonPayload += "\"rssi\":" + String(rssi);
-        jsonPayload += "}";
+void PusherW(const char* nodeId, const char* sensorId, float water, uint32_t ts, const PayloadLink& link){
+    size_t len = formatPayloadW(payloadBuffer, sizeof(payloadBuffer), nodeId, sensorId, water, ts, &link);
+    uplink().publish(UPLINK_READING, nodeId, payloadBuffer, len);
+}
 
-        // Gửi POST request
-        Serial.println(jsonPayload);
-        int httpResponseCode = http.POST(jsonPayload);
+void PushRssi(const char* nodeId, int rssi, const PayloadLink& link){
+    size_t len = formatPayloadRssi(payloadBuffer, sizeof(payloadBuffer), nodeId, rssi, &link);
+    uplink().publish(UPLINK_READING, nodeId, payloadBuffer, len);
+}
 
-        Serial.print("HTTP Response code: ");
-        Serial.println(httpResponseCode);
+void PushAlert(const char* nodeId, const char* sensorId, const char* kind, float litresPerMin,
+               uint32_t durationSec, uint32_t ts, const PayloadLink& link){
+    size_t len = formatPayloadAlert(payloadBuffer, sizeof(payloadBuffer), nodeId, sensorId, kind,
+                                    litresPerMin, durationSec, ts, &link);
+    uplink().publish(UPLINK_READING, nodeId, payloadBuffer, len);
+}
 
-        if (httpResponseCode == 200)
-        {
-            Serial.println("✅ Gửi dữ liệu thành công\n");
-        }
-        else
-        {
-            Serial.println("❌ Gửi dữ liệu thất bại\n");
-        }
+void PushPowerQuality(const char* nodeId, const char* sensorId, const char* records, uint32_t t0,
+                      uint32_t iv, const PayloadLink& link){
+    size_t len = formatPayloadPq(payloadBuffer, sizeof(payloadBuffer), nodeId, sensorId, records, t0, iv, &link);
+    uplink().publish(UPLINK_READING, nodeId, payloadBuffer, len);
+}
 
-        http.end();
-    }
-    else
-    {
-        Serial.println("⚠️ WiFi chưa kết nối!");
+bool PushHistory(const char* nodeId, const char* records, uint32_t first, const PayloadLink& link){
+    size_t len = formatPayloadHistory(payloadBuffer, sizeof(payloadBuffer), nodeId, records, first, &link);
+    return uplink().publish(UPLINK_READING, nodeId, payloadBuffer, len);
+}
+
+void PushMetrics(const char* payload, size_t len){
+    uplink().publish(UPLINK_METRICS, GATEWAY_NAME, payload, len);
+}
+
+void PushNodeDiag(const char* nodeId, const char* diagJson, size_t len){
+    int n = snprintf(payloadBuffer, sizeof(payloadBuffer), "{\"gateway_id\":\"%s\",\"node_id\":\"%s\",\"diag\":%.*s}",
+                     GATEWAY_NAME, nodeId, (int)len, diagJson);
+    if (n < 0 || n >= (int)sizeof(payloadBuffer)) {
+        LOGW(TAG_HTTP, "Diag payload of %s too large, not pushed", nodeId);
+        return;
     }
-}
\ No newline at end of file
+    uplink().publish(UPLINK_METRICS, GATEWAY_NAME, payloadBuffer, n);
+}
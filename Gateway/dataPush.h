@@ -5,12 +5,46 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <WiFiManager.h>
+#include "uplink.h"
+#include "payload.h"
 
 
+// WiFi runs as a state machine driven by internetTick() from loop(), so
+// LoRa service starts at once and a lost access point never blocks the
+// Gateway. It joins the network WiFiManager saved and retries with doubling
+// backoff; with nothing saved, or after WIFI_PORTAL_AFTER_FAILS failed
+// attempts, the config portal runs non-blocking next to LoRa service.
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+#define WIFI_BACKOFF_MIN_MS 2000
+#define WIFI_BACKOFF_MAX_MS 300000UL
+#define WIFI_PORTAL_AFTER_FAILS 6
+#define WIFI_PORTAL_TIMEOUT_S 180
+#define WIFI_PORTAL_SSID "GATEWAY-01"
+#define WIFI_PORTAL_PASSWORD "12345678"
+
+// Start WiFi, then the uplink selected by UPLINK_MQTT; returns at once
 void internetInit();
 
-void PusherE(const String &nodeId ,const String &sensorId, float power, float voltage);
-void PusherW(const String &nodeId,const String &sensorId, float water);
-void PushRssi(String const &nodeId,int rssi);
+void internetTick();
+
+// Payloads are encoded into a static buffer, no String is built per reading.
+// ts is the node capture time (UTC epoch seconds), 0 lets the backend use arrival time.
+// link stamps this gateway, the frame RSSI and the node frame counter.
+void PusherE(const char* nodeId, const char* sensorId, float power, float voltage, uint32_t ts,
+             const PayloadLink& link);
+void PusherW(const char* nodeId, const char* sensorId, float water, uint32_t ts, const PayloadLink& link);
+void PushRssi(const char* nodeId, int rssi, const PayloadLink& link);
+void PushAlert(const char* nodeId, const char* sensorId, const char* kind, float litresPerMin,
+               uint32_t durationSec, uint32_t ts, const PayloadLink& link);
+void PushPowerQuality(const char* nodeId, const char* sensorId, const char* records, uint32_t t0,
+                      uint32_t iv, const PayloadLink& link);
+// false when the uplink did not take it, the caller keeps its backfill position
+bool PushHistory(const char* nodeId, const char* records, uint32_t first, const PayloadLink& link);
+
+// Send an already encoded metrics snapshot over the uplink
+void PushMetrics(const char* payload, size_t len);
+
+// Send a node's diagnostics object (Common/diag.h) on the metrics channel
+void PushNodeDiag(const char* nodeId, const char* diagJson, size_t len);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "edgeCache.h"
+#include <time.h>
+
+static const time_t EDGE_MIN_EPOCH = 1700000000;   // earlier means NTP never synced
+
+static EdgeSensor sensors[EDGE_MAX_SENSORS];
+static EdgeNode nodes[EDGE_MAX_NODES];
+static uint16_t sensorCount = 0;
+static uint16_t nodeCount = 0;
+static uint32_t updates = 0;
+static uint32_t evictions = 0;
+static portMUX_TYPE edgeLock = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t edgeNow() {
+    time_t now = time(nullptr);
+    return now > EDGE_MIN_EPOCH ? (uint32_t)now : 0;
+}
+
+// Caller holds edgeLock. When the table is full the least recently updated
+// sensor gives up its slot.
+static EdgeSensor* findOrAddSensor(int node, const char* id, EdgeKind kind) {
+    for (uint16_t i = 0; i < sensorCount; i++) {
+        if (sensors[i].node == node && strncmp(sensors[i].id, id, EDGE_SENSOR_ID_MAX) == 0) {
+            return &sensors[i];
+        }
+    }
+
+    EdgeSensor* slot;
+    if (sensorCount < EDGE_MAX_SENSORS) {
+        slot = &sensors[sensorCount++];
+    } else {
+        slot = &sensors[0];
+        for (uint16_t i = 1; i < sensorCount; i++) {
+            if (sensors[i].touchedMs < slot->touchedMs) slot = &sensors[i];
+        }
+        evictions++;
+    }
+    memset(slot, 0, sizeof(*slot));
+    strncpy(slot->id, id, EDGE_SENSOR_ID_MAX - 1);
+    slot->node = node;
+    slot->kind = kind;
+    return slot;
+}
+
+// Caller holds edgeLock. Nodes are configured, not discovered, so a full
+// table simply stops tracking extra addresses.
+static EdgeNode* findOrAddNode(int address) {
+    for (uint16_t i = 0; i < nodeCount; i++) {
+        if (nodes[i].address == address) return &nodes[i];
+    }
+    if (nodeCount >= EDGE_MAX_NODES) return nullptr;
+    EdgeNode* node = &nodes[nodeCount++];
+    memset(node, 0, sizeof(*node));
+    node->address = address;
+    return node;
+}
+
+static void touchNode(int address, int gwRssi, uint32_t now) {
+    EdgeNode* node = findOrAddNode(address);
+    if (!node) return;
+    node->gwRssi = gwRssi;
+    node->lastSeen = now;
+    node->frames++;
+}
+
+void edgeRecordReading(int node, const char* sensorId, EdgeKind kind, float value, float voltage,
+                       uint32_t ts, int gwRssi) {
+    uint32_t now = edgeNow();
+    if (!ts) ts = now;
+
+    portENTER_CRITICAL(&edgeLock);
+    touchNode(node, gwRssi, now);
+    EdgeSensor* s = findOrAddSensor(node, sensorId, kind);
+    bool hasValue = s->touchedMs != 0;
+
+    // A late copy (another gateway, or a retry) never replaces a newer value
+    if (!hasValue || !ts || ts >= s->ts) {
+        if (ts) {
+            uint32_t hour = ts / 3600;
+            EdgeHour& h = s->hours[hour % EDGE_HOURS];
+            if (h.hour != hour) {
+                h.hour = hour;
+                h.first = hasValue ? s->value : value;
+                h.samples = 0;
+            }
+            h.last = value;
+            h.samples++;
+        }
+        s->value = value;
+        s->voltage = voltage;
+        s->ts = ts;
+        s->gwRssi = gwRssi;
+        updates++;
+    }
+    s->touchedMs = millis() | 1;    // never 0, which marks an empty slot
+    portEXIT_CRITICAL(&edgeLock);
+}
+
+void edgeRecordRssi(int node, int rssi, int gwRssi) {
+    uint32_t now = edgeNow();
+    portENTER_CRITICAL(&edgeLock);
+    touchNode(node, gwRssi, now);
+    EdgeNode* n = findOrAddNode(node);
+    if (n) n->rssi = rssi;
+    portEXIT_CRITICAL(&edgeLock);
+}
+
+void edgeRecordPoll(int node, bool answered) {
+    portENTER_CRITICAL(&edgeLock);
+    EdgeNode* n = findOrAddNode(node);
+    if (n) n->pollTimeouts = answered ? 0 : (n->pollTimeouts < 0xFFFF ? n->pollTimeouts + 1 : 0xFFFF);
+    portEXIT_CRITICAL(&edgeLock);
+}
+
+bool edgeSensorAt(int index, EdgeSensor& out) {
+    bool found = false;
+    portENTER_CRITICAL(&edgeLock);
+    if (index >= 0 && index < sensorCount) {
+        out = sensors[index];
+        found = true;
+    }
+    portEXIT_CRITICAL(&edgeLock);
+    return found;
+}
+
+bool edgeFindSensor(const char* id, EdgeSensor& out) {
+    bool found = false;
+    portENTER_CRITICAL(&edgeLock);
+    for (uint16_t i = 0; i < sensorCount && !found; i++) {
+        if (strncmp(sensors[i].id, id, EDGE_SENSOR_ID_MAX) == 0) {
+            out = sensors[i];
+            found = true;
+        }
+    }
+    portEXIT_CRITICAL(&edgeLock);
+    return found;
+}
+
+bool edgeNodeAt(int index, EdgeNode& out) {
+    bool found = false;
+    portENTER_CRITICAL(&edgeLock);
+    if (index >= 0 && index < nodeCount) {
+        out = nodes[index];
+        found = true;
+    }
+    portEXIT_CRITICAL(&edgeLock);
+    return found;
+}
+
+EdgeStats edgeStats() {
+    EdgeStats stats;
+    portENTER_CRITICAL(&edgeLock);
+    stats.sensors = sensorCount;
+    stats.nodes = nodeCount;
+    stats.updates = updates;
+    stats.evictions = evictions;
+    portEXIT_CRITICAL(&edgeLock);
+    stats.bytes = sizeof(sensors) + sizeof(nodes);
+    return stats;
+}
+
+float edgeDayTotal(const EdgeSensor& sensor, uint32_t now) {
+    uint32_t nowHour = (now ? now : sensor.ts) / 3600;
+    float total = 0;
+    for (int i = 0; i < EDGE_HOURS; i++) {
+        const EdgeHour& h = sensor.hours[i];
+        if (h.hour && h.hour + EDGE_HOURS > nowHour && h.hour <= nowHour) total += h.last - h.first;
+    }
+    return total;
+}
@@ -0,0 +1,77 @@
+#ifndef EDGE_CACHE_H
+#define EDGE_CACHE_H
+
+#include <Arduino.h>
+
+// Bounded in-RAM table of what this Gateway has heard: the latest reading
+// and 24 hourly buckets per sensor, and link status per node. Everything is
+// statically sized, so the memory cost is fixed at build time and reported
+// by edgeStats(). The main loop writes, the HTTP server task (edgeServer.h)
+// reads copies taken under a short critical section.
+#define EDGE_MAX_SENSORS 16
+#define EDGE_MAX_NODES 8
+#define EDGE_HOURS 24
+#define EDGE_SENSOR_ID_MAX 12
+#define EDGE_NODE_OFFLINE_S (3 * 3600)     // not heard for this long = offline
+
+enum EdgeKind : uint8_t {
+    EDGE_WATER = 0,     // cumulative litres
+    EDGE_ENERGY = 1,    // cumulative kWh
+};
+
+// One hour of a cumulative meter: consumption is last - first
+struct EdgeHour {
+    uint32_t hour;      // epoch / 3600, 0 = empty
+    float first;        // meter value carried in from the previous reading
+    float last;
+    uint16_t samples;
+};
+
+struct EdgeSensor {
+    char id[EDGE_SENSOR_ID_MAX];
+    uint8_t node;
+    uint8_t kind;       // EdgeKind
+    int16_t gwRssi;     // RSSI of the last frame as heard by this Gateway
+    float value;
+    float voltage;      // energy sensors only
+    uint32_t ts;        // epoch of value
+    uint32_t touchedMs; // millis() of the last update, for eviction
+    EdgeHour hours[EDGE_HOURS];
+};
+
+struct EdgeNode {
+    uint8_t address;
+    int16_t rssi;           // what the node heard from us (getRSSI reply)
+    int16_t gwRssi;         // what we heard from the node, last frame
+    uint32_t lastSeen;      // epoch of the last frame
+    uint32_t frames;
+    uint16_t pollTimeouts;  // consecutive unanswered polls
+};
+
+struct EdgeStats {
+    uint16_t sensors;
+    uint16_t nodes;
+    uint32_t updates;
+    uint32_t evictions;     // sensors dropped to make room for a new one
+    uint32_t bytes;         // RAM held by the tables
+};
+
+// Writers, called from the main loop for every forwarded frame
+void edgeRecordReading(int node, const char* sensorId, EdgeKind kind, float value, float voltage,
+                       uint32_t ts, int gwRssi);
+void edgeRecordRssi(int node, int rssi, int gwRssi);
+void edgeRecordPoll(int node, bool answered);
+
+// Readers, safe from any task: copy one entry, false past the last one
+bool edgeSensorAt(int index, EdgeSensor& out);
+bool edgeFindSensor(const char* id, EdgeSensor& out);
+bool edgeNodeAt(int index, EdgeNode& out);
+EdgeStats edgeStats();
+
+// Consumption over the 24 h ending at now (epoch seconds)
+float edgeDayTotal(const EdgeSensor& sensor, uint32_t now);
+
+// Current epoch, 0 until NTP has synced
+uint32_t edgeNow();
+
+#endif
@@ -0,0 +1,169 @@
+#include "edgeServer.h"
+#include "edgeCache.h"
+#include "../Common/log.h"
+
+#if EDGE_HTTP
+#include <ESPAsyncWebServer.h>
+
+#define EDGE_BIN_VERSION 1
+
+struct __attribute__((packed)) EdgeWireHeader {
+    char magic[2];
+    uint8_t version;
+    uint8_t count;
+    uint32_t now;
+};
+
+struct __attribute__((packed)) EdgeWireRecord {
+    char id[EDGE_SENSOR_ID_MAX];
+    uint8_t node;
+    uint8_t kind;
+    int16_t gwRssi;
+    float value;
+    float voltage;
+    uint32_t ts;
+    float day;
+};
+
+static_assert(sizeof(EdgeWireHeader) == 8, "edge binary header layout");
+static_assert(sizeof(EdgeWireRecord) == 32, "edge binary record layout");
+
+static AsyncWebServer server(EDGE_HTTP_PORT);
+
+static AsyncResponseStream* beginJson(AsyncWebServerRequest* request) {
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->addHeader("Cache-Control", "no-store");
+    return response;
+}
+
+static void printSensor(AsyncResponseStream* out, const EdgeSensor& s, uint32_t now) {
+    out->printf("{\"node_id\":\"node_%u\",\"sensor_id\":\"%s\",\"%s\":%.3f,", s.node, s.id,
+                s.kind == EDGE_WATER ? "water" : "power", s.value);
+    if (s.kind == EDGE_ENERGY) out->printf("\"voltage\":%.1f,", s.voltage);
+    out->printf("\"ts\":%lu,\"day\":%.3f,\"gw_rssi\":%d}", (unsigned long)s.ts, edgeDayTotal(s, now),
+                s.gwRssi);
+}
+
+static void handleLatest(AsyncWebServerRequest* request) {
+    const char* filter = nullptr;
+    String wanted;
+    if (request->hasParam("sensor")) {
+        wanted = request->getParam("sensor")->value();
+        filter = wanted.c_str();
+    }
+
+    uint32_t now = edgeNow();
+    AsyncResponseStream* out = beginJson(request);
+    out->print("[");
+    EdgeSensor s;
+    bool first = true;
+    for (int i = 0; edgeSensorAt(i, s); i++) {
+        if (filter && strncmp(s.id, filter, EDGE_SENSOR_ID_MAX) != 0) continue;
+        if (!first) out->print(",");
+        printSensor(out, s, now);
+        first = false;
+    }
+    out->print("]");
+    request->send(out);
+}
+
+static void handleLatestBin(AsyncWebServerRequest* request) {
+    uint32_t now = edgeNow();
+    EdgeStats stats = edgeStats();
+    AsyncResponseStream* out = request->beginResponseStream("application/octet-stream");
+    out->addHeader("Access-Control-Allow-Origin", "*");
+    out->addHeader("Cache-Control", "no-store");
+
+    EdgeWireHeader header = {{'W', 'E'}, EDGE_BIN_VERSION, 0, now};
+    EdgeWireRecord records[EDGE_MAX_SENSORS];
+    EdgeSensor s;
+    for (int i = 0; i < stats.sensors && edgeSensorAt(i, s); i++) {
+        EdgeWireRecord& r = records[header.count++];
+        memcpy(r.id, s.id, sizeof(r.id));
+        r.node = s.node;
+        r.kind = s.kind;
+        r.gwRssi = s.gwRssi;
+        r.value = s.value;
+        r.voltage = s.voltage;
+        r.ts = s.ts;
+        r.day = edgeDayTotal(s, now);
+    }
+    out->write((const uint8_t*)&header, sizeof(header));
+    out->write((const uint8_t*)records, header.count * sizeof(EdgeWireRecord));
+    request->send(out);
+}
+
+static void handleRollup(AsyncWebServerRequest* request) {
+    EdgeSensor s;
+    if (!request->hasParam("sensor")) {
+        request->send(400, "application/json", "\"sensor missing\"");
+        return;
+    }
+    String wanted = request->getParam("sensor")->value();
+    if (!edgeFindSensor(wanted.c_str(), s)) {
+        request->send(404, "application/json", "\"unknown sensor\"");
+        return;
+    }
+
+    // Oldest hour first, only hours inside the last 24 h
+    uint32_t now = edgeNow();
+    uint32_t nowHour = (now ? now : s.ts) / 3600;
+    uint32_t fromHour = nowHour >= EDGE_HOURS ? nowHour + 1 - EDGE_HOURS : 1;   // hour 0 marks an empty bucket
+    AsyncResponseStream* out = beginJson(request);
+    out->printf("{\"sensor_id\":\"%s\",\"day\":%.3f,\"hours\":[", s.id, edgeDayTotal(s, now));
+    bool first = true;
+    for (uint32_t hour = fromHour; hour <= nowHour; hour++) {
+        const EdgeHour& h = s.hours[hour % EDGE_HOURS];
+        if (h.hour != hour) continue;
+        out->printf("%s{\"ts\":%lu,\"used\":%.3f,\"last\":%.3f,\"samples\":%u}", first ? "" : ",",
+                    (unsigned long)hour * 3600, h.last - h.first, h.last, h.samples);
+        first = false;
+    }
+    out->print("]}");
+    request->send(out);
+}
+
+static void handleNodes(AsyncWebServerRequest* request) {
+    uint32_t now = edgeNow();
+    AsyncResponseStream* out = beginJson(request);
+    out->print("[");
+    EdgeNode n;
+    for (int i = 0; edgeNodeAt(i, n); i++) {
+        bool online = n.lastSeen && now && now - n.lastSeen < EDGE_NODE_OFFLINE_S && n.pollTimeouts < 3;
+        out->printf("%s{\"node_id\":\"node_%u\",\"online\":%s,\"rssi\":%d,\"gw_rssi\":%d,\"last_seen\":%lu,"
+                    "\"frames\":%lu,\"poll_timeouts\":%u}",
+                    i ? "," : "", n.address, online ? "true" : "false", n.rssi, n.gwRssi,
+                    (unsigned long)n.lastSeen, (unsigned long)n.frames, n.pollTimeouts);
+    }
+    out->print("]");
+    request->send(out);
+}
+
+static void handleStats(AsyncWebServerRequest* request) {
+    EdgeStats stats = edgeStats();
+    AsyncResponseStream* out = beginJson(request);
+    out->printf("{\"sensors\":%u,\"sensor_cap\":%u,\"nodes\":%u,\"node_cap\":%u,\"bytes\":%lu,"
+                "\"updates\":%lu,\"evictions\":%lu,\"free_heap\":%lu}",
+                stats.sensors, EDGE_MAX_SENSORS, stats.nodes, EDGE_MAX_NODES, (unsigned long)stats.bytes,
+                (unsigned long)stats.updates, (unsigned long)stats.evictions,
+                (unsigned long)ESP.getFreeHeap());
+    request->send(out);
+}
+
+void edgeServerBegin() {
+    server.on("/edge/latest", HTTP_GET, handleLatest);
+    server.on("/edge/latest.bin", HTTP_GET, handleLatestBin);
+    server.on("/edge/rollup", HTTP_GET, handleRollup);
+    server.on("/edge/nodes", HTTP_GET, handleNodes);
+    server.on("/edge/stats", HTTP_GET, handleStats);
+    server.begin();
+    LOGI(TAG_HTTP, "Edge API on port %d, cache holds %lu bytes", EDGE_HTTP_PORT,
+         (unsigned long)edgeStats().bytes);
+}
+
+#else
+
+void edgeServerBegin() {}
+
+#endif
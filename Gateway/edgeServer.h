@@ -0,0 +1,27 @@
+#ifndef EDGE_SERVER_H
+#define EDGE_SERVER_H
+
+// LAN read API over the edge cache (edgeCache.h), served by ESPAsyncWebServer
+// on its own task, so reads keep working while the main loop is busy polling
+// or the backend is unreachable.
+//
+//   GET /edge/latest[?sensor=ID]  latest reading and 24 h total per sensor, JSON
+//   GET /edge/latest.bin          the same as fixed-size binary records
+//   GET /edge/rollup?sensor=ID    24 hourly buckets of one sensor, JSON
+//   GET /edge/nodes               link status per node, JSON
+//   GET /edge/stats               table usage and RAM held, JSON
+//
+// Binary layout, little-endian: an 8-byte header
+//   'W' 'E' version(1) count(u8) now(u32 epoch)
+// followed by count 32-byte records
+//   id(char[12], zero padded) node(u8) kind(u8, 0 water 1 energy) gw_rssi(i16)
+//   value(f32) voltage(f32) ts(u32) day(f32)
+#ifndef EDGE_HTTP
+#define EDGE_HTTP 1
+#endif
+#define EDGE_HTTP_PORT 8080
+
+// Call once WiFi is up
+void edgeServerBegin();
+
+#endif
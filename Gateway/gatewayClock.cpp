@@ -0,0 +1,79 @@
+#include "gatewayClock.h"
+#include <EEPROM.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+#include "../Common/log.h"
+
+#define CLOCK_MAGIC 0x434C4B31  // "CLK1"
+
+struct ClockRecord {
+    uint32_t magic;
+    uint32_t epoch;
+};
+
+static ClockSource source = CLOCK_NONE;
+static volatile bool ntpSynced = false;     // set from the SNTP task
+static time_t lastSave = 0;
+
+static void onNtpSync(struct timeval*) {
+    ntpSynced = true;
+}
+
+static void saveClock(time_t now) {
+    ClockRecord record = {CLOCK_MAGIC, (uint32_t)now};
+    EEPROM.put(0, record);
+    EEPROM.commit();
+    lastSave = now;
+}
+
+void clockBegin(const char* ntpServer, long gmtOffsetSec) {
+    EEPROM.begin(GATEWAY_EEPROM_SIZE);
+
+    // The RTC keeps the system time across everything but a power loss
+    time_t now = time(nullptr);
+    if (now > MIN_VALID_EPOCH) {
+        source = CLOCK_RETAINED;
+    } else {
+        ClockRecord record;
+        EEPROM.get(0, record);
+        if (record.magic == CLOCK_MAGIC && (time_t)record.epoch > MIN_VALID_EPOCH) {
+            struct timeval tv = {(time_t)record.epoch, 0};
+            settimeofday(&tv, NULL);
+            source = CLOCK_CACHED;
+        }
+    }
+    lastSave = time(nullptr);
+    LOGI(TAG_TIME, "Clock at boot: %s (%lu)", clockSourceName(), (unsigned long)lastSave);
+
+    sntp_set_time_sync_notification_cb(onNtpSync);
+    configTime(gmtOffsetSec, 0, ntpServer);
+}
+
+void clockTick() {
+    time_t now = time(nullptr);
+    if (ntpSynced) {
+        ntpSynced = false;
+        if (source != CLOCK_NTP) {
+            LOGI(TAG_TIME, "NTP synchronized, clock was %s", clockSourceName());
+            source = CLOCK_NTP;
+        }
+        saveClock(now);
+        return;
+    }
+    // Keep the cached time moving even without NTP, so repeated power
+    // losses do not replay the same stale time
+    if (source != CLOCK_NONE && now - lastSave >= CLOCK_SAVE_INTERVAL_S) saveClock(now);
+}
+
+ClockSource clockSource() {
+    return source;
+}
+
+const char* clockSourceName() {
+    static const char* const NAMES[] = {"none", "cached", "retained", "ntp"};
+    return NAMES[source];
+}
+
+bool clockTrusted() {
+    return source == CLOCK_RETAINED || source == CLOCK_NTP;
+}
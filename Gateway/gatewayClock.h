@@ -0,0 +1,45 @@
+#ifndef GATEWAY_CLOCK_H
+#define GATEWAY_CLOCK_H
+
+#include <Arduino.h>
+#include <time.h>
+
+// Wall clock of the Gateway. Boot never waits for NTP: the clock starts from
+// whatever survived the reset and SNTP corrects it in the background once
+// WiFi is up (and then every hour, the lwIP default).
+//   CLOCK_RETAINED  system time kept by the RTC across a software or watchdog
+//                   reset, off only by the RTC drift
+//   CLOCK_CACHED    after a power loss: the time last saved to EEPROM, so it
+//                   lags by at least the outage. Good enough to run the poll
+//                   schedule (a window missed during the outage runs as
+//                   catch-up once NTP moves the clock), never sent to nodes.
+//   CLOCK_NTP       synced
+#define CLOCK_SAVE_INTERVAL_S 3600
+#define CLOCK_EEPROM_SIZE 16
+
+// The EEPROM holds the clock record first, then the history positions
+// (history.h); clockBegin() opens all of it
+#define GATEWAY_EEPROM_SIZE 64
+
+const time_t MIN_VALID_EPOCH = 1700000000;   // anything earlier means no clock at all
+
+enum ClockSource : uint8_t {
+    CLOCK_NONE,
+    CLOCK_CACHED,
+    CLOCK_RETAINED,
+    CLOCK_NTP,
+};
+
+// Restore the clock and start SNTP; needs the WiFi netif (internetInit)
+void clockBegin(const char* ntpServer, long gmtOffsetSec);
+
+// Call from loop(): notes an SNTP sync and saves the time to EEPROM
+void clockTick();
+
+ClockSource clockSource();
+const char* clockSourceName();
+
+// Accurate enough to stamp readings and to hand to the nodes
+bool clockTrusted();
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define HIST_MAX_BUCKETS 8
+
+// Fixed-bucket histogram: counts[i] holds samples <= bounds[i],
+// counts[numBounds] holds everything above the last bound. Plain C++ so the
+// host tests (tools/tests) build it as is.
+struct Histogram {
+    const uint32_t* bounds;
+    uint8_t numBounds;
+    uint32_t counts[HIST_MAX_BUCKETS + 1];
+    uint32_t count;
+    uint32_t sum;
+    uint32_t max;
+
+    void init(const uint32_t* b, uint8_t n) {
+        bounds = b;
+        numBounds = n > HIST_MAX_BUCKETS ? HIST_MAX_BUCKETS : n;
+        memset(counts, 0, sizeof(counts));
+        count = 0;
+        sum = 0;
+        max = 0;
+    }
+
+    void observe(uint32_t value) {
+        uint8_t i = 0;
+        while (i < numBounds && value > bounds[i]) i++;
+        counts[i]++;
+        count++;
+        sum += value;
+        if (value > max) max = value;
+    }
+
+    // Upper estimate of the p-th percentile: the bound of the bucket holding
+    // that sample, or max when max is lower or the sample overflowed. 0
+    // while empty.
+    uint32_t percentile(uint8_t p) const {
+        if (!count) return 0;
+        uint32_t rank = ((uint64_t)count * p + 99) / 100;
+        if (!rank) rank = 1;
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < numBounds; i++) {
+            seen += counts[i];
+            if (seen >= rank) return bounds[i] < max ? bounds[i] : max;
+        }
+        return max;
+    }
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "history.h"
+#include <EEPROM.h>
+#include "../Common/log.h"
+
+#define HISTORY_MAGIC 0x48535431  // "HST1"
+
+struct HistoryPositions {
+    uint32_t magic;
+    uint32_t next[HISTORY_MAX_NODES];
+};
+
+static_assert(HISTORY_EEPROM_ADDR + sizeof(HistoryPositions) <= GATEWAY_EEPROM_SIZE,
+              "History positions do not fit the Gateway EEPROM");
+
+static HistoryPositions positions;
+
+void historyBegin() {
+    EEPROM.get(HISTORY_EEPROM_ADDR, positions);
+    if (positions.magic != HISTORY_MAGIC) {
+        memset(&positions, 0, sizeof(positions));
+        positions.magic = HISTORY_MAGIC;
+        LOGI(TAG_HIST, "No saved history positions, full backfill on first sync");
+    }
+}
+
+uint32_t historyNext(int nodeIndex) {
+    return nodeIndex >= 0 && nodeIndex < HISTORY_MAX_NODES ? positions.next[nodeIndex] : 0;
+}
+
+void historySetNext(int nodeIndex, uint32_t next) {
+    if (nodeIndex < 0 || nodeIndex >= HISTORY_MAX_NODES || positions.next[nodeIndex] == next) return;
+    positions.next[nodeIndex] = next;
+    EEPROM.put(HISTORY_EEPROM_ADDR, positions);
+    EEPROM.commit();
+}
@@ -0,0 +1,35 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <Arduino.h>
+#include "gatewayClock.h"
+
+// Backfill from the nodes' flash history (Common/historyLog.h). After every
+// answered poll the Gateway asks a node for the records it has not pushed
+// yet, "everything since seq N", in windows of HISTORY_WINDOW frames that the
+// node sends back to back; a lost frame only costs the rest of its window,
+// which is asked for again. A window is held in RAM until its closing frame
+// and only then uploaded, so no frame arrives while an HTTP POST blocks the
+// radio, and the position moves only past records the uplink took. A failed poll therefore leaves no hole: the next
+// poll that gets through brings the missed intervals along, up to
+// HISTORY_SYNC_WINDOWS windows per poll.
+//
+// N per node survives a reboot in EEPROM, after the clock record.
+#define HISTORY_WINDOW 8
+// Base64 of one frame's records, 5 records of 12 bytes (historyLog.h)
+#define HISTORY_FRAME_CHARS 80
+#define HISTORY_SYNC_WINDOWS 24
+#define HISTORY_REPLY_TIMEOUT_MS 4000
+#define HISTORY_MAX_NODES 8
+#define HISTORY_EEPROM_ADDR CLOCK_EEPROM_SIZE
+
+// Load the positions; after clockBegin(), which opens the EEPROM
+void historyBegin();
+
+// Next seq to fetch from a node, 0 if never synced
+uint32_t historyNext(int nodeIndex);
+
+// Record progress, written to EEPROM only when it changed
+void historySetNext(int nodeIndex, uint32_t next);
+
+#endif
@@ -3,7 +3,22 @@
 #include <ArduinoJson.h>
 #include <WiFiManager.h>
 #include "dataPush.h"
+#include "edgeCache.h"
+#include "edgeServer.h"
+#include "gatewayClock.h"
+#include "history.h"
+#include "metrics.h"
+#include "nodeFrame.h"
+#include "pushedFrames.h"
+#include "scheduler.h"
 #include <time.h>
+#include "../Common/diag.h"
+#include "../Common/frame.h"
+#include "../Common/gateways.h"
+#include "../Common/jsonArena.h"
+#include "../Common/log.h"
+#include "../Common/mesh.h"
+#include "../Common/radio.h"
 
 // Pin definitions
 #define SS_PIN 5
@@ -11,73 +26,158 @@
 #define DIO0_PIN 2
 #define LED1 27
 
-// Node configuration
-const int NODE_ADDRESSES[] = {1, 2};
+// Node configuration: the nodes this gateway polls (GATEWAY_NODES,
+// Common/gateways.h). Every node is polled by one gateway only; the others
+// just forward its frames when they overhear them.
+const int NODE_ADDRESSES[] = {GATEWAY_NODES};
 const int NUM_NODES = sizeof(NODE_ADDRESSES) / sizeof(NODE_ADDRESSES[0]);
 bool nodeInitialized[NUM_NODES] = {false};
-int currentNode = 0;
-int check = 0;
-bool thefirst = true;
 
-// Time configuration
+// Relay of each node: 0 when the Gateway hears it directly, otherwise the
+// address of a relay node (NODE_RELAY, Common/mesh.h) within range of both.
+// Nodes behind one relay are polled together through it, e.g.
+// -DGATEWAY_NODE_VIA=2,0 reaches Node 1 through Node 2. Without it every
+// node is heard directly.
+#ifdef GATEWAY_NODE_VIA
+const int NODE_VIA[NUM_NODES] = {GATEWAY_NODE_VIA};
+#else
+const int NODE_VIA[NUM_NODES] = {0};
+#endif
+
+// Node handshake, without blocking (see handshakeNodes)
+const unsigned long helloSpacing = 500;             // between "Hi" to different nodes
+const unsigned long helloRetryMin = 3000;
+const unsigned long helloRetryMax = 5 * 60 * 1000;
+unsigned long lastHelloSent = 0;
+unsigned long helloSentAt[NUM_NODES] = {0};
+unsigned long helloRetry[NUM_NODES] = {0};          // 0 until the first "Hi"
+bool firstPollDue[NUM_NODES] = {false};
+
+// Time configuration (gatewayClock.h)
 const char* ntpServer = "129.6.15.28";
 const long gmtOffset_sec = 7 * 3600; // GMT+7 for Vietnam
 struct tm timeinfo;
-unsigned long lastNtpUpdate = 0;
-const unsigned long ntpUpdateInterval = 3600000; // 1 hour
 
 // Scheduling configuration
-const int scheduledHour = 14, scheduledMinute = 40;
-bool hasPolledToday = false;
+// Each row is either a daily window (local time) or a fixed interval, for
+// all nodes or a single node index, e.g.
+//     {SCHEDULE_DAILY, ALL_NODES, 2, 0, 0},          // extra window at 02:00
+//     {SCHEDULE_INTERVAL, 1, 0, 0, 6 * 3600},        // Node 2 every 6 hours
+const ScheduleEntry POLL_SCHEDULE[] = {
+    {SCHEDULE_DAILY, ALL_NODES, 14, 40, 0},
+};
+const int NUM_SCHEDULE_ENTRIES = sizeof(POLL_SCHEDULE) / sizeof(POLL_SCHEDULE[0]);
 const int scheduledPollCount = 3;
 
 // RSSI monitoring
 unsigned long lastRssiCheck = 0;
 const unsigned long rssiCheckInterval = 1 * 60 * 1000; // 15 minutes
 
+// Node diagnostics (stack, heap, loop time), forwarded with the metrics
+unsigned long lastDiagCheck = 0;
+const unsigned long diagCheckInterval = 30 * 60 * 1000; // 30 minutes
+
+// Metrics export
+unsigned long lastMetricsReport = 0;
+const unsigned long metricsReportInterval = 5 * 60 * 1000; // 5 minutes
+
+// Static packet buffers and JSON arena: no heap allocation per packet.
+// A received packet may be a relay aggregate.
+char rxBuffer[MESH_AGG_MAX + 1];
+char txBuffer[FRAME_PAYLOAD_MAX + 1];
+JsonArena<> jsonArena;
+
+// Routed frames: duplicate suppression and our message counter
+MeshDupCache meshDups;
+uint8_t meshMsgId = 0;
+
+// Node frames pushed lately, to drop the copies in late relay aggregates
+PushedFrames pushedFrames;
+
+// One subtree poll in progress, see pollSubtree()
+struct SubtreePoll {
+    int relayAddress;
+    int count;
+    int nodeIndex[RELAY_MAX_CHILDREN];
+    int packets[RELAY_MAX_CHILDREN];
+    bool closed[RELAY_MAX_CHILDREN];
+    bool answered[RELAY_MAX_CHILDREN];
+    unsigned long start;
+};
+
 // Function prototypes
 void initLoRa();
-void initNTP();
-void updateNTP();
-void initializeNodes();
-bool sendToNode(int nodeAddress, const String& message);
+void handshakeNodes();
+bool handleHelloReply(int nodeAddress, MsgView frame);
+bool sendToNode(int nodeAddress, const char* message, size_t len);
+bool sendToNode(int nodeAddress, const char* message);
 void pollNode(int nodeIndex);
-void receiveAllDataFromNode(int nodeAddress);
-void processNodeData(int nodeAddress, const String& data);
-bool isScheduledTime();
+void pollAllNodes();
+void pollSubtree(int relayAddress, const int* nodeIndexes, int count);
+void processAggregate(SubtreePoll& poll, MsgView frame, bool late);
+int relayOf(int nodeAddress);
+void readFrameAddress(byte& sender, byte& receiver);
+int receiveAllDataFromNode(int nodeAddress);
+void processNodeData(int nodeAddress, MsgView data, bool late = false);
+void syncHistory(int nodeIndex);
+bool requestHistory(int nodeAddress, uint32_t since, uint32_t window, int& frames, NodeHistory& end);
+bool pushHistory(int nodeAddress, int frames, uint32_t& next);
+void runScheduledEntry(const ScheduleEntry& entry, time_t due, time_t now);
 void performScheduledPolling();
 void checkAndRequestRSSI();
 void requestRSSI(int nodeAddress);
 void receiveRSSI(int nodeAddress);
-void processRSSIData(int nodeAddress, const String& data);
+void processRSSIData(int nodeAddress, MsgView data);
+bool awaitNodeReply(int nodeAddress, MsgView& reply, unsigned long timeoutMs);
+void checkAndRequestDiag();
+void processDiagData(int nodeAddress, MsgView data);
+void checkUnsolicited();
+bool handleAlertFrame(int nodeAddress, MsgView frame, bool ack = true);
+bool forwardOverheard(int sender, int receiver);
+PayloadLink frameLink(long seq);
 
 void setup() {
     Serial.begin(115200);
-    internetInit();
-    Serial.println("Connected...yeey :)");
+    logInit();
+    diagWatchTask(NULL, "loop");
+    diagWatchTask(logTaskHandle(), "log");
+    metricsInit();
 
+    // Nothing here waits for the network: WiFi, NTP and the node handshakes
+    // all complete in the background from loop()
     initLoRa();
-    initNTP();
-    initializeNodes();
+    internetInit();
+    clockBegin(ntpServer, gmtOffset_sec);
+    historyBegin();
+    edgeServerBegin();
+    schedulerInit(POLL_SCHEDULE, NUM_SCHEDULE_ENTRIES);
     
     Serial.println("Gateway setup completed!");
-    Serial.printf("Scheduled polling: %02d:%02d, RSSI check: %d min\n", 
-                  scheduledHour, scheduledMinute, rssiCheckInterval / 60000);
+    Serial.printf("Scheduled polling: %d entries, RSSI check: %d min\n", 
+                  NUM_SCHEDULE_ENTRIES, rssiCheckInterval / 60000);
 }
 
 void loop() {
-    // Periodic NTP update
-    // if (millis() - lastNtpUpdate > ntpUpdateInterval) {
-    //     updateNTP();
-    //     lastNtpUpdate = millis();
-    // }
-    if(!getLocalTime(&timeinfo)){
-        Serial.printf("Check . . ..");
-        while(1);
-    }
-    // Scheduled polling check at 23h00
-    if (isScheduledTime()) {
-        performScheduledPolling();
+    diagLoopTick();
+
+    // WiFi (re)connection and clock persistence, both non-blocking
+    internetTick();
+    clockTick();
+
+    // Uplink housekeeping (MQTT acks, retries, keepalive)
+    uplink().loop();
+
+    // "Hi" to nodes not initialized yet, first poll of those that answered
+    handshakeNodes();
+
+    // Leak alerts are pushed by nodes at any time, not only when polled
+    checkUnsolicited();
+
+    // Scheduled polling (windows and per-node intervals, with catch-up),
+    // from a cached clock too until NTP syncs
+    time_t now = time(nullptr);
+    if (now > MIN_VALID_EPOCH) {
+        schedulerTick(now, runScheduledEntry);
     }
     
     // RSSI monitoring
@@ -85,18 +185,18 @@ void loop() {
         checkAndRequestRSSI();
         lastRssiCheck = millis();
     }
-    
-    // Regular polling with rotation for test.
-    // The first check
-    while(thefirst){
-    pollNode(currentNode);
-    currentNode = (currentNode + 1) % NUM_NODES;
-    check++;
-    if(check == 2) {
-    thefirst = false;
-    Serial.println("The first check is done !!!");
-    break;}
-    } 
+
+    // Node diagnostics
+    if (millis() - lastDiagCheck >= diagCheckInterval) {
+        checkAndRequestDiag();
+        lastDiagCheck = millis();
+    }
+
+    // Metrics snapshot
+    if (millis() - lastMetricsReport >= metricsReportInterval) {
+        metricsReport(NUM_NODES);
+        lastMetricsReport = millis();
+    }
 }
 
 void initLoRa() {
@@ -106,69 +206,36 @@ void initLoRa() {
         return;
     }
     LoRa.setSyncWord(0xF3);
+    radioInit();
     Serial.println("LoRa initialized successfully!");
 }
 
-void initNTP() {
-    Serial.println("Initializing NTP...");
-    configTime(gmtOffset_sec, 0, ntpServer);
-    
-    for (int attempts = 0; attempts < 10; attempts++) {
-        if (getLocalTime(&timeinfo)) {
-            Serial.printf("NTP synchronized: %04d-%02d-%02d %02d:%02d:%02d\n",
-                         timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                         timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-            return;
-        }
-        Serial.println("Retrying NTP sync...");
-        delay(1000);
-    }
-    Serial.println("NTP sync failed!");
-}
-
-void updateNTP() {
-    configTime(gmtOffset_sec, 0, ntpServer);
-    if (getLocalTime(&timeinfo)) {
-        Serial.printf("NTP updated: %02d:%02d:%02d\n", 
-                     timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-    }
-}
-
-bool isScheduledTime() {
-    if (!getLocalTime(&timeinfo)) return false;
-    
-    // Reset daily flag at midnight
-    if (timeinfo.tm_hour == 0 && timeinfo.tm_min == 0) {
-        hasPolledToday = false;
+void runScheduledEntry(const ScheduleEntry& entry, time_t due, time_t now) {
+    if (entry.nodeIndex == ALL_NODES) {
+        performScheduledPolling();
+    } else if (entry.nodeIndex >= 0 && entry.nodeIndex < NUM_NODES) {
+        pollNode(entry.nodeIndex);
     }
-    
-    return (timeinfo.tm_hour == scheduledHour && 
-            timeinfo.tm_min == scheduledMinute && 
-            !hasPolledToday);
 }
 
 void performScheduledPolling() {
+    getLocalTime(&timeinfo);
     Serial.printf("\n=== SCHEDULED POLLING (%02d:%02d) ===\n", 
                   timeinfo.tm_hour, timeinfo.tm_min);
     
     for (int cycle = 1; cycle <= scheduledPollCount; cycle++) {
         Serial.printf("Cycle %d/%d\n", cycle, scheduledPollCount);
-
-        for(int i = 0; i < 2; i++){
-        pollNode(currentNode);
-        currentNode = (currentNode + 1) % NUM_NODES;
-        }
+        pollAllNodes();
         
         if (cycle < scheduledPollCount) delay(3000);
     }
     
-    hasPolledToday = true;
     Serial.println("=== SCHEDULED POLLING COMPLETED ===\n");
 }
 
 void checkAndRequestRSSI() {
     Serial.println("\n=== RSSI CHECK ===");
-    if (getLocalTime(&timeinfo)) {
+    if (getLocalTime(&timeinfo, 0)) {
         Serial.printf("Time: %02d:%02d:%02d\n", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
     }
     
@@ -188,171 +255,642 @@ void requestRSSI(int nodeAddress) {
 }
 
 void receiveRSSI(int nodeAddress) {
+    MsgView response;
+    if (awaitNodeReply(nodeAddress, response, 5000)) {
+        processRSSIData(nodeAddress, response);
+        return;
+    }
+    metrics.rssiTimeouts++;
+    LOGW(TAG_POLL, "RSSI timeout for Node %d", nodeAddress);
+}
+
+// Wait for the next frame from nodeAddress, still serving alerts and
+// forwarding frames overheard for other gateways meanwhile
+bool awaitNodeReply(int nodeAddress, MsgView& reply, unsigned long timeoutMs) {
     unsigned long startTime = millis();
     
-    while (millis() - startTime < 5000) {
+    while (millis() - startTime < timeoutMs) {
         int packetSize = LoRa.parsePacket();
         if (packetSize > 0) {
-            byte sender = LoRa.read();
-            byte receiver = LoRa.read();
-
-            if (sender == nodeAddress && receiver == 10) {
-                String response = "";
-                while (LoRa.available()) {
-                    response += (char)LoRa.read();
+            metricsAddAirtime(false, packetSize);
+            byte sender, receiver;
+            readFrameAddress(sender, receiver);
+
+            if (receiver == GATEWAY_ID) {
+                MsgView response = readLoRaPayload(rxBuffer, sizeof(rxBuffer));
+                if (handleAlertFrame(sender, response) || handleHelloReply(sender, response)) continue;
+                if (sender == nodeAddress) {
+                    reply = response;
+                    return true;
                 }
-                processRSSIData(nodeAddress, response);
-                return;
+            } else if (!forwardOverheard(sender, receiver)) {
+                // Skip wrong packets
+                discardLoRaPayload();
             }
-            // Skip wrong packets
-            while (LoRa.available()) LoRa.read();
         }
     }
-    Serial.printf("RSSI timeout for Node %d\n", nodeAddress);
+    return false;
 }
 
-void processRSSIData(int nodeAddress, const String& data) {
-    Serial.printf("Raw RSSI data from Node %d: %s\n", nodeAddress, data.c_str());
+void processRSSIData(int nodeAddress, MsgView data) {
+    LOGD(TAG_POLL, "Raw RSSI data from Node %d: %s", nodeAddress, data.data);
 
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, data);
+    JsonDocument doc(&jsonArena);
+    NodeRssi reply;
+    DeserializationError error = parseNodeRssi(doc, data, reply);
 
     if (error) {
-        Serial.printf("RSSI JSON parse error for Node %d: %s\n", nodeAddress, error.c_str());
+        LOGE(TAG_POLL, "RSSI JSON parse error for Node %d: %s", nodeAddress, error.c_str());
         return;
     }
+    int rssi = reply.rssi;
 
-    // An toàn để truy cập doc sau khi kiểm tra thành công
-    int rssi = doc["rssi"] | 0;
-    String status = doc["status"] | "unknown";
-
-    Serial.printf("Node %d - Status: %s, RSSI: %d dBm\n", nodeAddress, status.c_str(), rssi);
+    LOGI(TAG_POLL, "Node %d - Status: %s, RSSI: %d dBm", nodeAddress, reply.status, rssi);
 
     // Push RSSI lên server
-    PushRssi("node_" + String(nodeAddress),rssi);
+    char nodeId[12];
+    snprintf(nodeId, sizeof(nodeId), "node_%d", nodeAddress);
+    PayloadLink link = frameLink(-1);
+    PushRssi(nodeId, rssi, link);
+    edgeRecordRssi(nodeAddress, rssi, link.rssi);
 }
 
-void initializeNodes() {
-    Serial.println("Initializing nodes...");
-    
+void checkAndRequestDiag() {
     for (int i = 0; i < NUM_NODES; i++) {
-        Serial.printf("Node %d: ", i + 1);
-        
-        for (int retry = 0; retry < 3 && !nodeInitialized[i]; retry++) {
-            if (sendToNode(NODE_ADDRESSES[i], "Hi")) {
-                unsigned long startTime = millis();
-                
-                while (millis() - startTime < 3000) {
-                    int packetSize = LoRa.parsePacket();
-                    if (packetSize > 0) {
-                        byte sender = LoRa.read();
-                        byte receiver = LoRa.read();
-
-                        if (sender == NODE_ADDRESSES[i] && receiver == 10) {
-                            String response = "";
-                            while (LoRa.available()) {
-                                response += (char)LoRa.read();
-                            }
-                            
-                            if (response == "Done" ) {
-                                nodeInitialized[i] = true;
-                                Serial.println("OK");
-                            }
-                        } else {
-                            while (LoRa.available()) LoRa.read();
-                        }
-                    }
-                }
-            }
-            if (!nodeInitialized[i]) delay(500);
+        if (!nodeInitialized[i]) continue;
+        int nodeAddress = NODE_ADDRESSES[i];
+        MsgView response;
+        if (sendToNode(nodeAddress, "getDiag") && awaitNodeReply(nodeAddress, response, 5000)) {
+            processDiagData(nodeAddress, response);
+        } else {
+            LOGW(TAG_POLL, "Diag timeout for Node %d", nodeAddress);
         }
-        
-        if (!nodeInitialized[i]) {
-            Serial.println("FAILED");
+        delay(2000);
+    }
+}
+
+void processDiagData(int nodeAddress, MsgView data) {
+    LOGI(TAG_POLL, "Diag from Node %d: %s", nodeAddress, data.data);
+
+    JsonDocument doc(&jsonArena);
+    DeserializationError error = deserializeJson(doc, data.data, data.len);
+    if (error) {
+        LOGE(TAG_POLL, "Diag JSON parse error for Node %d: %s", nodeAddress, error.c_str());
+        return;
+    }
+    if (!doc["diag"].is<JsonObjectConst>()) {
+        LOGE(TAG_POLL, "Diag reply of Node %d has no diag object", nodeAddress);
+        return;
+    }
+
+    // Re-encode only the diag object; the node id goes in the wrapper
+    char diagJson[FRAME_PAYLOAD_MAX + 1];
+    size_t len = serializeJson(doc["diag"], diagJson, sizeof(diagJson));
+    char nodeId[12];
+    snprintf(nodeId, sizeof(nodeId), "node_%d", nodeAddress);
+    PushNodeDiag(nodeId, diagJson, len);
+}
+
+// Handshakes run in the background: each pass sends at most one "Hi", to a
+// node not initialized yet, spaced so that replies do not collide with the
+// next "Hi". "Done" is picked up by whichever receive path is listening
+// (handleHelloReply). A silent node is asked again with doubling backoff, so
+// one powered up later still joins. A node that answered is polled at once.
+void handshakeNodes() {
+    for (int i = 0; i < NUM_NODES; i++) {
+        if (firstPollDue[i]) {
+            firstPollDue[i] = false;
+            pollNode(i);
+            return;
         }
     }
+
+    unsigned long now = millis();
+    if (lastHelloSent && now - lastHelloSent < helloSpacing) return;
+    for (int i = 0; i < NUM_NODES; i++) {
+        if (nodeInitialized[i]) continue;
+        if (helloRetry[i] && now - helloSentAt[i] < helloRetry[i]) continue;
+
+        sendToNode(NODE_ADDRESSES[i], "Hi");
+        lastHelloSent = now;
+        helloSentAt[i] = now;
+        helloRetry[i] = !helloRetry[i] ? helloRetryMin
+                      : helloRetry[i] * 2 < helloRetryMax ? helloRetry[i] * 2 : helloRetryMax;
+        LOGD(TAG_POLL, "Hi to Node %d, next try in %lu ms", NODE_ADDRESSES[i], helloRetry[i]);
+        return;
+    }
 }
 
-bool sendToNode(int nodeAddress, const String& message) {
+// "Done" answering our "Hi". Returns false for other frames.
+bool handleHelloReply(int nodeAddress, MsgView frame) {
+    if (!frame.equals("Done")) return false;
+    for (int i = 0; i < NUM_NODES; i++) {
+        if (NODE_ADDRESSES[i] != nodeAddress || nodeInitialized[i]) continue;
+        nodeInitialized[i] = true;
+        firstPollDue[i] = true;
+        LOGI(TAG_POLL, "Node %d initialized after %lu ms", nodeAddress, millis());
+    }
+    return true;
+}
+
+bool sendToNode(int nodeAddress, const char* message) {
+    return sendToNode(nodeAddress, message, strlen(message));
+}
+
+bool sendToNode(int nodeAddress, const char* message, size_t len) {
+    int via = relayOf(nodeAddress);
+#if RADIO_TX_POLICY == TX_POLICY_LBT_CAD
+    radioWaitClear();
+#endif
     LoRa.beginPacket();
-    LoRa.write(nodeAddress);
-    LoRa.write(10);  // Gateway address
-    LoRa.print(message);
-    return LoRa.endPacket();
+    if (via) {
+        // Routed frame, the relay forwards it
+        uint8_t header[MESH_HEADER_LEN];
+        meshEncode(meshOriginate(GATEWAY_ID, nodeAddress, via, ++meshMsgId), header);
+        LoRa.write(header, MESH_HEADER_LEN);
+    } else {
+        LoRa.write(nodeAddress);
+        LoRa.write(GATEWAY_ID);
+    }
+    LoRa.write((const uint8_t*)message, len);
+    bool sent = LoRa.endPacket();
+    if (sent) metricsAddAirtime(true, len + (via ? MESH_HEADER_LEN : 2));
+    return sent;
+}
+
+// Relay configured for a node (NODE_VIA), 0 when it is heard directly
+int relayOf(int nodeAddress) {
+    for (int i = 0; i < NUM_NODES; i++) {
+        if (NODE_ADDRESSES[i] == nodeAddress) return NODE_VIA[i];
+    }
+    return 0;
+}
+
+// Sender and receiver of the packet being read. A routed frame for us
+// (Common/mesh.h) reads as sent by its origin; any other routed frame, or
+// a copy already seen, reads as addressed to nobody (receiver 0).
+void readFrameAddress(byte& sender, byte& receiver) {
+    sender = LoRa.read();
+    receiver = LoRa.read();
+    if (sender != MESH_MARK) return;
+
+    uint8_t raw[MESH_HEADER_LEN] = {MESH_MARK, receiver};
+    for (int i = 2; i < MESH_HEADER_LEN; i++) raw[i] = LoRa.read();
+    MeshHeader header = meshDecode(raw);
+    sender = header.origin;
+    receiver = 0;
+    if (header.linkDst != GATEWAY_ID || header.dest != GATEWAY_ID) return;
+    if (meshDups.seen(header.origin, header.msgId, millis())) {
+        LOGD(TAG_POLL, "Duplicate routed frame from Node %d dropped", header.origin);
+        return;
+    }
+    receiver = GATEWAY_ID;
+    if (header.hops) metrics.relayed++;
 }
 
 void pollNode(int nodeIndex) {
     if (!nodeInitialized[nodeIndex]) return;
+    if (NODE_VIA[nodeIndex]) {
+        pollSubtree(NODE_VIA[nodeIndex], &nodeIndex, 1);
+        return;
+    }
     
-    Serial.printf("\n=== Polling Node %d ===\n", nodeIndex + 1);
-    
-    // Create and send getData command
-    JsonDocument doc;
-    doc["command"] = "getData" + String(nodeIndex + 1);
-    doc["nodeId"] = nodeIndex + 1;
+    int nodeAddress = NODE_ADDRESSES[nodeIndex];
+    LOGI(TAG_POLL, "=== Polling Node %d ===", nodeAddress);
+    metrics.polls++;
+    unsigned long pollStart = millis();
     
-    String jsonString;
-    serializeJson(doc, jsonString);
+    // Create and send getData command, carrying the NTP time (UTC epoch)
+    // so the node can stamp its samples. Omitted while the clock is only
+    // the cached one (gatewayClock.h), which lags after a power loss.
+    time_t now = time(nullptr);
+    int len = clockTrusted()
+        ? snprintf(txBuffer, sizeof(txBuffer), "{\"command\":\"getData%d\",\"nodeId\":%d,\"time\":%lu}",
+                   nodeAddress, nodeAddress, (unsigned long)now)
+        : snprintf(txBuffer, sizeof(txBuffer), "{\"command\":\"getData%d\",\"nodeId\":%d}",
+                   nodeAddress, nodeAddress);
     
-    if (sendToNode(NODE_ADDRESSES[nodeIndex], jsonString)) {
-        receiveAllDataFromNode(NODE_ADDRESSES[nodeIndex]);
+    if (sendToNode(nodeAddress, txBuffer, len)) {
+        int packets = receiveAllDataFromNode(nodeAddress);
+        edgeRecordPoll(nodeAddress, packets >= 0);
+        if (packets < 0) {
+            metrics.pollTimeouts++;
+        } else {
+            metrics.packetsPerPoll.observe(packets);
+            if (nodeIndex < METRICS_MAX_NODES) {
+                metrics.pollRtt[nodeIndex].observe(millis() - pollStart);
+            }
+            syncHistory(nodeIndex);
+        }
     } else {
-        Serial.printf("Failed to send command to Node %d\n", nodeIndex + 1);
+        LOGE(TAG_POLL, "Failed to send command to Node %d", nodeAddress);
     }
 }
 
-void receiveAllDataFromNode(int nodeAddress) {
+// Every initialized node once: direct nodes one by one, the nodes behind
+// each relay together in one subtree poll
+void pollAllNodes() {
+    for (int i = 0; i < NUM_NODES; i++) {
+        if (!NODE_VIA[i]) {
+            pollNode(i);
+            continue;
+        }
+
+        // Gather the relay's subtree at its first node
+        bool first = true;
+        for (int j = 0; j < i; j++) first &= NODE_VIA[j] != NODE_VIA[i];
+        if (!first) continue;
+        int subtree[RELAY_MAX_CHILDREN];
+        int count = 0;
+        for (int j = i; j < NUM_NODES && count < RELAY_MAX_CHILDREN; j++) {
+            if (NODE_VIA[j] == NODE_VIA[i] && nodeInitialized[j]) subtree[count++] = j;
+        }
+        if (count) pollSubtree(NODE_VIA[i], subtree, count);
+    }
+}
+
+// Poll the nodes behind a relay in one exchange: the relay polls each of
+// them itself and returns their frames packed into aggregates, each acked
+// once with "ag<R>", then sends "end". This replaces a getData/ok round trip
+// over two hops per frame. Aggregates of an earlier poll that were never
+// acked come first, marked "agl<R>" (Common/mesh.h).
+void pollSubtree(int relayAddress, const int* nodeIndexes, int count) {
+    SubtreePoll poll = {};
+    poll.relayAddress = relayAddress;
+    poll.count = count < RELAY_MAX_CHILDREN ? count : RELAY_MAX_CHILDREN;
+    poll.start = millis();
+    LOGI(TAG_POLL, "=== Polling %d nodes through relay %d ===", poll.count, relayAddress);
+
+    int len = snprintf(txBuffer, sizeof(txBuffer), "{\"command\":\"pollSub\",\"nodes\":[");
+    for (int i = 0; i < poll.count; i++) {
+        poll.nodeIndex[i] = nodeIndexes[i];
+        metrics.polls++;
+        len += snprintf(txBuffer + len, sizeof(txBuffer) - len, i ? ",%d" : "%d", NODE_ADDRESSES[nodeIndexes[i]]);
+    }
+    // Time only from a trusted clock, as in pollNode()
+    len += clockTrusted()
+        ? snprintf(txBuffer + len, sizeof(txBuffer) - len, "],\"time\":%lu}", (unsigned long)time(nullptr))
+        : snprintf(txBuffer + len, sizeof(txBuffer) - len, "]}");
+
+    if (!sendToNode(relayAddress, txBuffer, len)) {
+        LOGE(TAG_POLL, "Failed to send command to relay %d", relayAddress);
+        return;
+    }
+
+    // The relay holds its first aggregate until it is full or every child
+    // answered, waiting up to RELAY_CHILD_TIMEOUT_MS per silent child
+    unsigned long timeout = 10000 + (unsigned long)poll.count * RELAY_CHILD_TIMEOUT_MS;
+    MsgView frame;
+    bool ended = false;
+    while (!ended && awaitNodeReply(relayAddress, frame, timeout)) {
+        char head[8];
+        int headLen = snprintf(head, sizeof(head), "agg%d", relayAddress);
+        bool late = frame.len > 2 && frame.data[2] == 'l';
+        if (late) head[2] = 'l';
+        if (frame.equals("end")) {
+            ended = true;
+        } else if (frame.len > (size_t)headLen && !memcmp(frame.data, head, headLen) && frame.data[headLen] == '\n') {
+            processAggregate(poll, frame, late);
+            char ack[8];
+            sendToNode(relayAddress, ack, snprintf(ack, sizeof(ack), "ag%d", relayAddress));
+        } else {
+            LOGW(TAG_POLL, "Unexpected frame from relay %d: %s", relayAddress, frame.data);
+        }
+    }
+    if (!ended) LOGW(TAG_POLL, "Subtree poll through relay %d timed out", relayAddress);
+
+    // Nodes the relay never closed count as timed out
+    for (int i = 0; i < poll.count; i++) {
+        if (poll.closed[i]) continue;
+        edgeRecordPoll(NODE_ADDRESSES[poll.nodeIndex[i]], false);
+        metrics.pollTimeouts++;
+    }
+
+    // History comes straight from each node, its frames forwarded by the relay
+    for (int i = 0; i < poll.count; i++) {
+        if (poll.answered[i]) syncHistory(poll.nodeIndex[i]);
+    }
+}
+
+// Lines of a relay aggregate: node frames ({...}), "end<N>" once node N is
+// done and "to<N>" when it did not answer. An aggregate resent within the
+// poll (ack lost) is pushed again and the backend drops the copies by seq.
+// A late aggregate, kept by the relay since an earlier poll, only
+// contributes its node frames, minus those pushed already (pushedFrames.h):
+// it may come long after the backend forgot the first copy.
+void processAggregate(SubtreePoll& poll, MsgView frame, bool late) {
+    // The frame lives in rxBuffer: split it in place
+    char* line = rxBuffer + (frame.data - rxBuffer);
+    char* end = line + frame.len;
+    line = (char*)memchr(line, '\n', end - line);
+    while (line && ++line < end) {
+        char* next = (char*)memchr(line, '\n', end - line);
+        if (next) *next = '\0';
+        MsgView view = {line, (size_t)((next ? next : end) - line)};
+
+        int nodeAddress = view.data[0] == '{' ? frameNodeId(view)
+                        : !strncmp(line, "end", 3) ? atoi(line + 3) : !strncmp(line, "to", 2) ? atoi(line + 2) : 0;
+        if (late) {
+            if (view.data[0] == '{') {
+                processNodeData(nodeAddress, view, true);
+                metrics.packetsRx++;
+                metrics.relayed++;
+            }
+            line = next;
+            continue;
+        }
+        int k = 0;
+        while (k < poll.count && NODE_ADDRESSES[poll.nodeIndex[k]] != nodeAddress) k++;
+        if (k == poll.count) {
+            LOGW(TAG_POLL, "Relay %d sent a line for unknown node: %s", poll.relayAddress, line);
+        } else if (view.data[0] == '{') {
+            processNodeData(nodeAddress, view);
+            poll.packets[k]++;
+            metrics.packetsRx++;
+            metrics.relayed++;
+        } else if (!poll.closed[k]) {
+            bool answered = line[0] == 'e';
+            poll.closed[k] = true;
+            poll.answered[k] = answered;
+            edgeRecordPoll(nodeAddress, answered);
+            if (answered) {
+                metrics.packetsPerPoll.observe(poll.packets[k]);
+                if (poll.nodeIndex[k] < METRICS_MAX_NODES) {
+                    metrics.pollRtt[poll.nodeIndex[k]].observe(millis() - poll.start);
+                }
+                LOGI(TAG_POLL, "Received %d data packets from Node %d via relay %d", poll.packets[k],
+                     nodeAddress, poll.relayAddress);
+            } else {
+                metrics.pollTimeouts++;
+                LOGW(TAG_POLL, "Node %d did not answer relay %d", nodeAddress, poll.relayAddress);
+            }
+        }
+        line = next;
+    }
+}
+
+// Returns the number of data packets received, or -1 if the node never sent "end"
+int receiveAllDataFromNode(int nodeAddress) {
     unsigned long startTime = millis();
     int dataPacketCount = 0;
 
     while (millis() - startTime < 10000) {
         int packetSize = LoRa.parsePacket();
         if (packetSize > 0) {
-            byte sender = LoRa.read();
-            byte receiver = LoRa.read();
-
-            if (sender == nodeAddress && receiver == 10) {
-                String response = "";
-                while (LoRa.available()) {
-                    response += (char)LoRa.read();
-                }
-
-                if (response == "end") {
-                    Serial.printf("Received %d data packets from Node %d\n", dataPacketCount, nodeAddress);
-                    break;
+            metricsAddAirtime(false, packetSize);
+            byte sender, receiver;
+            readFrameAddress(sender, receiver);
+
+            if (receiver == GATEWAY_ID && sender != nodeAddress) {
+                MsgView frame = readLoRaPayload(rxBuffer, sizeof(rxBuffer));
+                if (!handleAlertFrame(sender, frame)) handleHelloReply(sender, frame);
+            } else if (sender == nodeAddress && receiver == GATEWAY_ID) {
+                MsgView response = readLoRaPayload(rxBuffer, sizeof(rxBuffer));
+                if (handleAlertFrame(sender, response) || handleHelloReply(sender, response)) continue;
+
+                // "nc": no channel moved beyond its deadband (report-by-exception)
+                if (response.equals("end") || response.equals("nc")) {
+                    LOGI(TAG_POLL, "Received %d data packets from Node %d", dataPacketCount, nodeAddress);
+                    return dataPacketCount;
                 } else {
                     processNodeData(nodeAddress, response);
                     dataPacketCount++;
-                    sendToNode(nodeAddress, "ok" + String(nodeAddress));
+                    metrics.packetsRx++;
+                    char ack[8];
+                    int ackLen = snprintf(ack, sizeof(ack), "ok%d", nodeAddress);
+                    sendToNode(nodeAddress, ack, ackLen);
                     startTime = millis(); // Reset timeout
                 }
-            } else {
-                while (LoRa.available()) LoRa.read();
+            } else if (!forwardOverheard(sender, receiver)) {
+                discardLoRaPayload();
             }
         }
     }
+    LOGW(TAG_POLL, "Poll timeout for Node %d after %d packets", nodeAddress, dataPacketCount);
+    return -1;
 }
 
-void processNodeData(int nodeAddress, const String& data) {
-    JsonDocument doc;
-    if (deserializeJson(doc, data) != DeserializationError::Ok) {
-        Serial.printf("JSON parse error for Node %d\n", nodeAddress);
+void processNodeData(int nodeAddress, MsgView data, bool late) {
+    JsonDocument doc(&jsonArena);
+    NodeReading reading;
+    if (parseNodeReading(doc, data, reading)) {
+        LOGE(TAG_POLL, "JSON parse error for Node %d", nodeAddress);
         return;
     }
 
-    String sensorId = doc["sensorId"];
-    String nodeId = "node_" + String(nodeAddress);
+    // Every frame is recorded, only a late aggregate's copy is dropped
+    if (pushedFrames.repeat(nodeAddress, reading.seq, reading.ts) && late) {
+        LOGI(TAG_POLL, "Late copy of Node %d frame %ld dropped, pushed already", nodeAddress, reading.seq);
+        return;
+    }
+
+    const char* sensorId = reading.sensorId;
+    uint32_t ts = reading.ts;
+    PayloadLink link = frameLink(reading.seq);
+    char nodeId[12];
+    snprintf(nodeId, sizeof(nodeId), "node_%d", nodeAddress);
+
+    if (!metrics.firstReadingMs) {
+        metrics.firstReadingMs = millis();
+        LOGI(TAG_POLL, "First reading %lu ms after boot", (unsigned long)metrics.firstReadingMs);
+    }
+
+    // Batch of power-quality intervals sent after the readings of a poll
+    if (reading.pq) {
+        PushPowerQuality(nodeId, reading.pq, reading.pqRecords, reading.pqStart, reading.pqInterval, link);
+        LOGD(TAG_POLL, "Power-quality batch pushed: Node %d, Sensor %s", nodeAddress, reading.pq);
+        return;
+    }
     
-    if (nodeAddress == 1) {
-        float water = doc["Water"] | 0.0f;
-        PusherW(nodeId, sensorId, water);
-        Serial.printf("Water data pushed: Node %d, Sensor %s, Value %.2fl\n\n", 
-                     nodeAddress, sensorId.c_str(), water);
-    } else if (nodeAddress == 2) {
-        float power = doc["Power"] | 0.0f;
-        float voltage = doc["Voltage"] | 0.0f;
-        PusherE(nodeId, sensorId, power, voltage);
-        Serial.printf("Energy data pushed: Node %d, Sensor %s, P=%.2f, V=%.2f\n\n", 
-                     nodeAddress, sensorId.c_str(), power, voltage);
-    }
-}
\ No newline at end of file
+    if (!reading.energy) {
+        float water = reading.value;
+        PusherW(nodeId, sensorId, water, ts, link);
+        edgeRecordReading(nodeAddress, sensorId, EDGE_WATER, water, 0, ts, link.rssi);
+        LOGD(TAG_POLL, "Water data pushed: Node %d, Sensor %s, Value %.2fl", 
+                     nodeAddress, sensorId, water);
+    } else {
+        float power = reading.value;
+        float voltage = reading.voltage;
+        PusherE(nodeId, sensorId, power, voltage, ts, link);
+        edgeRecordReading(nodeAddress, sensorId, EDGE_ENERGY, power, voltage, ts, link.rssi);
+        LOGD(TAG_POLL, "Energy data pushed: Node %d, Sensor %s, P=%.2f, V=%.2f", 
+                     nodeAddress, sensorId, power, voltage);
+    }
+}
+
+// Fetch the records of a node's flash history not pushed yet (history.h),
+// starting from where the last sync stopped. A node whose log restarted
+// (flash erased) is read again from its oldest record.
+void syncHistory(int nodeIndex) {
+    int nodeAddress = NODE_ADDRESSES[nodeIndex];
+    uint32_t next = historyNext(nodeIndex);
+    NodeHistory end;
+
+    // Window of no frames: only the seq range the node holds
+    int frames = 0;
+    if (!requestHistory(nodeAddress, 0, 0, frames, end)) return;
+    if (!next || next > end.newest + 1) {
+        if (next) LOGW(TAG_HIST, "Node %d history restarted, was at %lu", nodeAddress, (unsigned long)next);
+        next = end.oldest;
+    } else if (next < end.oldest) {
+        LOGW(TAG_HIST, "Node %d overwrote %lu history records before they were fetched", nodeAddress,
+             (unsigned long)(end.oldest - next));
+        next = end.oldest;
+    }
+
+    uint32_t start = next;
+    int stalls = 0;
+    for (int w = 0; w < HISTORY_SYNC_WINDOWS && next <= end.newest && stalls < 2; w++) {
+        requestHistory(nodeAddress, next, HISTORY_WINDOW, frames, end);
+        stalls = frames ? 0 : stalls + 1;
+        if (!pushHistory(nodeAddress, frames, next)) break;
+    }
+    historySetNext(nodeIndex, next);
+    if (next != start) {
+        LOGI(TAG_HIST, "Node %d history %lu..%lu fetched, node holds up to %lu", nodeAddress,
+             (unsigned long)start, (unsigned long)(next - 1), (unsigned long)end.newest);
+    }
+}
+
+// Record frames of the window being received, uploaded once it closed
+struct HistoryFrame {
+    uint32_t first;
+    uint32_t count;
+    char records[HISTORY_FRAME_CHARS + 1];
+};
+static HistoryFrame historyFrames[HISTORY_WINDOW];
+
+// One window into historyFrames: record frames are kept only while they
+// continue from since, anything after a lost frame is dropped and asked for
+// again; frames is how many were kept. true once the closing frame arrived,
+// which is copied to end.
+bool requestHistory(int nodeAddress, uint32_t since, uint32_t window, int& frames, NodeHistory& end) {
+    frames = 0;
+    if (window > HISTORY_WINDOW) window = HISTORY_WINDOW;
+    int len = snprintf(txBuffer, sizeof(txBuffer), "{\"command\":\"history\",\"since\":%lu,\"win\":%lu}",
+                       (unsigned long)since, (unsigned long)window);
+    if (!sendToNode(nodeAddress, txBuffer, len)) return false;
+
+    uint32_t expected = since;
+    MsgView frame;
+    while (awaitNodeReply(nodeAddress, frame, HISTORY_REPLY_TIMEOUT_MS)) {
+        JsonDocument doc(&jsonArena);
+        NodeHistory reply;
+        if (parseNodeHistory(doc, frame, reply)) {
+            LOGE(TAG_HIST, "History JSON parse error for Node %d", nodeAddress);
+            continue;
+        }
+        if (reply.end) {
+            end = reply;
+            return true;
+        }
+        if (reply.first != expected || !reply.count || frames >= (int)window ||
+            strlen(reply.records) >= sizeof(historyFrames[0].records)) {
+            LOGD(TAG_HIST, "Node %d history frame %lu out of order, expected %lu", nodeAddress,
+                 (unsigned long)reply.first, (unsigned long)expected);
+            continue;
+        }
+        HistoryFrame& kept = historyFrames[frames++];
+        kept.first = reply.first;
+        kept.count = reply.count;
+        strcpy(kept.records, reply.records);
+        expected = reply.first + reply.count;
+        metrics.packetsRx++;
+    }
+    LOGW(TAG_HIST, "History window of Node %d timed out", nodeAddress);
+    return false;
+}
+
+// Upload the frames requestHistory kept, next moves past each one the
+// uplink took. false at the first one it refused.
+bool pushHistory(int nodeAddress, int frames, uint32_t& next) {
+    char nodeId[12];
+    snprintf(nodeId, sizeof(nodeId), "node_%d", nodeAddress);
+    for (int i = 0; i < frames; i++) {
+        const HistoryFrame& kept = historyFrames[i];
+        if (!PushHistory(nodeId, kept.records, kept.first, frameLink(-1))) {
+            LOGW(TAG_HIST, "History of Node %d from %lu not uploaded, kept for the next sync", nodeAddress,
+                 (unsigned long)kept.first);
+            return false;
+        }
+        next = kept.first + kept.count;
+        metrics.historyRecords += kept.count;
+    }
+    return true;
+}
+
+// Frames nobody asked for: currently only leak alerts
+void checkUnsolicited() {
+    int packetSize = LoRa.parsePacket();
+    if (packetSize <= 0) return;
+
+    metricsAddAirtime(false, packetSize);
+    byte sender, receiver;
+    readFrameAddress(sender, receiver);
+    if (receiver != GATEWAY_ID) {
+        if (!forwardOverheard(sender, receiver)) discardLoRaPayload();
+        return;
+    }
+
+    MsgView frame = readLoRaPayload(rxBuffer, sizeof(rxBuffer));
+    if (!handleAlertFrame(sender, frame) && !handleHelloReply(sender, frame)) {
+        LOGD(TAG_POLL, "Ignored unsolicited frame from Node %d: %s", sender, frame.data);
+    }
+}
+
+// Forward a leak alert immediately, bypassing the poll schedule, then
+// acknowledge it so the node stops retrying. Returns false for other frames.
+bool handleAlertFrame(int nodeAddress, MsgView frame, bool ack) {
+    if (!strstr(frame.data, "\"alert\"")) return false;
+
+    JsonDocument doc(&jsonArena);
+    if (deserializeJson(doc, frame.data, frame.len) != DeserializationError::Ok) {
+        LOGE(TAG_POLL, "Alert JSON parse error for Node %d", nodeAddress);
+        return true;
+    }
+
+    const char* kind = doc["alert"] | "unknown";
+    const char* sensorId = doc["sensorId"] | "";
+    float lpm = doc["lpm"] | 0.0f;
+    uint32_t dur = doc["dur"] | 0UL;
+    uint32_t ts = doc["ts"] | 0UL;
+    PayloadLink link = frameLink(doc["seq"] | -1L);
+    metrics.alertsRx++;
+    LOGW(TAG_POLL, "Leak alert from Node %d, %s: %s, %.2f L/min for %lu s",
+         nodeAddress, sensorId, kind, lpm, (unsigned long)dur);
+
+    char nodeId[12];
+    snprintf(nodeId, sizeof(nodeId), "node_%d", nodeAddress);
+    PushAlert(nodeId, sensorId, kind, lpm, dur, ts, link);
+
+    if (ack) {
+        char reply[8];
+        int replyLen = snprintf(reply, sizeof(reply), "ak%d", nodeAddress);
+        sendToNode(nodeAddress, reply, replyLen);
+    }
+    return true;
+}
+
+// A node frame addressed to another gateway of the deployment, from a node
+// that gateway polls. Data and alerts are still forwarded, stamped with our id and RSSI, so a node keeps
+// reaching the backend through whichever gateway hears it best; the backend
+// drops the duplicate copies. Only the addressed gateway acks or replies.
+// Returns false (payload left unread) for anything else.
+bool forwardOverheard(int sender, int receiver) {
+    if (receiver == GATEWAY_ID || !isGatewayAddress(receiver) || !isNodeAddress(sender)) return false;
+
+    MsgView frame = readLoRaPayload(rxBuffer, sizeof(rxBuffer));
+    if (handleAlertFrame(sender, frame, false)) {
+        metrics.overheard++;
+    } else if (strstr(frame.data, "\"sensorId\"")) {
+        metrics.overheard++;
+        processNodeData(sender, frame);
+    }
+    return true;
+}
+
+// Link stamp for the frame just read: RSSI of the last received packet
+PayloadLink frameLink(long seq) {
+    PayloadLink link = {GATEWAY_NAME, LoRa.packetRssi(), seq};
+    return link;
+}
@@ -0,0 +1,134 @@
+#include "metrics.h"
+#include "dataPush.h"
+#include "gatewayClock.h"
+#include "../Common/diag.h"
+#include "../Common/frame.h"
+#include "../Common/gateways.h"
+
+GatewayMetrics metrics;
+
+// Bucket bounds
+static const uint32_t POLL_RTT_BOUNDS[] = {250, 500, 1000, 2000, 4000, 8000, 15000};
+static const uint32_t PACKETS_BOUNDS[] = {0, 1, 2, 3, 4, 6, 8};
+static const uint32_t HTTP_BOUNDS[] = {50, 100, 200, 400, 800, 1600, 3200};
+
+#define COUNT_OF(a) (sizeof(a) / sizeof(a[0]))
+
+// Buffer tĩnh cho payload metrics gửi lên server
+static char metricsBuffer[1344];
+
+void metricsInit() {
+    memset(&metrics, 0, sizeof(metrics));
+    for (int i = 0; i < METRICS_MAX_NODES; i++) {
+        metrics.pollRtt[i].init(POLL_RTT_BOUNDS, COUNT_OF(POLL_RTT_BOUNDS));
+    }
+    metrics.packetsPerPoll.init(PACKETS_BOUNDS, COUNT_OF(PACKETS_BOUNDS));
+    metrics.httpLatency.init(HTTP_BOUNDS, COUNT_OF(HTTP_BOUNDS));
+}
+
+void metricsAddAirtime(bool tx, size_t frameLen) {
+    uint32_t ms = (loraAirtimeUs(frameLen) + 500) / 1000;
+    if (tx) metrics.airtimeTxMs += ms;
+    else metrics.airtimeRxMs += ms;
+}
+
+// Append formatted text, keeping track of the remaining space
+static void appendf(char*& p, size_t& remaining, const char* fmt, ...) {
+    if (remaining <= 1) return;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(p, remaining, fmt, args);
+    va_end(args);
+    if (n < 0) return;
+    size_t used = (size_t)n < remaining ? (size_t)n : remaining - 1;
+    p += used;
+    remaining -= used;
+}
+
+static void appendHistJson(char*& p, size_t& remaining, const char* name, const Histogram& h) {
+    appendf(p, remaining, "\"%s\":{\"le\":[", name);
+    for (uint8_t i = 0; i < h.numBounds; i++) {
+        appendf(p, remaining, i ? ",%u" : "%u", (unsigned)h.bounds[i]);
+    }
+    appendf(p, remaining, "],\"c\":[");
+    for (uint8_t i = 0; i <= h.numBounds; i++) {
+        appendf(p, remaining, i ? ",%u" : "%u", (unsigned)h.counts[i]);
+    }
+    appendf(p, remaining, "],\"n\":%u,\"sum\":%u,\"max\":%u}",
+            (unsigned)h.count, (unsigned)h.sum, (unsigned)h.max);
+}
+
+// Compact form for Serial: name=count/mean/p95/max
+static void printHistCompact(const char* name, const Histogram& h) {
+    Serial.printf(" %s=%u/%u/%u/%u", name, (unsigned)h.count,
+                  (unsigned)(h.count ? h.sum / h.count : 0), (unsigned)h.percentile(95), (unsigned)h.max);
+}
+
+void metricsReport(int numNodes) {
+    if (numNodes > METRICS_MAX_NODES) numNodes = METRICS_MAX_NODES;
+
+    metrics.freeHeap = ESP.getFreeHeap();
+    metrics.minFreeHeap = ESP.getMinFreeHeap();
+
+    // Serial: một dòng rút gọn
+    Serial.printf("[M] poll=%u to=%u rssi_to=%u rx=%u http=%u/%u mqtt=%u/%u/%u air=%u/%ums heap=%u/%u",
+                  (unsigned)metrics.polls, (unsigned)metrics.pollTimeouts,
+                  (unsigned)metrics.rssiTimeouts, (unsigned)metrics.packetsRx,
+                  (unsigned)metrics.httpOk, (unsigned)metrics.httpFail,
+                  (unsigned)metrics.mqttAcked, (unsigned)metrics.mqttRetries, (unsigned)metrics.mqttDropped,
+                  (unsigned)metrics.airtimeTxMs, (unsigned)metrics.airtimeRxMs,
+                  (unsigned)metrics.freeHeap, (unsigned)metrics.minFreeHeap);
+    for (int i = 0; i < numNodes; i++) {
+        char name[8];
+        snprintf(name, sizeof(name), "rtt%d", i + 1);
+        printHistCompact(name, metrics.pollRtt[i]);
+    }
+    printHistCompact("pkt", metrics.packetsPerPoll);
+    printHistCompact("http", metrics.httpLatency);
+    Serial.println();
+
+    // JSON cho endpoint /metrics
+    char* p = metricsBuffer;
+    size_t remaining = sizeof(metricsBuffer);
+    appendf(p, remaining, "{\"gateway_id\":\"%s\",\"uptime_s\":%lu,", GATEWAY_NAME, millis() / 1000);
+    appendf(p, remaining,
+            "\"counters\":{\"polls\":%u,\"poll_timeouts\":%u,\"rssi_timeouts\":%u,"
+            "\"packets_rx\":%u,\"alerts_rx\":%u,\"overheard\":%u,\"relayed\":%u,\"history_records\":%u,"
+            "\"http_ok\":%u,\"http_fail\":%u,"
+            "\"mqtt_connects\":%u,\"mqtt_acked\":%u,\"mqtt_retries\":%u,\"mqtt_dropped\":%u,"
+            "\"wifi_connects\":%u,\"airtime_tx_ms\":%u,\"airtime_rx_ms\":%u},",
+            (unsigned)metrics.polls, (unsigned)metrics.pollTimeouts,
+            (unsigned)metrics.rssiTimeouts, (unsigned)metrics.packetsRx, (unsigned)metrics.alertsRx,
+            (unsigned)metrics.overheard, (unsigned)metrics.relayed, (unsigned)metrics.historyRecords,
+            (unsigned)metrics.httpOk, (unsigned)metrics.httpFail, (unsigned)metrics.mqttConnects,
+            (unsigned)metrics.mqttAcked, (unsigned)metrics.mqttRetries, (unsigned)metrics.mqttDropped,
+            (unsigned)metrics.wifiConnects,
+            (unsigned)metrics.airtimeTxMs, (unsigned)metrics.airtimeRxMs);
+    appendf(p, remaining,
+            "\"gauges\":{\"free_heap\":%u,\"min_free_heap\":%u,\"first_reading_ms\":%u,\"clock\":\"%s\"},"
+            "\"hist\":{",
+            (unsigned)metrics.freeHeap, (unsigned)metrics.minFreeHeap, (unsigned)metrics.firstReadingMs,
+            clockSourceName());
+    for (int i = 0; i < numNodes; i++) {
+        char name[24];
+        snprintf(name, sizeof(name), "poll_rtt_node_%d", i + 1);
+        appendHistJson(p, remaining, name, metrics.pollRtt[i]);
+        appendf(p, remaining, ",");
+    }
+    appendHistJson(p, remaining, "packets_per_poll", metrics.packetsPerPoll);
+    appendf(p, remaining, ",");
+    appendHistJson(p, remaining, "http_latency", metrics.httpLatency);
+    appendf(p, remaining, "},\"diag\":");
+    if (remaining > 1) {
+        size_t used = diagFormat(p, remaining);
+        p += used;
+        remaining -= used;
+    }
+    appendf(p, remaining, "}");
+
+    if (remaining <= 1) {
+        Serial.println("Metrics payload truncated, not pushed");
+        return;
+    }
+    PushMetrics(metricsBuffer, p - metricsBuffer);
+}
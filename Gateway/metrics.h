@@ -0,0 +1,53 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include "histogram.h"
+
+#define METRICS_MAX_NODES 4
+
+// In-memory metrics registry of the Gateway. Counters and histograms are
+// cumulative since boot, gauges hold the last sampled value.
+struct GatewayMetrics {
+    // Counters
+    uint32_t polls;
+    uint32_t pollTimeouts;
+    uint32_t rssiTimeouts;
+    uint32_t packetsRx;
+    uint32_t alertsRx;                      // unsolicited leak alerts from nodes
+    uint32_t overheard;                     // node frames addressed to another gateway, forwarded
+    uint32_t relayed;                       // node frames that came through a relay
+    uint32_t historyRecords;                // interval records backfilled from node flash
+    uint32_t httpOk;
+    uint32_t httpFail;
+    uint32_t mqttConnects;
+    uint32_t mqttAcked;
+    uint32_t mqttRetries;                   // PUBLISH resent with DUP
+    uint32_t mqttDropped;                   // queue full or payload too large
+    uint32_t wifiConnects;
+    uint32_t airtimeTxMs;
+    uint32_t airtimeRxMs;
+
+    // Gauges
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    uint32_t firstReadingMs;                // boot to the first node reading, 0 until then
+
+    // Histograms
+    Histogram pollRtt[METRICS_MAX_NODES];   // ms, per node index
+    Histogram packetsPerPoll;
+    Histogram httpLatency;                  // ms
+};
+
+extern GatewayMetrics metrics;
+
+// Khởi tạo bucket cho các histogram
+void metricsInit();
+
+// Cộng thời gian phát/thu của một gói LoRa (tính cả 2 byte địa chỉ)
+void metricsAddAirtime(bool tx, size_t frameLen);
+
+// Lấy mẫu gauge, in dạng rút gọn ra Serial và đẩy lên server
+void metricsReport(int numNodes);
+
+#endif
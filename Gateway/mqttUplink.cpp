@@ -0,0 +1,268 @@
+#include "mqttUplink.h"
+#include "metrics.h"
+#include "../Common/log.h"
+
+// MQTT 3.1.1 packet types (fixed header, high nibble)
+#define MQTT_CONNECT   0x10
+#define MQTT_CONNACK   0x20
+#define MQTT_PUBLISH   0x30
+#define MQTT_PUBACK    0x40
+#define MQTT_PINGREQ   0xC0
+#define MQTT_PINGRESP  0xD0
+
+#define MQTT_FLAG_DUP  0x08
+#define MQTT_FLAG_QOS1 0x02
+
+// Remaining Length: 7 bits per byte, high bit = more bytes follow
+static size_t encodeLength(uint8_t* out, size_t len) {
+    size_t n = 0;
+    do {
+        uint8_t b = len % 128;
+        len /= 128;
+        out[n++] = len ? (b | 0x80) : b;
+    } while (len);
+    return n;
+}
+
+static size_t encodeString(uint8_t* out, const char* s, size_t len) {
+    out[0] = len >> 8;
+    out[1] = len & 0xFF;
+    memcpy(out + 2, s, len);
+    return len + 2;
+}
+
+void MqttUplink::begin() {
+    // Usually WiFi is still connecting; loop() connects once it is up
+    if (WiFi.status() == WL_CONNECTED) connect();
+}
+
+bool MqttUplink::connect() {
+    lastConnectAttempt = millis();
+    if (!client.connect(MQTT_BROKER_HOST, MQTT_BROKER_PORT)) {
+        LOGW(TAG_MQTT, "Broker %s:%d unreachable", MQTT_BROKER_HOST, MQTT_BROKER_PORT);
+        return false;
+    }
+    client.setNoDelay(true);
+
+    // Clean Session = 0: the broker keeps our session, and unacknowledged
+    // QoS1 messages survive a reconnect on both sides
+    static const uint8_t variableHeader[] = {
+        0, 4, 'M', 'Q', 'T', 'T', 4, 0x00, MQTT_KEEPALIVE_S >> 8, MQTT_KEEPALIVE_S & 0xFF,
+    };
+    uint8_t pkt[64];
+    size_t idLen = strlen(MQTT_CLIENT_ID);
+    size_t n = 0;
+    pkt[n++] = MQTT_CONNECT;
+    n += encodeLength(pkt + n, sizeof(variableHeader) + 2 + idLen);
+    memcpy(pkt + n, variableHeader, sizeof(variableHeader));
+    n += sizeof(variableHeader);
+    n += encodeString(pkt + n, MQTT_CLIENT_ID, idLen);
+    if (!send(pkt, n)) return false;
+
+    uint8_t type;
+    uint8_t body[2];
+    size_t bodyLen;
+    if (!readPacket(type, body, sizeof(body), bodyLen, 3000) || type != MQTT_CONNACK ||
+        bodyLen < 2 || body[1] != 0) {
+        LOGE(TAG_MQTT, "CONNECT rejected or timed out");
+        disconnect();
+        return false;
+    }
+    connected = true;
+    metrics.mqttConnects++;
+    LOGI(TAG_MQTT, "Connected, session present: %d", body[0] & 1);
+
+    // Resend everything still unacknowledged, flagged as duplicates
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (window[i].packetId) transmit(window[i], window[i].sentAt != 0);
+    }
+    drainQueue();
+    return true;
+}
+
+void MqttUplink::disconnect() {
+    client.stop();
+    connected = false;
+}
+
+bool MqttUplink::send(const uint8_t* data, size_t len) {
+    if (client.write(data, len) != len) {
+        LOGW(TAG_MQTT, "Write failed, reconnecting");
+        disconnect();
+        return false;
+    }
+    lastTx = millis();
+    return true;
+}
+
+void MqttUplink::transmit(InFlight& slot, bool dup) {
+    if (dup) {
+        slot.packet[0] |= MQTT_FLAG_DUP;
+        metrics.mqttRetries++;
+    }
+    if (send(slot.packet, slot.len)) slot.sentAt = millis();
+}
+
+bool MqttUplink::readByte(uint8_t& b, uint32_t timeoutMs) {
+    uint32_t start = millis();
+    while (!client.available()) {
+        if (millis() - start >= timeoutMs || !client.connected()) return false;
+        delay(1);
+    }
+    b = client.read();
+    return true;
+}
+
+// Reads one whole packet; bytes beyond cap are consumed and discarded
+bool MqttUplink::readPacket(uint8_t& type, uint8_t* body, size_t cap, size_t& bodyLen, uint32_t timeoutMs) {
+    uint8_t b;
+    if (!readByte(type, timeoutMs)) return false;
+
+    size_t remaining = 0;
+    for (int shift = 0; shift <= 21; shift += 7) {
+        if (!readByte(b, 1000)) return false;
+        remaining |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+    }
+
+    bodyLen = 0;
+    for (size_t i = 0; i < remaining; i++) {
+        if (!readByte(b, 1000)) return false;
+        if (i < cap) body[bodyLen++] = b;
+    }
+    return true;
+}
+
+void MqttUplink::handleIncoming() {
+    uint8_t type;
+    uint8_t body[4];
+    size_t bodyLen;
+    if (!readPacket(type, body, sizeof(body), bodyLen, 0)) {
+        disconnect();
+        return;
+    }
+
+    if ((type & 0xF0) == MQTT_PUBACK && bodyLen >= 2) {
+        uint16_t id = (body[0] << 8) | body[1];
+        for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+            if (window[i].packetId == id) {
+                window[i].packetId = 0;
+                metrics.mqttAcked++;
+                break;
+            }
+        }
+    }
+    // PINGRESP needs no handling; anything else is unexpected for a publisher
+}
+
+void MqttUplink::loop() {
+    if (WiFi.status() != WL_CONNECTED) return;
+
+    if (!connected || !client.connected()) {
+        connected = false;
+        if (millis() - lastConnectAttempt >= MQTT_RECONNECT_MS) connect();
+        return;
+    }
+
+    while (connected && client.available()) handleIncoming();
+    if (connected) drainQueue();
+
+    uint32_t now = millis();
+    for (int i = 0; i < MQTT_INFLIGHT_MAX && connected; i++) {
+        if (window[i].packetId && now - window[i].sentAt >= MQTT_RETRY_MS) transmit(window[i], true);
+    }
+
+    if (connected && now - lastTx >= MQTT_KEEPALIVE_S * 1000UL / 2) {
+        static const uint8_t ping[] = {MQTT_PINGREQ, 0};
+        send(ping, sizeof(ping));
+    }
+}
+
+MqttUplink::InFlight* MqttUplink::freeSlot() {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (!window[i].packetId) return &window[i];
+    }
+    return nullptr;
+}
+
+// Move queued readings into free window slots, oldest first. While
+// disconnected they wait in the window and go out on reconnect.
+void MqttUplink::drainQueue() {
+    InFlight* slot;
+    while (queued && (slot = freeSlot()) != nullptr) {
+        const Queued& entry = queue[queueHead];
+        queueHead = (queueHead + 1) % MQTT_QUEUE_MAX;
+        queued--;
+
+        uint16_t id = allocPacketId();
+        memcpy(slot->packet, entry.packet, entry.len);
+        slot->packet[entry.idOffset] = id >> 8;
+        slot->packet[entry.idOffset + 1] = id & 0xFF;
+        slot->len = entry.len;
+        slot->packetId = id;
+        slot->sentAt = 0;
+        if (connected) transmit(*slot, false);
+    }
+}
+
+uint16_t MqttUplink::allocPacketId() {
+    for (;;) {
+        uint16_t id = nextPacketId++;
+        if (!nextPacketId) nextPacketId = 1;
+        bool used = false;
+        for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) used |= window[i].packetId == id;
+        if (!used) return id;
+    }
+}
+
+bool MqttUplink::publish(UplinkChannel channel, const char* source, const char* payload, size_t len) {
+    char topic[32];
+    int topicLen = snprintf(topic, sizeof(topic), "%s%s",
+                            channel == UPLINK_METRICS ? MQTT_TOPIC_METRICS : MQTT_TOPIC_READING, source);
+    if (topicLen < 0 || topicLen >= (int)sizeof(topic)) return false;
+
+    // Metrics: QoS0 straight from the caller's buffer, a lost snapshot is
+    // replaced by the next one
+    if (channel == UPLINK_METRICS) {
+        if (!connected) return false;
+        uint8_t head[8 + sizeof(topic)];
+        size_t n = 0;
+        head[n++] = MQTT_PUBLISH;
+        n += encodeLength(head + n, 2 + topicLen + len);
+        n += encodeString(head + n, topic, topicLen);
+        return send(head, n) && send((const uint8_t*)payload, len);
+    }
+
+    size_t remaining = 2 + topicLen + 2 + len;
+    if (remaining + 4 > MQTT_PACKET_MAX) {
+        metrics.mqttDropped++;
+        LOGE(TAG_MQTT, "Payload of %u bytes too large", (unsigned)len);
+        return false;
+    }
+
+    uint32_t start = millis();
+    while (queued == MQTT_QUEUE_MAX && connected && millis() - start < MQTT_WINDOW_WAIT_MS) {
+        loop();
+        delay(5);
+    }
+    if (queued == MQTT_QUEUE_MAX) {
+        metrics.mqttDropped++;
+        LOGW(TAG_MQTT, "Queue of %d readings full, dropped reading of %s", MQTT_QUEUE_MAX, source);
+        return false;
+    }
+
+    // Always through the queue, so readings leave in the order they came
+    Queued& entry = queue[(queueHead + queued++) % MQTT_QUEUE_MAX];
+    uint8_t* p = entry.packet;
+    size_t n = 0;
+    p[n++] = MQTT_PUBLISH | MQTT_FLAG_QOS1;
+    n += encodeLength(p + n, remaining);
+    n += encodeString(p + n, topic, topicLen);
+    entry.idOffset = n;
+    n += 2;
+    memcpy(p + n, payload, len);
+    entry.len = n + len;
+
+    drainQueue();
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef MQTT_UPLINK_H
+#define MQTT_UPLINK_H
+
+#include <WiFi.h>
+#include "uplink.h"
+#include "../Common/gateways.h"
+
+// Broker and session
+#define MQTT_BROKER_HOST "192.168.0.150"
+#define MQTT_BROKER_PORT 1883
+#define MQTT_CLIENT_ID GATEWAY_NAME     // fixed per gateway, the broker keeps our session across reconnects
+#define MQTT_KEEPALIVE_S 60
+
+// QoS1 window
+#define MQTT_INFLIGHT_MAX 8             // PUBLISH packets awaiting PUBACK
+#define MQTT_PACKET_MAX 232             // one encoded reading PUBLISH
+#define MQTT_RETRY_MS 5000              // resend with DUP if no PUBACK by then
+#define MQTT_QUEUE_MAX 64               // readings waiting for a window slot, ~15 KB of RAM
+#define MQTT_WINDOW_WAIT_MS 2000        // publish() waits this long for room in a full queue
+#define MQTT_RECONNECT_MS 5000
+
+// Topics: readings on "w/<node_id>" (QoS1), metrics on "m/<gateway_id>" (QoS0)
+#define MQTT_TOPIC_READING "w/"
+#define MQTT_TOPIC_METRICS "m/"
+
+// Minimal MQTT 3.1.1 publisher over one persistent TCP connection. Each
+// reading costs a 2-byte fixed header, the short topic and a packet id
+// instead of a TCP handshake and HTTP headers. Readings stay in the window
+// (also while disconnected) until the broker acknowledges them; behind a
+// full window they wait in a RAM queue that drains as PUBACKs come in, so an
+// outage of up to MQTT_INFLIGHT_MAX + MQTT_QUEUE_MAX readings loses none.
+class MqttUplink : public Uplink {
+public:
+    void begin() override;
+    void loop() override;
+    bool publish(UplinkChannel channel, const char* source, const char* payload, size_t len) override;
+
+private:
+    struct InFlight {
+        uint16_t packetId;      // 0 = free slot
+        uint16_t len;
+        uint32_t sentAt;
+        uint8_t packet[MQTT_PACKET_MAX];
+    };
+
+    // Encoded PUBLISH without its packet id, given when it enters the window
+    struct Queued {
+        uint16_t len;
+        uint16_t idOffset;
+        uint8_t packet[MQTT_PACKET_MAX];
+    };
+
+    WiFiClient client;
+    InFlight window[MQTT_INFLIGHT_MAX] = {};
+    Queued queue[MQTT_QUEUE_MAX];
+    int queueHead = 0;
+    int queued = 0;
+    uint16_t nextPacketId = 1;
+    uint32_t lastTx = 0;
+    uint32_t lastConnectAttempt = 0;
+    bool connected = false;
+
+    bool connect();
+    void disconnect();
+    bool send(const uint8_t* data, size_t len);
+    void transmit(InFlight& slot, bool dup);
+    bool readByte(uint8_t& b, uint32_t timeoutMs);
+    bool readPacket(uint8_t& type, uint8_t* body, size_t cap, size_t& bodyLen, uint32_t timeoutMs);
+    void handleIncoming();
+    InFlight* freeSlot();
+    void drainQueue();
+    uint16_t allocPacketId();
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef NODE_FRAME_H
+#define NODE_FRAME_H
+
+#include <ArduinoJson.h>
+#include "../Common/frame.h"
+
+// Parsing of the frames nodes send to the Gateway. Needs only ArduinoJson
+// and MsgView, so host tools (tools/bench) time the Gateway's own parsing.
+// Strings point into doc and are valid as long as it is.
+
+// Data frame {"nodeId":N,"sensorId":"...",<fields>,"seq":S,"ts":T}, or a
+// power-quality batch {"nodeId":N,"pq":"power1","iv":900,"t":T,"b":"..."}
+struct NodeReading {
+    const char* sensorId;
+    uint32_t ts;            // node capture time, 0 if the node clock is not synced
+    long seq;               // node frame counter, -1 if the frame had none
+    bool energy;            // Power/Voltage frame (Node 2), otherwise Water (Node 1)
+    float value;            // Water or Power
+    float voltage;          // energy frames only
+    const char* pq;         // sensor of a power-quality batch, NULL for a reading
+    const char* pqRecords;  // base64 records of the batch
+    uint32_t pqStart;
+    uint32_t pqInterval;
+};
+
+// The kind of reading follows from its fields, not from the node address:
+// any node may carry either sensor (GATEWAY_NODES, Common/gateways.h).
+inline DeserializationError parseNodeReading(JsonDocument& doc, MsgView data, NodeReading& out) {
+    DeserializationError error = deserializeJson(doc, data.data, data.len);
+    if (error) return error;
+
+    out.sensorId = doc["sensorId"] | "";
+    out.ts = doc["ts"] | 0UL;
+    out.seq = doc["seq"] | -1L;
+    out.pq = doc["pq"].as<const char*>();
+    if (out.pq) {
+        out.pqRecords = doc["b"] | "";
+        out.pqStart = doc["t"] | 0UL;
+        out.pqInterval = doc["iv"] | 0UL;
+        out.energy = false;
+        out.value = out.voltage = 0;
+        return error;
+    }
+    out.pqRecords = NULL;
+    out.pqStart = out.pqInterval = 0;
+    out.energy = doc["Power"].is<float>();
+    out.value = out.energy ? (doc["Power"] | 0.0f) : (doc["Water"] | 0.0f);
+    out.voltage = out.energy ? (doc["Voltage"] | 0.0f) : 0.0f;
+    return error;
+}
+
+// Node address in a frame, 0 if it has none; frames inside a relay
+// aggregate (Common/mesh.h) name their node only here. data must be
+// NUL-terminated.
+inline int frameNodeId(MsgView data) {
+    static const char KEY[] = "\"nodeId\":";
+    const char* p = strstr(data.data, KEY);
+    return p ? atoi(p + sizeof(KEY) - 1) : 0;
+}
+
+// Reply to the history command (Common/nodeRuntime.h): record frames
+// {"nodeId":N,"h":S,"b":"<base64>"}, then {"nodeId":N,"hnext":X,"hfirst":F,"hlast":L}
+struct NodeHistory {
+    bool end;               // the closing frame of a window
+    uint32_t first;         // seq of the first record in b
+    uint32_t count;         // records in b
+    const char* records;    // base64 of 12-byte records, 16 characters each
+    uint32_t next;          // closing frame: first seq not sent
+    uint32_t oldest;        // closing frame: oldest and newest seq the node still holds
+    uint32_t newest;
+};
+
+inline DeserializationError parseNodeHistory(JsonDocument& doc, MsgView data, NodeHistory& out) {
+    DeserializationError error = deserializeJson(doc, data.data, data.len);
+    if (error) return error;
+    out.end = doc["hnext"].is<uint32_t>();
+    out.first = doc["h"] | 0UL;
+    out.records = doc["b"] | "";
+    out.count = strlen(out.records) / 16;
+    out.next = doc["hnext"] | 0UL;
+    out.oldest = doc["hfirst"] | 0UL;
+    out.newest = doc["hlast"] | 0UL;
+    return error;
+}
+
+// Reply to getRSSI: {"nodeId":N,"status":"online","rssi":R}
+struct NodeRssi {
+    int rssi;               // what the node heard from the Gateway, dBm
+    const char* status;
+};
+
+inline DeserializationError parseNodeRssi(JsonDocument& doc, MsgView data, NodeRssi& out) {
+    DeserializationError error = deserializeJson(doc, data.data, data.len);
+    if (error) return error;
+    out.rssi = doc["rssi"] | 0;
+    out.status = doc["status"] | "unknown";
+    return error;
+}
+
+#endif
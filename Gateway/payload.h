@@ -0,0 +1,98 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// JSON payload formats posted to /stream_data. Plain snprintf with no Arduino
+// dependency, so host tools (tools/loadgen) produce byte-identical requests.
+// Each formatter returns the payload length, clamped to cap - 1.
+
+static inline size_t payloadClamp(int len, size_t cap) {
+    if (len < 0) return 0;
+    return (size_t)len < cap ? (size_t)len : cap - 1;
+}
+
+// Which gateway heard the frame and how well. seq is the node's frame
+// counter (-1 if the frame had none); together with node_id and sensor_id it
+// identifies a reading, so the backend can drop copies forwarded by other
+// gateways and keep the best-RSSI one.
+struct PayloadLink {
+    const char* gateway;
+    int rssi;
+    long seq;
+};
+
+// Append the optional link stamp and "ts" field, then close the object
+static inline size_t payloadClose(char* buf, size_t cap, size_t len, uint32_t ts,
+                                  const PayloadLink* link) {
+    int n;
+    if (link) {
+        n = link->seq >= 0
+            ? snprintf(buf + len, cap - len, ",\"gateway\":\"%s\",\"gw_rssi\":%d,\"seq\":%ld",
+                       link->gateway, link->rssi, link->seq)
+            : snprintf(buf + len, cap - len, ",\"gateway\":\"%s\",\"gw_rssi\":%d",
+                       link->gateway, link->rssi);
+        len = payloadClamp((int)len + (n < 0 ? 0 : n), cap);
+    }
+    n = ts
+        ? snprintf(buf + len, cap - len, ",\"ts\":%lu}", (unsigned long)ts)
+        : snprintf(buf + len, cap - len, "}");
+    return payloadClamp((int)len + (n < 0 ? 0 : n), cap);
+}
+
+static inline size_t formatPayloadE(char* buf, size_t cap, const char* nodeId, const char* sensorId,
+                                    float power, float voltage, uint32_t ts, const PayloadLink* link) {
+    int len = voltage > 0
+        ? snprintf(buf, cap, "{\"node_id\":\"%s\",\"sensor_id\":\"%s\",\"power\":%.2f,\"voltage\":%.2f",
+                   nodeId, sensorId, power, voltage)
+        : snprintf(buf, cap, "{\"node_id\":\"%s\",\"sensor_id\":\"%s\",\"power\":%.2f",
+                   nodeId, sensorId, power);
+    return payloadClose(buf, cap, payloadClamp(len, cap), ts, link);
+}
+
+static inline size_t formatPayloadW(char* buf, size_t cap, const char* nodeId, const char* sensorId,
+                                    float water, uint32_t ts, const PayloadLink* link) {
+    int len = snprintf(buf, cap, "{\"node_id\":\"%s\",\"sensor_id\":\"%s\",\"water\":%.2f",
+                       nodeId, sensorId, water);
+    return payloadClose(buf, cap, payloadClamp(len, cap), ts, link);
+}
+
+// Leak alert forwarded as soon as it arrives; "alert" selects the alert collection
+static inline size_t formatPayloadAlert(char* buf, size_t cap, const char* nodeId, const char* sensorId,
+                                        const char* kind, float litresPerMin, uint32_t durationSec,
+                                        uint32_t ts, const PayloadLink* link) {
+    int len = snprintf(buf, cap,
+                       "{\"node_id\":\"%s\",\"sensor_id\":\"%s\",\"alert\":\"%s\",\"lpm\":%.2f,\"dur\":%lu",
+                       nodeId, sensorId, kind, litresPerMin, (unsigned long)durationSec);
+    return payloadClose(buf, cap, payloadClamp(len, cap), ts, link);
+}
+
+// Batch of power-quality intervals from a node, forwarded as received: "pq"
+// is base64 of 12-byte records, the first interval starts at t0, one every iv s
+static inline size_t formatPayloadPq(char* buf, size_t cap, const char* nodeId, const char* sensorId,
+                                     const char* records, uint32_t t0, uint32_t iv, const PayloadLink* link) {
+    int len = snprintf(buf, cap, "{\"node_id\":\"%s\",\"sensor_id\":\"%s\",\"pq\":\"%s\",\"t0\":%lu,\"iv\":%lu",
+                       nodeId, sensorId, records, (unsigned long)t0, (unsigned long)iv);
+    return payloadClose(buf, cap, payloadClamp(len, cap), 0, link);
+}
+
+// Records backfilled from a node's flash history: "hist" is base64 of
+// 12-byte records (ts, then one float per channel), the first one is seq h
+static inline size_t formatPayloadHistory(char* buf, size_t cap, const char* nodeId, const char* records,
+                                          uint32_t first, const PayloadLink* link) {
+    int len = snprintf(buf, cap, "{\"node_id\":\"%s\",\"sensor_id\":\"history\",\"hist\":\"%s\",\"h\":%lu",
+                       nodeId, records, (unsigned long)first);
+    return payloadClose(buf, cap, payloadClamp(len, cap), 0, link);
+}
+
+// sensor_id "rssi" selects the rssi collection on the backend
+static inline size_t formatPayloadRssi(char* buf, size_t cap, const char* nodeId, int rssi,
+                                       const PayloadLink* link) {
+    int len = snprintf(buf, cap, "{\"node_id\":\"%s\",\"sensor_id\":\"rssi\",\"rssi\":%d",
+                       nodeId, rssi);
+    return payloadClose(buf, cap, payloadClamp(len, cap), 0, link);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PUSHED_FRAMES_H
+#define PUSHED_FRAMES_H
+
+#include <stdint.h>
+#include "../Common/gateways.h"
+
+#define PUSHED_FRAMES_PER_NODE 32
+
+// The last node frames pushed, per node, by (seq, ts). A relay keeps an
+// aggregate whose ack it missed, including when only the ack was lost, and
+// resends it as "agl<R>" at its next pollSub (Common/mesh.h), minutes to
+// hours later. That is long past the backend's dedup window
+// (services/dedup.js), so the Gateway drops the frames of such a late
+// aggregate it has pushed already.
+//
+// 32 frames cover the polls of a relay's backlog (RELAY_AGG_BACKLOG
+// aggregates of a few frames each) with room to spare. The record lives
+// in RAM: a late copy that arrives after a Gateway restart is pushed again.
+// Plain C++ so the host tests (tools/tests) build it as is.
+class PushedFrames {
+public:
+    // true if the frame was recorded already, otherwise records it. Frames
+    // without seq (-1) are never recorded.
+    bool repeat(int node, long seq, uint32_t ts) {
+        if (seq < 0 || node < NODE_ADDR_FIRST || node > NODE_ADDR_LAST) return false;
+        Slot* slots = slots_[node - NODE_ADDR_FIRST];
+        for (int i = 0; i < PUSHED_FRAMES_PER_NODE; i++) {
+            if (slots[i].used && slots[i].seq == (uint32_t)seq && slots[i].ts == ts) return true;
+        }
+        uint8_t& next = next_[node - NODE_ADDR_FIRST];
+        slots[next].used = true;
+        slots[next].seq = (uint32_t)seq;
+        slots[next].ts = ts;
+        next = (next + 1) % PUSHED_FRAMES_PER_NODE;
+        return false;
+    }
+
+private:
+    struct Slot {
+        bool used;
+        uint32_t seq;
+        uint32_t ts;
+    };
+    Slot slots_[NODE_ADDR_LAST - NODE_ADDR_FIRST + 1][PUSHED_FRAMES_PER_NODE] = {};
+    uint8_t next_[NODE_ADDR_LAST - NODE_ADDR_FIRST + 1] = {};
+};
+
+#endif
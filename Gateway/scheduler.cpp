@@ -0,0 +1,93 @@
+#include "scheduler.h"
+#include "../Common/log.h"
+
+// Min-heap of entry indexes ordered by due time
+static const ScheduleEntry* scheduleTable = NULL;
+static int scheduleCount = 0;
+static time_t dueTimes[MAX_SCHEDULE_ENTRIES];
+static uint8_t heap[MAX_SCHEDULE_ENTRIES];
+static bool heapBuilt = false;
+
+// Next occurrence of an entry strictly after 'after'
+static time_t nextOccurrence(const ScheduleEntry& entry, time_t after) {
+    if (entry.kind == SCHEDULE_INTERVAL) {
+        return after + (entry.intervalSec ? entry.intervalSec : 1);
+    }
+
+    struct tm local;
+    localtime_r(&after, &local);
+    local.tm_hour = entry.hour;
+    local.tm_min = entry.minute;
+    local.tm_sec = 0;
+    time_t candidate = mktime(&local);
+    if (candidate <= after) {
+        local.tm_mday += 1;   // mktime normalizes month/year rollover
+        candidate = mktime(&local);
+    }
+    return candidate;
+}
+
+static void swapNodes(int a, int b) {
+    uint8_t tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+static void siftDown(int i) {
+    while (true) {
+        int left = 2 * i + 1, right = left + 1, smallest = i;
+        if (left < scheduleCount && dueTimes[heap[left]] < dueTimes[heap[smallest]]) smallest = left;
+        if (right < scheduleCount && dueTimes[heap[right]] < dueTimes[heap[smallest]]) smallest = right;
+        if (smallest == i) return;
+        swapNodes(i, smallest);
+        i = smallest;
+    }
+}
+
+static void buildHeap(time_t now) {
+    for (int i = 0; i < scheduleCount; i++) {
+        heap[i] = i;
+        dueTimes[i] = nextOccurrence(scheduleTable[i], now);
+    }
+    for (int i = scheduleCount / 2 - 1; i >= 0; i--) siftDown(i);
+    heapBuilt = true;
+}
+
+void schedulerInit(const ScheduleEntry* entries, int count) {
+    scheduleTable = entries;
+    scheduleCount = count > MAX_SCHEDULE_ENTRIES ? MAX_SCHEDULE_ENTRIES : count;
+    heapBuilt = false;
+}
+
+int schedulerTick(time_t now, ScheduleHandler handler) {
+    if (scheduleCount == 0) return 0;
+    if (!heapBuilt) {
+        buildHeap(now);
+        LOGI(TAG_POLL, "Scheduler started, %d entries, next in %ld s",
+             scheduleCount, (long)(dueTimes[heap[0]] - now));
+    }
+
+    int ran = 0;
+    // Bounded by the table size so one tick never loops forever
+    while (ran < scheduleCount && dueTimes[heap[0]] <= now) {
+        uint8_t index = heap[0];
+        time_t due = dueTimes[index];
+        if (now - due > 60) {
+            LOGW(TAG_POLL, "Catch-up: entry %d was due %ld s ago", index, (long)(now - due));
+        }
+
+        handler(scheduleTable[index], due, now);
+        ran++;
+
+        // The handler may block for a while (polling): reschedule from the
+        // time it returned, so missed occurrences collapse into this run
+        time_t after = time(NULL);
+        dueTimes[index] = nextOccurrence(scheduleTable[index], after > now ? after : now);
+        siftDown(0);
+    }
+    return ran;
+}
+
+time_t schedulerNextDue() {
+    return heapBuilt && scheduleCount ? dueTimes[heap[0]] : 0;
+}
@@ -0,0 +1,39 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <time.h>
+
+#define MAX_SCHEDULE_ENTRIES 16
+#define ALL_NODES -1
+
+enum ScheduleKind {
+    SCHEDULE_DAILY,     // every day at hour:minute (local time)
+    SCHEDULE_INTERVAL   // every intervalSec seconds
+};
+
+struct ScheduleEntry {
+    ScheduleKind kind;
+    int nodeIndex;          // ALL_NODES or an index into NODE_ADDRESSES
+    uint8_t hour;           // SCHEDULE_DAILY
+    uint8_t minute;         // SCHEDULE_DAILY
+    uint32_t intervalSec;   // SCHEDULE_INTERVAL
+};
+
+// Called for every entry that is due; due is the planned time, now the actual one
+typedef void (*ScheduleHandler)(const ScheduleEntry& entry, time_t due, time_t now);
+
+// Register the schedule table. Due times are computed on the first tick,
+// once the caller has a valid wall clock.
+void schedulerInit(const ScheduleEntry* entries, int count);
+
+// Run every entry whose due time has passed. An entry that was missed
+// (loop blocked, several windows overdue) runs once as catch-up and is then
+// rescheduled to its next future occurrence. O(log n) per entry run, O(1)
+// when nothing is due. Returns the number of entries run.
+int schedulerTick(time_t now, ScheduleHandler handler);
+
+// Earliest due time, 0 before the first tick
+time_t schedulerNextDue();
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <Arduino.h>
+
+// Uplink transport for readings and metrics:
+//   0 = HTTP POST per payload (default)
+//   1 = MQTT, one persistent session, QoS1 readings (mqttUplink.h)
+#ifndef UPLINK_MQTT
+#define UPLINK_MQTT 0
+#endif
+
+enum UplinkChannel {
+    UPLINK_READING,   // sensor reading or RSSI, must not be lost
+    UPLINK_METRICS,   // periodic snapshot, best effort
+};
+
+// A transport takes an already encoded JSON payload (Gateway/payload.h);
+// the backend ingests the same bytes whichever transport carried them.
+class Uplink {
+public:
+    virtual ~Uplink() {}
+    virtual void begin() {}
+    // Called from loop(): acknowledgements, retries, keepalive
+    virtual void loop() {}
+    // source is the node_id of a reading or the gateway id of metrics.
+    // Returns false if the payload was dropped.
+    virtual bool publish(UplinkChannel channel, const char* source, const char* payload, size_t len) = 0;
+};
+
+// The transport selected by UPLINK_MQTT
+Uplink& uplink();
+
+#endif
@@ -1,5 +1,6 @@
 #include "FS300A.h"
 #include <EEPROM.h>
+#include "../Common/log.h"
 
 // Cấu hình EEPROM addresses
 #define WATER1_EEPROM_ADDR 0    // 4 bytes cho water1 total
@@ -19,6 +20,11 @@ float water2_temp = 0.0;        // Lượng nước tạm thời (từ lần g
 float water2_eeprom = 0.0;      // Chỉ số tích lũy từ EEPROM  
 float water2_total = 0.0;       // Tổng = EEPROM + temp
 
+// Phát hiện rò rỉ cho từng kênh, chạy trong sensorTask
+LeakDetector leakDetectors[2] = {LeakDetector(ML_PER_PULSE), LeakDetector(ML_PER_PULSE)};
+QueueHandle_t leakAlertQueue = NULL;
+TaskHandle_t sensorTaskHandle = NULL;
+
 // Hàm ngắt cho cảm biến 1
 void IRAM_ATTR pulseCounter1() {
     pulseCount1++;
@@ -45,6 +51,19 @@ void writeFloatToEEPROM(int address, float value) {
     EEPROM.commit();
 }
 
+// Đưa số xung của một giây vào bộ phát hiện, có cảnh báo thì đẩy vào queue
+static void checkLeak(uint8_t channel, unsigned long count) {
+    LeakAlert alert;
+    if (leakDetectors[channel].update(count, alert) == LEAK_NONE) return;
+
+    alert.channel = channel;
+    LOGW(TAG_SENSOR, "Leak alert water%d: kind %d, %.2f L/min for %lu s",
+         channel + 1, alert.kind, alert.litresPerMin, (unsigned long)alert.durationSec);
+    if (xQueueSend(leakAlertQueue, &alert, 0) != pdTRUE) {
+        LOGE(TAG_SENSOR, "Leak alert queue full, alert dropped");
+    }
+}
+
 // Tác vụ (Task) xử lý cảm biến
 void sensorTask(void *pvParameters) {
     while (1) {
@@ -57,13 +76,11 @@ void sensorTask(void *pvParameters) {
             
             // Cộng vào biến tạm
             water1_temp += (count1 * ML_PER_PULSE) / 1000.0;  // Chuyển ml sang lít
+            checkLeak(0, count1);
             
             lastTime1 = currentTime;
-            Serial.print("Water 1 temp: ");
-            Serial.print(water1_temp); 
-            Serial.print(" L, Total: ");
-            Serial.print(water1_eeprom + water1_temp);
-            Serial.println(" L");
+            LOGD(TAG_SENSOR, "Water 1 temp: %.2f L, Total: %.2f L",
+                 water1_temp, water1_eeprom + water1_temp);
         }
         
         // Xử lý cảm biến 2
@@ -73,13 +90,11 @@ void sensorTask(void *pvParameters) {
             
             // Cộng vào biến tạm
             water2_temp += (count2 * ML_PER_PULSE) / 1000.0;  // Chuyển ml sang lít
+            checkLeak(1, count2);
             
             lastTime2 = currentTime;
-            Serial.print("Water 2 temp: ");
-            Serial.print(water2_temp); 
-            Serial.print(" L, Total: ");
-            Serial.print(water2_eeprom + water2_temp);
-            Serial.println(" L");
+            LOGD(TAG_SENSOR, "Water 2 temp: %.2f L, Total: %.2f L",
+                 water2_temp, water2_eeprom + water2_temp);
         }
         
         vTaskDelay(10 / portTICK_PERIOD_MS);  // Giảm tải CPU
@@ -106,14 +121,16 @@ void FS300A_Init() {
     Serial.print(water2_eeprom);
     Serial.println(" L");
 
+    leakAlertQueue = xQueueCreate(4, sizeof(LeakAlert));
+
     // Khởi tạo thời gian
     lastTime1 = millis();
     lastTime2 = millis();
 }
 
 void FS300A_StartTask() {
-    // Tạo tác vụ cảm biến với stack size 2048 và mức ưu tiên 1
-    xTaskCreate(sensorTask, "SensorTask", 2048, NULL, 1, NULL);
+    // Tạo tác vụ cảm biến với mức ưu tiên 1
+    xTaskCreate(sensorTask, "SensorTask", SENSOR_TASK_STACK, NULL, 1, &sensorTaskHandle);
 }
 
 // Hàm cập nhật total values trước khi gửi
@@ -121,11 +138,13 @@ void updateWaterTotals() {
     water1_total = water1_eeprom + water1_temp;
     water2_total = water2_eeprom + water2_temp;
     
-    Serial.print("Updated totals - Water1: ");
-    Serial.print(water1_total);
-    Serial.print(" L, Water2: ");
-    Serial.print(water2_total);
-    Serial.println(" L");
+    LOGI(TAG_SENSOR, "Updated totals - Water1: %.2f L, Water2: %.2f L",
+         water1_total, water2_total);
+}
+
+void currentWaterTotals(float* out) {
+    out[0] = water1_eeprom + water1_temp;
+    out[1] = water2_eeprom + water2_temp;
 }
 
 // Hàm commit temp values vào EEPROM sau khi gửi thành công
@@ -138,15 +157,12 @@ void commitWaterValues() {
     writeFloatToEEPROM(WATER1_EEPROM_ADDR, water1_eeprom);
     writeFloatToEEPROM(WATER2_EEPROM_ADDR, water2_eeprom);
     
-    Serial.print("Committed to EEPROM - Water1: ");
-    Serial.print(water1_eeprom);
-    Serial.print(" L, Water2: ");
-    Serial.print(water2_eeprom);
-    Serial.println(" L");
+    LOGI(TAG_EEPROM, "Committed to EEPROM - Water1: %.2f L, Water2: %.2f L",
+         water1_eeprom, water2_eeprom);
     
     // Reset temp values
     water1_temp = 0.0;
     water2_temp = 0.0;
     
-    Serial.println("Reset temp values to 0");
+    LOGD(TAG_SENSOR, "Reset temp values to 0");
 }
\ No newline at end of file
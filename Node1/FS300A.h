@@ -2,6 +2,7 @@
 #define FS300A_H
 
 #include <Arduino.h>
+#include "leakDetector.h"
 
 // Định nghĩa chân cho hai cảm biến FS300A
 #define FS300A_PIN1 34  // Chân cho cảm biến 1
@@ -15,6 +16,13 @@ extern float water2_temp;      // Lượng nước tạm thời từ cảm biế
 extern float water1_total;     // Tổng lượng nước cảm biến 1 (EEPROM + temp)
 extern float water2_total;     // Tổng lượng nước cảm biến 2 (EEPROM + temp)
 
+// Cảnh báo rò rỉ do sensorTask phát hiện, main loop lấy ra và gửi ngay
+extern QueueHandle_t leakAlertQueue;
+
+// Stack của sensorTask (byte), chỉnh theo stack high-water mark trong gói diag
+#define SENSOR_TASK_STACK 2048
+extern TaskHandle_t sensorTaskHandle;
+
 // Hàm khởi tạo module cảm biến
 void FS300A_Init();
 
@@ -27,4 +35,8 @@ void updateWaterTotals();
 // Hàm commit temp values vào EEPROM sau khi gửi thành công
 void commitWaterValues();
 
+// Tổng lúc này (EEPROM + temp) của hai cảm biến, không đổi water*_total
+// đã chốt cho lần poll; dùng cho sổ lịch sử
+void currentWaterTotals(float* out);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef LEAK_DETECTOR_H
+#define LEAK_DETECTOR_H
+
+#include <stdint.h>
+
+// Ngưỡng phát hiện (số xung mỗi giây của FS300A, ML_PER_PULSE ml/xung)
+#define LEAK_GAP_TOLERANCE_S     10     // ngắt dòng ngắn hơn mức này vẫn tính là chảy liên tục
+#define LEAK_CONTINUOUS_S        1200   // chảy liên tục 20 phút -> cảnh báo
+#define LEAK_BASELINE_WINDOW_MIN 30     // cửa sổ tìm lưu lượng tối thiểu (kiểu night-flow)
+#define LEAK_BASELINE_MIN_PULSES 2      // phút "ít nhất" vẫn có >= 2 xung -> rò rỉ nhỏ
+#define LEAK_BURST_PULSES_PER_S  90     // ~30 L/phút
+#define LEAK_BURST_S             30     // duy trì 30 giây -> vỡ ống
+
+enum LeakKind : uint8_t {
+    LEAK_NONE = 0,
+    LEAK_CONTINUOUS = 1,    // không lúc nào ngừng chảy
+    LEAK_BASELINE = 2,      // lưu lượng tối thiểu không về 0 (rỉ nhỏ, ngắt quãng)
+    LEAK_BURST = 4,         // lưu lượng rất lớn kéo dài
+};
+
+struct LeakAlert {
+    uint8_t channel;
+    LeakKind kind;
+    float litresPerMin;
+    uint32_t durationSec;
+};
+
+// Bộ phát hiện rò rỉ dạng streaming, trạng thái O(1) cho mỗi kênh. Gọi
+// update() mỗi giây với số xung của giây đó. Mỗi loại cảnh báo chỉ phát một
+// lần cho mỗi đợt; đợt kết thúc khi có trọn một phút không có xung nào.
+class LeakDetector {
+public:
+    explicit LeakDetector(float mlPerPulse) : mlPerPulse_(mlPerPulse) {}
+
+    // Trả về loại cảnh báo mới phát sinh trong giây này (LEAK_NONE nếu không có)
+    LeakKind update(uint32_t pulses, LeakAlert& alert) {
+        LeakKind fired = LEAK_NONE;
+
+        // Lưu lượng tối thiểu theo phút trong cửa sổ: khi mọi người ngừng dùng
+        // nước (ban đêm) nó về 0, trừ khi có rò rỉ
+        minutePulses_ += pulses;
+        if (++minuteSec_ >= 60) {
+            if (minutePulses_ == 0) latched_ = 0;   // trọn một phút không chảy: hết đợt
+            if (minutePulses_ < windowMinPulses_) windowMinPulses_ = minutePulses_;
+            minutePulses_ = 0;
+            minuteSec_ = 0;
+
+            if (++windowMinutes_ >= LEAK_BASELINE_WINDOW_MIN) {
+                // Dòng chảy liên tục đã được cảnh báo thì không báo thêm lần nữa
+                if (windowMinPulses_ >= LEAK_BASELINE_MIN_PULSES && !(latched_ & LEAK_CONTINUOUS)) {
+                    fired = fire(LEAK_BASELINE, windowMinPulses_, 60, LEAK_BASELINE_WINDOW_MIN * 60, alert, fired);
+                }
+                windowMinutes_ = 0;
+                windowMinPulses_ = UINT32_MAX;
+            }
+        }
+
+        // Chảy liên tục, cho phép ngắt quãng ngắn
+        if (pulses) {
+            if (!runSec_) runPulses_ = 0;
+            runSec_ += gapSec_ + 1;
+            runPulses_ += pulses;
+            gapSec_ = 0;
+        } else if (runSec_ && ++gapSec_ > LEAK_GAP_TOLERANCE_S) {
+            runSec_ = 0;
+            gapSec_ = 0;
+        }
+        if (runSec_ >= LEAK_CONTINUOUS_S) {
+            fired = fire(LEAK_CONTINUOUS, runPulses_, runSec_, runSec_, alert, fired);
+        }
+
+        // Lưu lượng lớn kéo dài
+        if (pulses >= LEAK_BURST_PULSES_PER_S) {
+            burstSec_++;
+            burstPulses_ += pulses;
+            if (burstSec_ >= LEAK_BURST_S) {
+                fired = fire(LEAK_BURST, burstPulses_, burstSec_, burstSec_, alert, fired);
+            }
+        } else {
+            burstSec_ = 0;
+            burstPulses_ = 0;
+        }
+        return fired;
+    }
+
+private:
+    float mlPerPulse_;
+    uint32_t runSec_ = 0;
+    uint32_t runPulses_ = 0;
+    uint32_t gapSec_ = 0;
+    uint32_t burstSec_ = 0;
+    uint32_t burstPulses_ = 0;
+    uint32_t minuteSec_ = 0;
+    uint32_t minutePulses_ = 0;
+    uint32_t windowMinutes_ = 0;
+    uint32_t windowMinPulses_ = UINT32_MAX;
+    uint8_t latched_ = 0;       // các loại đã cảnh báo trong đợt hiện tại
+
+    // Chỉ ghi alert nếu loại này chưa cảnh báo trong đợt và giây này chưa có
+    // cảnh báo khác (loại bị hoãn sẽ phát ở giây sau). pulses đếm trong rateSec giây.
+    LeakKind fire(LeakKind kind, uint32_t pulses, uint32_t rateSec, uint32_t durationSec,
+                  LeakAlert& alert, LeakKind already) {
+        if ((latched_ & kind) || already != LEAK_NONE) return already;
+        latched_ |= kind;
+        alert.kind = kind;
+        alert.litresPerMin = pulses * mlPerPulse_ / 1000.0f * 60.0f / rateSec;
+        alert.durationSec = durationSec;
+        return kind;
+    }
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "powerQuality.h"
+#include <PZEM004Tv30.h>
+#include "../Common/base64.h"
+#include "../Common/log.h"
+
+// Chân chọn kênh MUX
+#define S3 32
+#define S2 33
+#define S1 25
+#define S0 26
+
+static const uint8_t MUX_CHANNELS[PQ_CHANNELS] = {0, 1};  // MUX channel 0 và 1
+
+// Khung giờ biểu giá điện (EVN), phút trong ngày theo giờ địa phương: cao
+// điểm 9:30-11:30 và 17:00-20:00 trừ Chủ nhật, thấp điểm 22:00-4:00, còn
+// lại bình thường. Các biên đều là bội của 15 phút nên mỗi khoảng thuộc
+// trọn một khung.
+struct PqTariffWindow {
+    uint16_t fromMin;
+    uint16_t toMin;
+    PqTariff tariff;
+    bool exceptSunday;
+};
+
+static const PqTariffWindow TARIFF_WINDOWS[] = {
+    {0, 4 * 60, PQ_TARIFF_OFFPEAK, false},
+    {22 * 60, 24 * 60, PQ_TARIFF_OFFPEAK, false},
+    {9 * 60 + 30, 11 * 60 + 30, PQ_TARIFF_PEAK, true},
+    {17 * 60, 20 * 60, PQ_TARIFF_PEAK, true},
+};
+
+// Khoảng đang gom của một kênh
+struct PqOpen {
+    uint32_t index;         // epoch / PQ_INTERVAL_S, 0 = chưa mở
+    uint16_t samples;
+    float vSum, vMin, vMax;
+    float pSum, pMax;
+    float wh;
+};
+
+// Ring theo chỉ số tuyệt đối: phần tử i nằm ở items[i % PQ_RING_SIZE],
+// còn lại các chỉ số [head, tail)
+struct PqRing {
+    PqInterval items[PQ_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+};
+
+static PZEM004Tv30 pzem(Serial2, 16, 17);
+TaskHandle_t pqTaskHandle = NULL;
+static const NodeClock* pqClock = NULL;
+static portMUX_TYPE pqLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Dùng chung giữa task đo và main loop, truy cập dưới pqLock
+static float tempEnergy[PQ_CHANNELS];       // kWh chưa lưu EEPROM
+static float lastVoltage[PQ_CHANNELS];
+static uint32_t lastEpoch[PQ_CHANNELS];
+static bool resetRequested[PQ_CHANNELS];
+static PqRing rings[PQ_CHANNELS];
+
+// Chỉ task đo dùng
+static float lastReading[PQ_CHANNELS];      // chỉ số kWh của PZEM lần đọc trước
+static bool primed[PQ_CHANNELS];            // đã có lần đọc đầu tiên sau khi khởi động
+static PqOpen openIntervals[PQ_CHANNELS];
+
+// Lô đã gửi đang chờ ack, chỉ main loop dùng
+static int batchChannel = -1;
+static uint32_t batchEnd = 0;
+
+static void selectMuxChannel(uint8_t channel) {
+    digitalWrite(S0, bitRead(channel, 0));
+    digitalWrite(S1, bitRead(channel, 1));
+    digitalWrite(S2, bitRead(channel, 2));
+    digitalWrite(S3, bitRead(channel, 3));
+    delay(200); // Đợi MUX ổn định
+}
+
+static PqTariff pqTariff(uint32_t epoch) {
+    uint32_t local = epoch + PQ_UTC_OFFSET_S;
+    uint16_t minute = (local % 86400) / 60;
+    uint8_t weekday = (local / 86400 + 4) % 7;  // 1/1/1970 là thứ Năm, 0 = Chủ nhật
+    for (size_t i = 0; i < sizeof(TARIFF_WINDOWS) / sizeof(TARIFF_WINDOWS[0]); i++) {
+        const PqTariffWindow& w = TARIFF_WINDOWS[i];
+        if (minute < w.fromMin || minute >= w.toMin) continue;
+        if (w.exceptSunday && weekday == 0) continue;
+        return w.tariff;
+    }
+    return PQ_TARIFF_NORMAL;
+}
+
+static uint16_t toU16(float x) {
+    if (!(x > 0)) return 0;
+    return x >= 65535.0f ? 65535 : (uint16_t)(x + 0.5f);
+}
+
+static void closeInterval(int ch) {
+    const PqOpen& o = openIntervals[ch];
+    PqInterval r;
+    r.start = o.index * PQ_INTERVAL_S;
+    r.vMean = toU16(o.vSum / o.samples * 10);
+    r.vMin = toU16(o.vMin * 10);
+    r.vMax = toU16(o.vMax * 10);
+    r.pMean = toU16(o.pSum / o.samples);
+    r.pPeak = toU16(o.pMax);
+    uint16_t wh = toU16(o.wh);
+    r.whTariff = (wh > 0x3FFF ? 0x3FFF : wh) | (uint16_t)(pqTariff(r.start) << 14);
+
+    portENTER_CRITICAL(&pqLock);
+    PqRing& ring = rings[ch];
+    ring.items[ring.tail % PQ_RING_SIZE] = r;
+    ring.tail++;
+    if (ring.tail - ring.head > PQ_RING_SIZE) ring.head = ring.tail - PQ_RING_SIZE;   // đè khoảng cũ nhất
+    portEXIT_CRITICAL(&pqLock);
+
+    LOGD(TAG_SENSOR, "PQ ch%d %lu: V %u/%u/%u dV, P %u/%u W, %u Wh", ch + 1, (unsigned long)r.start,
+         r.vMin, r.vMean, r.vMax, r.pMean, r.pPeak, wh);
+}
+
+// Đọc PZEM của một kênh, cộng điện năng vào biến tạm và gom vào khoảng hiện tại
+static void sampleChannel(int ch) {
+    selectMuxChannel(MUX_CHANNELS[ch]);
+    float energy = pzem.energy();
+    float voltage = pzem.voltage();
+    float power = pzem.power();
+    uint32_t epoch = pqClock ? pqClock->now() : 0;
+
+    portENTER_CRITICAL(&pqLock);
+    bool reset = resetRequested[ch];
+    portEXIT_CRITICAL(&pqLock);
+
+    // Không reset PZEM mỗi lần đọc (độ phân giải 1 Wh, reset sẽ mất phần lẻ):
+    // lấy hiệu so với lần đọc trước, chỉ reset sau khi đã lưu EEPROM
+    float delta = 0;
+    bool counted = false;
+    bool resetDone = false;
+    if (!isnan(energy)) {
+        delta = energy >= lastReading[ch] ? energy - lastReading[ch] : energy;
+        counted = primed[ch];   // lần đọc đầu gồm cả lúc node tắt, không tính vào khoảng
+        primed[ch] = true;
+        lastReading[ch] = energy;
+        // Reset lỗi thì giữ lastReading, lần đọc sau vẫn lấy hiệu đúng và
+        // thử reset lại
+        if (reset && pzem.resetEnergy()) {
+            lastReading[ch] = 0;
+            resetDone = true;
+        } else if (reset) {
+            LOGW(TAG_SENSOR, "PZEM %d energy reset failed, retried next read", ch + 1);
+        }
+    }
+
+    portENTER_CRITICAL(&pqLock);
+    tempEnergy[ch] += delta;
+    lastVoltage[ch] = isnan(voltage) ? 0.0f : voltage;
+    lastEpoch[ch] = epoch;
+    if (resetDone) resetRequested[ch] = false;
+    portEXIT_CRITICAL(&pqLock);
+
+    if (!epoch) return;
+    PqOpen& o = openIntervals[ch];
+    uint32_t index = epoch / PQ_INTERVAL_S;
+    if (o.index != index) {
+        if (o.index && o.samples) closeInterval(ch);
+        memset(&o, 0, sizeof(o));
+        o.index = index;
+    }
+    if (counted) o.wh += delta * 1000;
+    if (isnan(voltage) || isnan(power)) return;
+
+    o.vMin = o.samples ? fminf(o.vMin, voltage) : voltage;
+    o.vMax = o.samples ? fmaxf(o.vMax, voltage) : voltage;
+    o.pMax = o.samples ? fmaxf(o.pMax, power) : power;
+    o.vSum += voltage;
+    o.pSum += power;
+    o.samples++;
+}
+
+static void pqTask(void* parameter) {
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;) {
+        for (int ch = 0; ch < PQ_CHANNELS; ch++) sampleChannel(ch);
+        vTaskDelayUntil(&lastWake, PQ_SAMPLE_MS / portTICK_PERIOD_MS);
+    }
+}
+
+void PQ_Init(const NodeClock* clock) {
+    pinMode(S0, OUTPUT);
+    pinMode(S1, OUTPUT);
+    pinMode(S2, OUTPUT);
+    pinMode(S3, OUTPUT);
+    pqClock = clock;
+}
+
+void PQ_StartTask() {
+    xTaskCreate(pqTask, "PqTask", PQ_TASK_STACK, NULL, 1, &pqTaskHandle);
+}
+
+void pqSnapshot(PqSnapshot& out) {
+    portENTER_CRITICAL(&pqLock);
+    for (int ch = 0; ch < PQ_CHANNELS; ch++) {
+        out.energy[ch] = tempEnergy[ch];
+        out.voltage[ch] = lastVoltage[ch];
+        out.epoch[ch] = lastEpoch[ch];
+    }
+    portEXIT_CRITICAL(&pqLock);
+}
+
+void pqConsumeEnergy(const float* kwh) {
+    portENTER_CRITICAL(&pqLock);
+    for (int ch = 0; ch < PQ_CHANNELS; ch++) {
+        tempEnergy[ch] = tempEnergy[ch] > kwh[ch] ? tempEnergy[ch] - kwh[ch] : 0.0f;
+        resetRequested[ch] = true;
+    }
+    portEXIT_CRITICAL(&pqLock);
+}
+
+static uint8_t* put16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+bool pqBatchPending() {
+    bool pending = false;
+    portENTER_CRITICAL(&pqLock);
+    for (int ch = 0; ch < PQ_CHANNELS; ch++) pending |= rings[ch].tail != rings[ch].head;
+    portEXIT_CRITICAL(&pqLock);
+    return pending;
+}
+
+int pqFormatBatch(char* out, size_t cap, const char* const* sensorIds) {
+    PqInterval batch[PQ_BATCH_RECORDS];
+    uint8_t count = 0;
+    int channel = -1;
+
+    // Kênh có khoảng cũ nhất đi trước; lấy các khoảng liên tiếp của kênh đó
+    portENTER_CRITICAL(&pqLock);
+    for (int ch = 0; ch < PQ_CHANNELS; ch++) {
+        const PqRing& ring = rings[ch];
+        if (ring.tail == ring.head) continue;
+        if (channel < 0 ||
+            ring.items[ring.head % PQ_RING_SIZE].start <
+                rings[channel].items[rings[channel].head % PQ_RING_SIZE].start) {
+            channel = ch;
+        }
+    }
+    if (channel >= 0) {
+        const PqRing& ring = rings[channel];
+        for (uint32_t i = ring.head; i != ring.tail && count < PQ_BATCH_RECORDS; i++) {
+            const PqInterval& r = ring.items[i % PQ_RING_SIZE];
+            if (count && r.start != batch[count - 1].start + PQ_INTERVAL_S) break;
+            batch[count++] = r;
+        }
+        batchEnd = ring.head + count;
+    }
+    portEXIT_CRITICAL(&pqLock);
+
+    batchChannel = channel;
+    if (channel < 0) return 0;
+
+    uint8_t bytes[PQ_BATCH_RECORDS * 12];
+    uint8_t* p = bytes;
+    for (uint8_t i = 0; i < count; i++) {
+        p = put16(p, batch[i].vMean);
+        p = put16(p, batch[i].vMin);
+        p = put16(p, batch[i].vMax);
+        p = put16(p, batch[i].pMean);
+        p = put16(p, batch[i].pPeak);
+        p = put16(p, batch[i].whTariff);
+    }
+    char encoded[PQ_BATCH_RECORDS * 16 + 1];
+    base64Encode(bytes, p - bytes, encoded);
+    return snprintf(out, cap, "\"pq\":\"%s\",\"iv\":%d,\"t\":%lu,\"b\":\"%s\"", sensorIds[channel],
+                    PQ_INTERVAL_S, (unsigned long)batch[0].start, encoded);
+}
+
+void pqBatchSent() {
+    if (batchChannel < 0) return;
+    portENTER_CRITICAL(&pqLock);
+    PqRing& ring = rings[batchChannel];
+    // Ring có thể đã đè qua lô này trong lúc chờ ack
+    if ((int32_t)(batchEnd - ring.head) > 0) ring.head = batchEnd;
+    portEXIT_CRITICAL(&pqLock);
+    batchChannel = -1;
+}
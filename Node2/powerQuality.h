@@ -0,0 +1,69 @@
+#ifndef POWER_QUALITY_H
+#define POWER_QUALITY_H
+
+#include <Arduino.h>
+#include "../Common/nodeClock.h"
+
+// Đo nền chất lượng điện và phụ tải: một task đọc PZEM của từng kênh (qua
+// MUX) mỗi PQ_SAMPLE_MS, cộng điện năng vào biến tạm và gom thành các khoảng
+// PQ_INTERVAL_S: điện áp min/max/trung bình, công suất đỉnh/trung bình, điện
+// năng của khoảng, kèm khung giờ biểu giá. Các khoảng đã đóng nằm trong một
+// ring cố định mỗi kênh, được gửi theo lô trong lần poll (xem pqFormatBatch).
+//
+// Khoảng chỉ được gom khi đồng hồ node đã đồng bộ với Gateway (biên khoảng
+// căn theo epoch); trước đó điện năng vẫn được cộng bình thường.
+#define PQ_CHANNELS 2
+#define PQ_SAMPLE_MS 10000          // mỗi vòng đọc cả hai kênh, ~0.6 s cho MUX và Modbus
+#define PQ_INTERVAL_S 900           // 15 phút, khớp khung giờ biểu giá
+#define PQ_RING_SIZE 96             // khoảng mỗi kênh, 24 giờ ở 15 phút
+#define PQ_BATCH_RECORDS 3          // khoảng liên tiếp mỗi frame, vừa FRAME_PAYLOAD_MAX
+#define PQ_TASK_STACK 3072
+#define PQ_UTC_OFFSET_S (7 * 3600)  // giờ địa phương cho khung biểu giá
+
+enum PqTariff : uint8_t {
+    PQ_TARIFF_NORMAL = 0,
+    PQ_TARIFF_PEAK = 1,
+    PQ_TARIFF_OFFPEAK = 2,
+};
+
+// Một khoảng đã đóng, 16 byte
+struct PqInterval {
+    uint32_t start;         // epoch đầu khoảng
+    uint16_t vMean;         // 0.1 V
+    uint16_t vMin;
+    uint16_t vMax;
+    uint16_t pMean;         // W
+    uint16_t pPeak;
+    uint16_t whTariff;      // bit 0-13 Wh của khoảng, bit 14-15 PqTariff
+};
+
+// Số liệu cho một lần poll, chụp dưới khóa
+struct PqSnapshot {
+    float energy[PQ_CHANNELS];      // kWh cộng thêm từ lần commit trước
+    float voltage[PQ_CHANNELS];     // lần đọc gần nhất, 0 nếu lỗi
+    uint32_t epoch[PQ_CHANNELS];    // thời điểm đọc, 0 nếu chưa đồng bộ
+};
+
+extern TaskHandle_t pqTaskHandle;
+
+// Khởi tạo MUX; clock là đồng hồ của NodeRuntime, chỉ được đọc từ task đo
+void PQ_Init(const NodeClock* clock);
+
+// Tạo task đo nền
+void PQ_StartTask();
+
+void pqSnapshot(PqSnapshot& out);
+
+// Trừ phần điện năng đã lưu EEPROM khỏi biến tạm và reset bộ đếm PZEM ở
+// vòng đo kế tiếp, để node khởi động lại không cộng lại phần đã lưu
+void pqConsumeEnergy(const float* kwh);
+
+// Upload theo lô: frame gồm tối đa PQ_BATCH_RECORDS khoảng liên tiếp của
+// một kênh, bản ghi 12 byte little-endian (PqInterval bỏ start) mã hóa base64:
+//   "pq":"power1","iv":900,"t":<start khoảng đầu>,"b":"<base64>"
+// Khoảng chỉ được bỏ khỏi ring khi Gateway đã ack (pqBatchSent).
+bool pqBatchPending();
+int pqFormatBatch(char* out, size_t cap, const char* const* sensorIds);
+void pqBatchSent();
+
+#endif
@@ -0,0 +1,539 @@
+// Microbenchmarks of the firmware hot paths, built on the host.
+//
+// Runs the firmware's own code against host stand-ins for the Arduino core
+// and the LoRa radio (tools/bench/host): a full node poll exchange through
+// NodeRuntime (command parsing, sampling, report filter, frame building,
+// LBT send), the FS300A per-second accumulation and leak detection, one log
+// line with LOG_DEFERRED on and off, the Gateway payload formatters of
+// dataPush.cpp and, when ArduinoJson is on the include path, the Gateway's
+// node frame parsing (Gateway/nodeFrame.h). Each benchmark reports CPU
+// ns/op, heap allocations and bytes per op (glibc malloc interposition),
+// and the encoded size of what it builds.
+//
+// Build (Linux host, Google Benchmark installed):
+//   g++ -O2 -std=c++17 -I tools/bench/host tools/bench/bench.cpp -lbenchmark -lpthread -o bench
+// Add -I <ArduinoJson>/src (the library the Gateway builds with, v7) to
+// include the parsing benchmarks; sh tools/bench/fetchArduinoJson.sh puts
+// the single-header release in tools/bench/third_party for
+// -I tools/bench/third_party.
+//
+// Run, write a new baseline, or compare against the tracked one:
+//   ./bench
+//   ./bench --out tools/bench/baseline.json
+//   ./bench --compare tools/bench/baseline.json [--threshold 25]
+//
+// --out and --compare run every benchmark BENCH_REPETITIONS (5) times and
+// use the median, a single run is too noisy to compare (swings of 20-30%
+// on unchanged code). --compare flags a benchmark as a regression when its
+// median time grows by more than --threshold percent (default 25, raise it
+// on a shared or virtualized host), or when its allocations or encoded size
+// grow at all, and exits with status 1.
+// Benchmarks absent from the baseline are listed as new. Times only compare
+// on the same machine and compiler; the baseline records the compiler it
+// was taken with. Google Benchmark flags pass through, an explicit
+// --benchmark_repetitions=N replaces the default.
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../Common/nodeRuntime.h"
+#include "../../Gateway/payload.h"
+#include "../../Node1/FS300A.h"
+#include "host/heapCount.h"
+
+#if __has_include(<ArduinoJson.h>)
+#include "../../Common/jsonArena.h"
+#include "../../Gateway/nodeFrame.h"
+#define BENCH_ARDUINOJSON 1
+#else
+#define BENCH_ARDUINOJSON 0
+#endif
+
+// ---------------------------------------------------------------------------
+// Heap accounting (host/heapCount.h)
+
+// Heap use over a benchmark loop, reported per iteration
+struct HeapProbe {
+    uint64_t count = allocCount;
+    uint64_t bytes = allocBytes;
+
+    void report(benchmark::State& state) const {
+        state.counters["allocs"] = benchmark::Counter((double)(allocCount - count), benchmark::Counter::kAvgIterations);
+        state.counters["alloc_bytes"] =
+            benchmark::Counter((double)(allocBytes - bytes), benchmark::Counter::kAvgIterations);
+    }
+};
+
+static void reportEncoded(benchmark::State& state, uint64_t bytes) {
+    state.counters["encoded"] = benchmark::Counter((double)bytes, benchmark::Counter::kAvgIterations);
+}
+
+// ---------------------------------------------------------------------------
+// Node side: sensor policies with the field formats of Node1/Node2 main.cpp
+// and values that swing past the deadband on every poll, so each poll sends
+// every channel in frames of constant size
+
+static const uint32_t BENCH_EPOCH = 1760000000;
+
+struct BenchWater {
+    typedef LeakAlert Alert;
+    static const int CHANNELS = 2;
+    float totals[CHANNELS] = {1234.5f, 87.25f};
+    uint32_t sampleEpoch = 0;
+    float step = 1.5f;
+
+    void begin() {}
+    const char* id(int ch) const { return ch == 0 ? "water1" : "water2"; }
+    Deadband deadband(int) const { return {1.0f, 0.0f, 6 * 3600UL}; }
+    void sample(const NodeClock& clock) {
+        for (float& t : totals) t += step;
+        step = -step;
+        sampleEpoch = clock.now();
+    }
+    float value(int ch) const { return totals[ch]; }
+    uint32_t epoch(int) const { return sampleEpoch; }
+    int formatFields(char* out, size_t cap, int ch) const {
+        return snprintf(out, cap, "\"Water\":%.3f", value(ch));
+    }
+    void commit() {}
+    bool takeAlert(Alert&) { return false; }
+    int formatAlert(char*, size_t, const Alert&) const { return 0; }
+    bool batchPending() const { return false; }
+    int formatBatch(char*, size_t) { return 0; }
+    void batchSent() {}
+    void historyValues(float* out) const { memcpy(out, totals, sizeof(totals)); }
+};
+
+struct BenchEnergy {
+    struct Alert {};
+    static const int CHANNELS = 2;
+    float energy[CHANNELS] = {512.125f, 33.5f};
+    float voltage[CHANNELS] = {229.4f, 231.0f};
+    float step = 0.02f;
+
+    void begin() {}
+    const char* id(int ch) const { return ch == 0 ? "power1" : "power2"; }
+    Deadband deadband(int) const { return {0.01f, 0.0f, 6 * 3600UL}; }
+    void sample(const NodeClock&) {
+        for (float& e : energy) e += step;
+        step = -step;
+    }
+    float value(int ch) const { return energy[ch]; }
+    uint32_t epoch(int) const { return BENCH_EPOCH; }
+    int formatFields(char* out, size_t cap, int ch) const {
+        return snprintf(out, cap, "\"Power\":%.3f,\"Voltage\":%.1f", energy[ch], voltage[ch]);
+    }
+    void commit() {}
+    bool takeAlert(Alert&) { return false; }
+    int formatAlert(char*, size_t, const Alert&) const { return 0; }
+    bool batchPending() const { return false; }
+    int formatBatch(char*, size_t) { return 0; }
+    void batchSent() {}
+    void historyValues(float* out) const { memcpy(out, energy, sizeof(energy)); }
+};
+
+static bool lastTxIs(const char* literal) {
+    size_t n = strlen(literal);
+    return LoRa.txLen == n + 2 && memcmp(LoRa.tx + 2, literal, n) == 0;
+}
+
+// One poll as the Gateway runs it: getData<N> with the time, then ok<N>
+// after every data frame until the node sends "end" (or "nc")
+template <int Address, class Sensor>
+static void runPoll(NodeRuntime<Address, Sensor>& node, const char* getData, const char* ok) {
+    LoRa.inject(Address, GATEWAY_ADDR_FIRST, getData);
+    node.loop();
+    for (int frames = 0; frames < 8 && !lastTxIs("end") && !lastTxIs(REPORT_NO_CHANGE); frames++) {
+        LoRa.inject(Address, GATEWAY_ADDR_FIRST, ok);
+        node.loop();
+    }
+}
+
+template <int Address, class Sensor>
+static void benchNodePoll(benchmark::State& state) {
+    char getData[64];
+    snprintf(getData, sizeof(getData), "{\"command\":\"getData%d\",\"nodeId\":%d,\"time\":%lu}", Address, Address,
+             (unsigned long)BENCH_EPOCH);
+    char ok[8];
+    snprintf(ok, sizeof(ok), "ok%d", Address);
+
+    // The frames carry a growing seq, so the encoded size is that of the
+    // first poll after boot rather than an average that drifts with the
+    // iteration count
+    static NodeRuntime<Address, Sensor> node;
+    static uint64_t pollBytes = 0;
+    if (!pollBytes) {
+        node.begin();
+        uint64_t before = LoRa.txBytes;
+        runPoll(node, getData, ok);
+        pollBytes = LoRa.txBytes - before;
+    }
+
+    uint32_t packets = LoRa.txPackets;
+    HeapProbe heap;
+    for (auto _ : state) runPoll(node, getData, ok);
+    heap.report(state);
+    state.counters["encoded"] = (double)pollBytes;
+    state.counters["frames"] = benchmark::Counter((double)(LoRa.txPackets - packets), benchmark::Counter::kAvgIterations);
+}
+
+// Node1: two water channels per poll, the replaced createSensorPacket/readSensorData path
+static void BM_NodePollWater(benchmark::State& state) { benchNodePoll<1, BenchWater>(state); }
+BENCHMARK(BM_NodePollWater);
+
+// Node2: two energy channels per poll
+static void BM_NodePollEnergy(benchmark::State& state) { benchNodePoll<2, BenchEnergy>(state); }
+BENCHMARK(BM_NodePollEnergy);
+
+// Command dispatch of NodeRuntime: token hash and "time" field
+static void BM_NodeCommandParse(benchmark::State& state) {
+    static const char command[] = "{\"command\":\"getData2\",\"nodeId\":2,\"time\":1760000000}";
+    MsgView message = {command, sizeof(command) - 1};
+    HeapProbe heap;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cmdHashOf(commandToken(message)));
+        benchmark::DoNotOptimize(commandUintField(message, "\"time\":"));
+    }
+    heap.report(state);
+}
+BENCHMARK(BM_NodeCommandParse);
+
+// FS300A sensorTask, once per second and channel: pulses into litres, then
+// the leak detector. The trace is an hour of taps, a shower and idle time.
+static void BM_WaterAccumulate(benchmark::State& state) {
+    std::vector<uint32_t> trace(3600);
+    for (size_t s = 0; s < trace.size(); s++) {
+        trace[s] = s % 600 < 45 ? 40 + s % 7 : (s >= 1800 && s < 2400) ? 25 : 0;
+    }
+    LeakDetector detector(ML_PER_PULSE);
+    float temp = 0;
+    size_t i = 0;
+    HeapProbe heap;
+    for (auto _ : state) {
+        uint32_t count = trace[i];
+        i = i + 1 < trace.size() ? i + 1 : 0;
+        temp += (count * ML_PER_PULSE) / 1000.0;
+        LeakAlert alert;
+        benchmark::DoNotOptimize(detector.update(count, alert));
+        benchmark::DoNotOptimize(temp);
+    }
+    heap.report(state);
+}
+BENCHMARK(BM_WaterAccumulate);
+
+// ---------------------------------------------------------------------------
+// Logging (Common/log.h): what one hot-path log line costs the calling task.
+// LOG_DEFERRED=1 formats the line and copies it into the ring, logTask()
+// writes it out later; LOG_DEFERRED=0 formats it and writes it to Serial,
+// where the caller then waits on the UART. The host Serial discards output,
+// so that wait is reported as uart_us, the line's time on the wire at
+// 115200 baud (10 bits per byte).
+
+static const char BENCH_LOG_FRAME[] = "{\"nodeId\":1,\"sensorId\":\"water1\",\"Water\":1234.567,\"seq\":42,\"ts\":1760000000}";
+
+static size_t benchLogLine(char* line, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    size_t n = logFormat(line, 'D', TAG_LORA, fmt, args);
+    va_end(args);
+    return n;
+}
+
+template <bool Deferred>
+static void benchLog(benchmark::State& state) {
+    LogRing& ring = logRing();
+    char line[LOG_LINE_MAX];
+    uint64_t bytes = 0;
+    HeapProbe heap;
+    for (auto _ : state) {
+        size_t n = benchLogLine(line, "Sending to %d: %.*s", GATEWAY_ADDR_FIRST, (int)sizeof(BENCH_LOG_FRAME) - 1,
+                                BENCH_LOG_FRAME);
+        if (Deferred) {
+            logPush(line, n);
+            ring.tail = ring.head;  // logTask() keeps up
+        } else {
+            Serial.write((const uint8_t*)line, n);
+        }
+        bytes += n;
+    }
+    heap.report(state);
+    reportEncoded(state, bytes);
+    state.counters["uart_us"] =
+        benchmark::Counter(Deferred ? 0.0 : bytes * 10 * 1e6 / 115200, benchmark::Counter::kAvgIterations);
+}
+
+static void BM_LogDeferred(benchmark::State& state) { benchLog<true>(state); }
+BENCHMARK(BM_LogDeferred);
+
+static void BM_LogDirect(benchmark::State& state) { benchLog<false>(state); }
+BENCHMARK(BM_LogDirect);
+
+// ---------------------------------------------------------------------------
+// Gateway side: payloads of dataPush.cpp, same buffer size
+
+static const PayloadLink BENCH_LINK = {"gw_10", -92, 4711};
+
+template <class Format>
+static void benchPayload(benchmark::State& state, Format format) {
+    char buf[192];
+    uint64_t bytes = 0;
+    HeapProbe heap;
+    for (auto _ : state) {
+        bytes += format(buf, sizeof(buf));
+        benchmark::DoNotOptimize(buf);
+    }
+    heap.report(state);
+    reportEncoded(state, bytes);
+}
+
+static void BM_PayloadWater(benchmark::State& state) {
+    benchPayload(state, [](char* buf, size_t cap) {
+        return formatPayloadW(buf, cap, "node_1", "water1", 1234.567f, BENCH_EPOCH, &BENCH_LINK);
+    });
+}
+BENCHMARK(BM_PayloadWater);
+
+static void BM_PayloadEnergy(benchmark::State& state) {
+    benchPayload(state, [](char* buf, size_t cap) {
+        return formatPayloadE(buf, cap, "node_2", "power1", 512.125f, 229.4f, BENCH_EPOCH, &BENCH_LINK);
+    });
+}
+BENCHMARK(BM_PayloadEnergy);
+
+static void BM_PayloadRssi(benchmark::State& state) {
+    benchPayload(state, [](char* buf, size_t cap) { return formatPayloadRssi(buf, cap, "node_1", -87, &BENCH_LINK); });
+}
+BENCHMARK(BM_PayloadRssi);
+
+static void BM_PayloadAlert(benchmark::State& state) {
+    benchPayload(state, [](char* buf, size_t cap) {
+        return formatPayloadAlert(buf, cap, "node_1", "water2", "continuous", 2.75f, 1260, BENCH_EPOCH, &BENCH_LINK);
+    });
+}
+BENCHMARK(BM_PayloadAlert);
+
+static void BM_PayloadPq(benchmark::State& state) {
+    benchPayload(state, [](char* buf, size_t cap) {
+        return formatPayloadPq(buf, cap, "node_2", "power1", "+Qj2CPwJRwCYAFUAh0A4CPsIPQlAAFIAd0BEDPMIcAlYAGoAdEA=",
+                               BENCH_EPOCH, 900, &BENCH_LINK);
+    });
+}
+BENCHMARK(BM_PayloadPq);
+
+// ---------------------------------------------------------------------------
+// Gateway side: node frame parsing of processNodeData()/processRSSIData()
+
+#if BENCH_ARDUINOJSON
+static JsonArena<> benchArena;
+
+static void benchParse(benchmark::State& state, const char* frame, bool rssi) {
+    MsgView data = {frame, strlen(frame)};
+    HeapProbe heap;
+    for (auto _ : state) {
+        JsonDocument doc(&benchArena);
+        if (rssi) {
+            NodeRssi reply;
+            benchmark::DoNotOptimize(parseNodeRssi(doc, data, reply));
+        } else {
+            NodeReading reading;
+            benchmark::DoNotOptimize(parseNodeReading(doc, data, reading));
+        }
+    }
+    heap.report(state);
+}
+
+static void BM_GatewayParseWater(benchmark::State& state) {
+    benchParse(state, "{\"nodeId\":1,\"sensorId\":\"water1\",\"Water\":1234.567,\"seq\":42,\"ts\":1760000000}", false);
+}
+BENCHMARK(BM_GatewayParseWater);
+
+static void BM_GatewayParseEnergy(benchmark::State& state) {
+    benchParse(state, "{\"nodeId\":2,\"sensorId\":\"power1\",\"Power\":512.125,\"Voltage\":229.4,\"seq\":43,"
+                      "\"ts\":1760000000}", false);
+}
+BENCHMARK(BM_GatewayParseEnergy);
+
+static void BM_GatewayParseRssi(benchmark::State& state) {
+    benchParse(state, "{\"nodeId\":1,\"status\":\"online\",\"rssi\":-87}", true);
+}
+BENCHMARK(BM_GatewayParseRssi);
+#endif
+
+// ---------------------------------------------------------------------------
+// Baseline file and comparison
+
+struct Result {
+    double nsPerOp;
+    double allocs;
+    double allocBytes;
+    double encoded;
+};
+
+static double counterOr0(const benchmark::BenchmarkReporter::Run& run, const char* name) {
+    auto it = run.counters.find(name);
+    return it == run.counters.end() ? 0 : it->second.value;
+}
+
+// Console output as usual, plus the results kept for --out/--compare. With
+// --benchmark_repetitions the median replaces the single runs.
+class CollectingReporter : public benchmark::ConsoleReporter {
+public:
+    std::vector<std::pair<std::string, Result>> results;
+
+    void ReportRuns(const std::vector<Run>& runs) override {
+        for (const Run& run : runs) {
+            if (run.error_occurred) continue;
+            bool median = run.run_type == Run::RT_Aggregate && run.aggregate_name == "median";
+            if (run.run_type != Run::RT_Iteration && !median) continue;
+            Result r = {run.GetAdjustedCPUTime() * 1e9 / benchmark::GetTimeUnitMultiplier(run.time_unit),
+                        counterOr0(run, "allocs"), counterOr0(run, "alloc_bytes"), counterOr0(run, "encoded")};
+            std::string name = run.run_name.str();
+            auto it = results.begin();
+            while (it != results.end() && it->first != name) ++it;
+            if (it == results.end()) {
+                results.emplace_back(name, r);
+            } else if (median) {
+                it->second = r;
+            }
+        }
+        ConsoleReporter::ReportRuns(runs);
+    }
+};
+
+static bool writeBaseline(const char* path, const std::vector<std::pair<std::string, Result>>& results) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"compiler\": \"%s\",\n  \"benchmarks\": [\n", __VERSION__);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i].second;
+        fprintf(f,
+                "    {\"name\": \"%s\", \"ns_per_op\": %.2f, \"allocs_per_op\": %.2f, \"alloc_bytes_per_op\": %.2f, "
+                "\"encoded_bytes\": %.2f}%s\n",
+                results[i].first.c_str(), r.nsPerOp, r.allocs, r.allocBytes, r.encoded,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+static double jsonNumber(const std::string& object, const char* key) {
+    std::string needle = std::string("\"") + key + "\":";
+    size_t at = object.find(needle);
+    return at == std::string::npos ? 0 : strtod(object.c_str() + at + needle.size(), NULL);
+}
+
+// Reads the format writeBaseline() produces: one object per benchmark
+static bool readBaseline(const char* path, std::map<std::string, Result>& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    std::string text;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) text.append(chunk, n);
+    fclose(f);
+
+    size_t at = 0;
+    while ((at = text.find("{\"name\": \"", at)) != std::string::npos) {
+        size_t nameStart = at + 10;
+        size_t nameEnd = text.find('"', nameStart);
+        size_t end = text.find('}', nameEnd);
+        if (nameEnd == std::string::npos || end == std::string::npos) break;
+        std::string object = text.substr(nameEnd, end - nameEnd);
+        out[text.substr(nameStart, nameEnd - nameStart)] = {jsonNumber(object, "ns_per_op"),
+                                                            jsonNumber(object, "allocs_per_op"),
+                                                            jsonNumber(object, "alloc_bytes_per_op"),
+                                                            jsonNumber(object, "encoded_bytes")};
+        at = end;
+    }
+    return true;
+}
+
+static int compare(const std::map<std::string, Result>& baseline,
+                   const std::vector<std::pair<std::string, Result>>& results, double thresholdPct) {
+    int regressions = 0;
+    printf("\n%-28s %12s %12s %8s  %s\n", "benchmark", "base ns", "now ns", "delta", "status");
+    for (const auto& entry : results) {
+        auto it = baseline.find(entry.first);
+        const Result& now = entry.second;
+        if (it == baseline.end()) {
+            printf("%-28s %12s %12.1f %8s  new\n", entry.first.c_str(), "-", now.nsPerOp, "-");
+            continue;
+        }
+        const Result& base = it->second;
+        double delta = base.nsPerOp > 0 ? (now.nsPerOp / base.nsPerOp - 1) * 100 : 0;
+
+        std::string status;
+        if (delta > thresholdPct) status += " time";
+        // Per-op counters are averages, allow for rounding in the file
+        if (now.allocs > base.allocs + 0.01) status += " allocs";
+        if (now.allocBytes > base.allocBytes + 0.01) status += " alloc_bytes";
+        if (now.encoded > base.encoded + 0.01) status += " encoded";
+        if (!status.empty()) regressions++;
+        printf("%-28s %12.1f %12.1f %+7.1f%%  %s\n", entry.first.c_str(), base.nsPerOp, now.nsPerOp, delta,
+               status.empty() ? "ok" : ("REGRESSION:" + status).c_str());
+    }
+    printf("%d regression(s), time threshold %.0f%%\n", regressions, thresholdPct);
+    return regressions ? 1 : 0;
+}
+
+// Runs per benchmark for --out and --compare, and the default time threshold
+#define BENCH_REPETITIONS 5
+#define BENCH_THRESHOLD_PCT 25
+#define BENCH_STR2(x) #x
+#define BENCH_STR(x) BENCH_STR2(x)
+
+int main(int argc, char** argv) {
+    const char* outPath = NULL;
+    const char* comparePath = NULL;
+    double thresholdPct = BENCH_THRESHOLD_PCT;
+
+    // Take our flags out, the rest goes to Google Benchmark
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        if (i + 1 < argc && !strcmp(argv[i], "--out")) {
+            outPath = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "--compare")) {
+            comparePath = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "--threshold")) {
+            thresholdPct = atof(argv[++i]);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    // A baseline is written and compared as the median of several runs
+    // unless the repetitions are given explicitly
+    bool repetitionsGiven = false;
+    for (char* arg : args) repetitionsGiven |= !strncmp(arg, "--benchmark_repetitions", 23);
+    static char repetitions[] = "--benchmark_repetitions=" BENCH_STR(BENCH_REPETITIONS);
+    static char aggregatesOnly[] = "--benchmark_display_aggregates_only=true";
+    if ((outPath || comparePath) && !repetitionsGiven) {
+        args.push_back(repetitions);
+        args.push_back(aggregatesOnly);
+    }
+
+    int benchArgc = (int)args.size();
+    benchmark::Initialize(&benchArgc, args.data());
+    if (benchmark::ReportUnrecognizedArguments(benchArgc, args.data())) return 2;
+
+    std::map<std::string, Result> baseline;
+    if (comparePath && !readBaseline(comparePath, baseline)) {
+        fprintf(stderr, "cannot read baseline %s\n", comparePath);
+        return 2;
+    }
+
+    CollectingReporter reporter;
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+
+    if (outPath) {
+        if (!writeBaseline(outPath, reporter.results)) {
+            fprintf(stderr, "cannot write %s\n", outPath);
+            return 2;
+        }
+        printf("Baseline written to %s\n", outPath);
+    }
+    return comparePath ? compare(baseline, reporter.results, thresholdPct) : 0;
+}
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Downloads the single-header ArduinoJson release the Gateway builds with
+# into tools/bench/third_party, for the parsing benchmarks of bench.cpp and
+# the parsing tests of tools/tests/zeroAllocTest.cpp:
+#   sh tools/bench/fetchArduinoJson.sh
+#   g++ ... -I tools/bench/third_party ...
+# ARDUINOJSON_VERSION overrides the version (v7 API).
+set -e
+
+VERSION=${ARDUINOJSON_VERSION:-7.2.0}
+DIR=$(dirname "$0")/third_party
+URL=https://github.com/bblanchon/ArduinoJson/releases/download/v$VERSION/ArduinoJson-v$VERSION.h
+
+mkdir -p "$DIR"
+curl -fsSL -o "$DIR/ArduinoJson.h" "$URL"
+echo "ArduinoJson $VERSION -> $DIR/ArduinoJson.h"
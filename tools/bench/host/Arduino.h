@@ -0,0 +1,76 @@
+// Host stand-in for the Arduino/ESP32 core, just enough to build the
+// firmware headers (Common/*.h, Gateway/nodeFrame.h) into tools/bench and
+// tools/tests. Time is real, plus whatever a test skipped ahead with
+// hostAdvanceMillis(); tasks and critical sections are no-ops: the
+// benchmarks and tests are single-threaded.
+#ifndef BENCH_HOST_ARDUINO_H
+#define BENCH_HOST_ARDUINO_H
+
+#include <chrono>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+#define IRAM_ATTR
+
+inline unsigned long hostSkippedMs = 0;
+inline void hostAdvanceMillis(unsigned long ms) { hostSkippedMs += ms; }
+
+inline unsigned long micros() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start).count() + hostSkippedMs * 1000UL;
+}
+inline unsigned long millis() { return micros() / 1000; }
+inline void delay(unsigned long) {}
+inline void delayMicroseconds(unsigned) {}
+inline long random(long howbig) { return howbig > 0 ? rand() % howbig : 0; }
+inline long random(long lo, long hi) { return hi > lo ? lo + random(hi - lo) : lo; }
+
+// Output is discarded, only the formatting cost remains
+struct HostSerial {
+    void begin(long) {}
+    size_t write(const uint8_t*, size_t n) { return n; }
+    size_t printf(const char*, ...) { return 0; }
+    template <class T> size_t print(T) { return 0; }
+    template <class T> size_t println(T) { return 0; }
+    size_t println() { return 0; }
+};
+inline HostSerial Serial;
+
+// FreeRTOS
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef int portMUX_TYPE;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portTICK_PERIOD_MS 1
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(x) (void)(x)
+#define portEXIT_CRITICAL(x) (void)(x)
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return (TaskHandle_t)1; }
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 0; }
+inline BaseType_t xTaskCreate(void (*)(void*), const char*, uint32_t, void*, UBaseType_t, TaskHandle_t* h) {
+    if (h) *h = NULL;
+    return pdPASS;
+}
+inline void vTaskDelay(TickType_t) {}
+
+struct HostEsp {
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+};
+inline HostEsp ESP;
+
+#endif
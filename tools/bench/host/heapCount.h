@@ -0,0 +1,38 @@
+// Heap accounting for the host tools: glibc malloc, calloc and realloc are
+// interposed and counted, so a benchmark or test can check how many heap
+// allocations a code path makes. Defines the allocator entry points, so
+// include it from exactly one translation unit of a program.
+#ifndef BENCH_HOST_HEAP_COUNT_H
+#define BENCH_HOST_HEAP_COUNT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+static uint64_t allocCount = 0;
+static uint64_t allocBytes = 0;
+
+#if defined(__GLIBC__)
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+
+extern "C" void* malloc(size_t n) {
+    allocCount++;
+    allocBytes += n;
+    return __libc_malloc(n);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+    allocCount++;
+    allocBytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t n) {
+    allocCount++;
+    allocBytes += n;
+    return __libc_realloc(p, n);
+}
+#endif
+
+#endif
@@ -0,0 +1,205 @@
+// LoRa channel access simulator.
+//
+// N transmitters share one SF7/125 kHz channel and send frames as Poisson
+// arrivals. Each run is played twice, once per transmit policy of
+// Common/radio.h:
+//   random-delay  wait 100-500 ms, then send without listening (old firmware)
+//   lbt-cad       CAD, send at once if clear, else exponential backoff
+//                 (Common/lbt.h) and CAD again; send anyway after the limit
+// Any overlap of two transmissions loses both (no capture effect). Prints
+// per-frame access latency (arrival to start of transmission, queueing
+// included) and the collision rate for a sweep of offered channel loads.
+//
+// Build (host):
+//   g++ -O2 -std=c++17 tools/channel-sim/channelSim.cpp -o channel-sim
+//
+// Run:
+//   ./channel-sim --nodes 20 --len 60 --seconds 3600 --cad-miss 0.05
+//
+// A CAD that overlaps a transmission reports busy with probability
+// 1 - cad-miss. Two nodes whose CADs fall within the same two symbols both see
+// a clear channel and still collide.
+
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "../../Common/airtime.h"
+#include "../../Common/lbt.h"
+
+enum Policy { RANDOM_DELAY, LBT_CAD };
+
+struct Options {
+    int nodes = 20;
+    int len = 60;               // payload bytes, a typical data frame
+    double seconds = 3600;
+    double cadMiss = 0.05;
+    unsigned seed = 1;
+};
+
+struct Tx {
+    double start, end;
+};
+
+struct Result {
+    std::vector<double> latencyMs;
+    uint64_t frames = 0;
+    uint64_t collided = 0;
+    uint64_t forced = 0;        // sent blind after LBT_MAX_ATTEMPTS busy CADs
+};
+
+enum EventKind { ARRIVAL, ACCESS, TX_DONE };
+
+struct Event {
+    double time;        // seconds
+    int node;
+    EventKind kind;
+    bool operator>(const Event& o) const { return time > o.time; }
+};
+
+struct Node {
+    std::queue<double> pending;     // arrival times of queued frames
+    int attempt = 0;                // busy CADs for the head frame
+    bool busy = false;              // head frame is in channel access or on air
+};
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--nodes N] [--len BYTES] [--seconds S] [--cad-miss P] [--seed S]\n",
+            argv0);
+    exit(2);
+}
+
+static Options parseArgs(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* v = argv[++i];
+        if (arg == "--nodes") o.nodes = atoi(v);
+        else if (arg == "--len") o.len = atoi(v);
+        else if (arg == "--seconds") o.seconds = atof(v);
+        else if (arg == "--cad-miss") o.cadMiss = atof(v);
+        else if (arg == "--seed") o.seed = atoi(v);
+        else usage(argv[0]);
+    }
+    if (o.nodes < 1 || o.len < 1 || o.len > 253 || o.seconds <= 0 || o.cadMiss < 0 || o.cadMiss > 1) {
+        usage(argv[0]);
+    }
+    return o;
+}
+
+// Is any known transmission on air at time t?
+static bool onAir(const std::vector<Tx>& txs, double t) {
+    // Transmissions are appended in start order; only the tail can still be
+    // on air, and no frame is longer than a second at SF7
+    for (size_t i = txs.size(); i-- > 0;) {
+        if (txs[i].start <= t && t < txs[i].end) return true;
+        if (txs[i].start < t - 1.0) break;
+    }
+    return false;
+}
+
+static Result run(const Options& o, Policy policy, double load) {
+    std::mt19937 rng(o.seed);
+    std::uniform_real_distribution<double> u(0, 1);
+    const double airtime = loraAirtimeUs(o.len + 2) / 1e6;     // + 2 address bytes
+    const double cad = 2.0 * (1 << LORA_SF) / LORA_BW_HZ;      // two symbols
+    std::exponential_distribution<double> gap(load / airtime / o.nodes);
+
+    std::vector<Node> nodes(o.nodes);
+    std::vector<Tx> txs;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    Result r;
+
+    auto startAccess = [&](int n, double t) {
+        nodes[n].busy = true;
+        nodes[n].attempt = 0;
+        if (policy == RANDOM_DELAY) t += 0.1 + 0.4 * u(rng);
+        events.push({t, n, ACCESS});
+    };
+
+    for (int n = 0; n < o.nodes; n++) events.push({gap(rng), n, ARRIVAL});
+
+    while (!events.empty() && events.top().time <= o.seconds) {
+        Event e = events.top();
+        events.pop();
+        Node& node = nodes[e.node];
+
+        if (e.kind == ARRIVAL) {
+            node.pending.push(e.time);
+            events.push({e.time + gap(rng), e.node, ARRIVAL});
+            if (!node.busy) startAccess(e.node, e.time);
+        } else if (e.kind == TX_DONE) {
+            node.busy = false;
+            if (!node.pending.empty()) startAccess(e.node, e.time);
+        } else {
+            double txStart = e.time;
+            if (policy == LBT_CAD && node.attempt == LBT_MAX_ATTEMPTS) {
+                r.forced++;     // radioWaitClear() gives up and sends
+            } else if (policy == LBT_CAD) {
+                txStart += cad;
+                if (onAir(txs, txStart) && u(rng) >= o.cadMiss) {
+                    uint32_t slots = lbtBackoffSlots(node.attempt++, (uint32_t)rng());
+                    events.push({txStart + slots * LBT_SLOT_MS / 1000.0, e.node, ACCESS});
+                    continue;
+                }
+            }
+            txs.push_back({txStart, txStart + airtime});
+            r.latencyMs.push_back((txStart - node.pending.front()) * 1000.0);
+            node.pending.pop();
+            events.push({txStart + airtime, e.node, TX_DONE});
+        }
+    }
+
+    // Collision pass: sorted by start, a frame collides if it starts before an
+    // earlier one ends or the next one starts before it ends
+    std::sort(txs.begin(), txs.end(), [](const Tx& a, const Tx& b) { return a.start < b.start; });
+    double maxEnd = -1;
+    for (size_t i = 0; i < txs.size(); i++) {
+        bool hit = txs[i].start < maxEnd || (i + 1 < txs.size() && txs[i + 1].start < txs[i].end);
+        if (hit) r.collided++;
+        maxEnd = std::max(maxEnd, txs[i].end);
+    }
+    r.frames = txs.size();
+    return r;
+}
+
+static double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    size_t i = (size_t)(p / 100.0 * (v.size() - 1) + 0.5);
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+int main(int argc, char** argv) {
+    Options o = parseArgs(argc, argv);
+    printf("%d nodes, %d byte payload (%.1f ms airtime), %.0f s per run, CAD miss %.0f%%\n",
+           o.nodes, o.len, loraAirtimeUs(o.len + 2) / 1000.0, o.seconds, o.cadMiss * 100);
+    printf("LBT: slot %d ms, window %d..%d slots, %d CAD attempts\n\n", LBT_SLOT_MS, LBT_CW_MIN_SLOTS,
+           LBT_CW_MAX_SLOTS, LBT_MAX_ATTEMPTS);
+    printf("%-6s %-13s %9s %10s %10s %10s %11s %8s\n", "load", "policy", "frames", "mean ms", "p50 ms",
+           "p99 ms", "collided %", "forced");
+
+    // Offered load: frames per airtime across all nodes
+    const double loads[] = {0.01, 0.05, 0.1, 0.2, 0.4};
+    const char* names[] = {"random-delay", "lbt-cad"};
+    for (double load : loads) {
+        for (int p = 0; p < 2; p++) {
+            Result r = run(o, (Policy)p, load);
+            double mean = 0;
+            for (double l : r.latencyMs) mean += l;
+            if (!r.latencyMs.empty()) mean /= r.latencyMs.size();
+            double p50 = percentile(r.latencyMs, 50);
+            double p99 = percentile(r.latencyMs, 99);
+            printf("%-6.2f %-13s %9llu %10.1f %10.1f %10.1f %11.2f %8llu\n", load, names[p],
+                   (unsigned long long)r.frames, mean, p50, p99,
+                   r.frames ? 100.0 * r.collided / r.frames : 0.0, (unsigned long long)r.forced);
+        }
+    }
+    return 0;
+}
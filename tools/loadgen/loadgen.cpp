@@ -0,0 +1,513 @@
+// Synthetic ingest load for wesm-backend.
+//
+// Emulates many nodes posting to /stream_data with the exact payloads the
+// Gateway sends (Gateway/payload.h), at a fixed open-loop rate, and reports
+// sustained throughput and latency percentiles.
+//
+// Build (Linux/macOS host):
+//   g++ -O2 -std=c++17 -pthread tools/loadgen/loadgen.cpp -o loadgen
+//
+// Run against a local backend + MongoDB:
+//   ./loadgen --nodes 2000 --sensors 2 --rate 500 --connections 16 --duration 60
+//
+// The backend picks the collection from node_id ("node_1" water, "node_2"
+// electricity), so emulated node n keeps that node_id and gets distinct
+// sensor ids instead: "water<n>_<k>" or "power<n>_<k>". RSSI is posted per
+// emulated node as "node_<n>". Every emulated node sends one reading per
+// sensor plus one RSSI per cycle.
+//
+// With --gateways G every reading is posted G times, as if G gateways had
+// heard the same frame: same "seq" and "ts", a different gateway id and RSSI.
+// The backend stores one copy and drops the rest, so this measures ingest
+// throughput with deduplication in the path; compare the backend's
+// /api/get/status/links counters with the expected unique count printed here.
+//
+// Latency is measured from the scheduled send time, not the actual one, so a
+// backend that falls behind shows up in the percentiles instead of silently
+// lowering the offered rate.
+//
+// With --export PATH it measures the bulk export route instead: every
+// connection GETs PATH again as soon as the previous download finished, and
+// the report gives rows/s, MB/s, time to first byte and download time.
+// Ingest a data set first, then e.g.
+//   ./loadgen --connections 4 --duration 30 --export
+//     "/api/export?type=water&sensors=water1_0,water3_0&start=2025-01-01&end=2025-12-31"
+// (one command line).
+// --gzip asks for a compressed response; rows are then not counted.
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../../Gateway/payload.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "3000";
+    std::string path = "/stream_data";
+    int nodes = 1000;
+    int sensors = 2;
+    double rate = 200;      // requests per second, all connections together
+    int connections = 8;
+    int duration = 30;      // seconds, including warmup
+    int warmup = 5;         // seconds excluded from the report
+    int gateways = 1;       // copies of every reading, one per emulated gateway
+    uint32_t epoch = 0;     // "ts" of the first cycle
+    std::string exportPath; // export mode when set
+    bool gzip = false;
+};
+
+struct Counters {
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> ok{0};
+    std::atomic<uint64_t> httpErrors{0};
+    std::atomic<uint64_t> ioErrors{0};
+    std::atomic<uint64_t> bytes{0};     // export mode: body bytes received
+    std::atomic<uint64_t> rows{0};      // export mode: '\n'-terminated lines
+};
+
+// Timing of one export download
+struct Download {
+    Clock::time_point firstByte;
+};
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--host H] [--port P] [--path /stream_data] [--nodes N] [--sensors S]\n"
+            "          [--rate R] [--connections C] [--duration SEC] [--warmup SEC] [--gateways G]\n"
+            "       %s [--host H] [--port P] [--connections C] [--duration SEC] [--warmup SEC]\n"
+            "          [--gzip] --export PATH\n",
+            argv0, argv0);
+    exit(2);
+}
+
+static Options parseArgs(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--gzip") {
+            o.gzip = true;
+            continue;
+        }
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* v = argv[++i];
+        if (arg == "--host") o.host = v;
+        else if (arg == "--port") o.port = v;
+        else if (arg == "--path") o.path = v;
+        else if (arg == "--nodes") o.nodes = atoi(v);
+        else if (arg == "--sensors") o.sensors = atoi(v);
+        else if (arg == "--rate") o.rate = atof(v);
+        else if (arg == "--connections") o.connections = atoi(v);
+        else if (arg == "--duration") o.duration = atoi(v);
+        else if (arg == "--warmup") o.warmup = atoi(v);
+        else if (arg == "--gateways") o.gateways = atoi(v);
+        else if (arg == "--export") o.exportPath = v;
+        else usage(argv[0]);
+    }
+    if (o.nodes < 1 || o.sensors < 1 || o.rate <= 0 || o.connections < 1 ||
+        o.duration <= o.warmup || o.warmup < 0 || o.gateways < 1 || o.gateways > 10) {
+        usage(argv[0]);
+    }
+    return o;
+}
+
+// One keep-alive HTTP/1.1 connection, reopened after any I/O error
+class Connection {
+public:
+    Connection(const Options& o) : opts(o) {}
+    ~Connection() { close(); }
+
+    // Returns the HTTP status, or -1 on a connection/protocol error
+    int post(const char* body, size_t len) {
+        if (fd < 0 && !open()) return -1;
+
+        char head[256];
+        int headLen = snprintf(head, sizeof(head),
+                               "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                               "Content-Length: %zu\r\nConnection: keep-alive\r\n\r\n",
+                               opts.path.c_str(), opts.host.c_str(), len);
+        if (!sendAll(head, headLen) || !sendAll(body, len)) return fail();
+
+        int status = readResponse();
+        return status < 0 ? fail() : status;
+    }
+
+    // GET with the body counted as it streams in (chunked or Content-Length)
+    // and dropped. Returns the HTTP status, or -1 on a connection/protocol
+    // error.
+    int get(const std::string& path, Counters& counters, Download& download) {
+        if (fd < 0 && !open()) return -1;
+
+        char head[1024];
+        int headLen = snprintf(head, sizeof(head), "GET %s HTTP/1.1\r\nHost: %s\r\n%sConnection: keep-alive\r\n\r\n",
+                               path.c_str(), opts.host.c_str(), opts.gzip ? "Accept-Encoding: gzip\r\n" : "");
+        if (headLen >= (int)sizeof(head) || !sendAll(head, headLen)) return fail();
+
+        int status;
+        std::string headers;
+        if (!readHeaders(status, headers)) return fail();
+        download.firstByte = Clock::now();
+
+        if (headers.find("\r\ntransfer-encoding: chunked") != std::string::npos) {
+            for (;;) {
+                size_t lineEnd;
+                while ((lineEnd = in.find("\r\n")) == std::string::npos) {
+                    if (!fill()) return fail();
+                }
+                size_t size = strtoul(in.c_str(), nullptr, 16);
+                in.erase(0, lineEnd + 2);
+                if (size == 0) {
+                    // No trailers from Express: just the closing CRLF
+                    while (in.size() < 2) {
+                        if (!fill()) return fail();
+                    }
+                    in.erase(0, 2);
+                    break;
+                }
+                if (!consume(size + 2, size, counters)) return fail();
+            }
+        } else {
+            size_t cl = headers.find("\r\ncontent-length:");
+            size_t bodyLen = cl == std::string::npos ? 0 : strtoul(headers.c_str() + cl + 17, nullptr, 10);
+            if (!consume(bodyLen, bodyLen, counters)) return fail();
+        }
+        if (headers.find("\r\nconnection: close") != std::string::npos) close();
+        return status;
+    }
+
+private:
+    const Options& opts;
+    int fd = -1;
+    std::string in;
+
+    bool open() {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res = nullptr;
+        if (getaddrinfo(opts.host.c_str(), opts.port.c_str(), &hints, &res) != 0) return false;
+        for (addrinfo* a = res; a; a = a->ai_next) {
+            fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd < 0) continue;
+            if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+            ::close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(res);
+        if (fd < 0) return false;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        in.clear();
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    int fail() {
+        close();
+        return -1;
+    }
+
+    bool sendAll(const char* p, size_t len) {
+        while (len > 0) {
+            ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            p += n;
+            len -= (size_t)n;
+        }
+        return true;
+    }
+
+    bool fill() {
+        char buf[4096];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        in.append(buf, (size_t)n);
+        return true;
+    }
+
+    // Status line and lower-cased headers of a response, removed from `in`
+    bool readHeaders(int& status, std::string& headers) {
+        size_t headerEnd;
+        while ((headerEnd = in.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) return false;
+        }
+
+        status = 0;
+        if (sscanf(in.c_str(), "HTTP/1.%*d %d", &status) != 1) return false;
+
+        headers = in.substr(0, headerEnd);
+        std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+        in.erase(0, headerEnd + 4);
+        return true;
+    }
+
+    // Drop len bytes of body, counting the first `data` of them (the rest
+    // is chunk framing) into the export counters
+    bool consume(size_t len, size_t data, Counters& counters) {
+        while (len > 0) {
+            if (in.empty() && !fill()) return false;
+            size_t take = std::min(len, in.size());
+            size_t counted = std::min(take, data);
+            if (counted) {
+                counters.bytes += counted;
+                if (!opts.gzip) counters.rows += std::count(in.begin(), in.begin() + counted, '\n');
+                data -= counted;
+            }
+            in.erase(0, take);
+            len -= take;
+        }
+        return true;
+    }
+
+    // Reads one response with a Content-Length body (what Express sends for
+    // res.send of a string) and leaves any pipelined remainder in `in`
+    int readResponse() {
+        int status;
+        std::string headers;
+        if (!readHeaders(status, headers)) return -1;
+
+        size_t bodyLen = 0;
+        size_t cl = headers.find("\r\ncontent-length:");
+        if (cl != std::string::npos) bodyLen = strtoul(headers.c_str() + cl + 17, nullptr, 10);
+        bool closeAfter = headers.find("\r\nconnection: close") != std::string::npos;
+
+        while (in.size() < bodyLen) {
+            if (!fill()) return -1;
+        }
+        in.erase(0, bodyLen);
+        if (closeAfter) close();
+        return status;
+    }
+};
+
+// Builds the payload of request number `seq`: copy `seq % gateways` of
+// emulated reading number `seq / gateways`
+static size_t buildPayload(const Options& o, uint64_t seq, char* buf, size_t cap) {
+    const int copy = (int)(seq % o.gateways);
+    const uint64_t reading = seq / o.gateways;
+    const uint64_t perNode = (uint64_t)o.sensors + 1;
+    const uint64_t slots = (uint64_t)o.nodes * perNode;
+    const uint64_t cycle = reading / slots;
+    const int node = (int)((reading % slots) / perNode);
+    const int slot = (int)(reading % perNode);
+    const uint32_t ts = o.epoch + (uint32_t)cycle;
+
+    char gateway[16];
+    snprintf(gateway, sizeof(gateway), "gw_%d", 10 + copy);
+    const PayloadLink link = {gateway, -70 - (int)((reading * 13 + copy * 29) % 50), (long)(cycle % 65536)};
+
+    char nodeId[24];
+    char sensorId[32];
+    if (slot == o.sensors) {
+        snprintf(nodeId, sizeof(nodeId), "node_%d", node);
+        const PayloadLink rssiLink = {gateway, link.rssi, -1};
+        return formatPayloadRssi(buf, cap, nodeId, -60 - (int)((reading * 7) % 50), &rssiLink);
+    }
+
+    // Cumulative meters only ever grow
+    if (node % 2 == 0) {
+        snprintf(sensorId, sizeof(sensorId), "power%d_%d", node, slot);
+        return formatPayloadE(buf, cap, "node_2", sensorId, 100.0f + cycle * 0.05f, 220.0f, ts, &link);
+    }
+    snprintf(sensorId, sizeof(sensorId), "water%d_%d", node, slot);
+    return formatPayloadW(buf, cap, "node_1", sensorId, 10.0f + cycle * 0.01f, ts, &link);
+}
+
+static void worker(const Options& o, int index, Clock::time_point start, std::atomic<uint64_t>& seq,
+                   Counters& counters, std::vector<uint32_t>& latenciesUs) {
+    Connection conn(o);
+    char body[192];
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(o.connections / o.rate));
+    const auto end = start + std::chrono::seconds(o.duration);
+    const auto measureFrom = start + std::chrono::seconds(o.warmup);
+
+    // Stagger connections across one interval so requests are evenly spaced
+    auto due = start + interval * index / o.connections;
+    while (due < end) {
+        std::this_thread::sleep_until(due);
+
+        size_t len = buildPayload(o, seq.fetch_add(1), body, sizeof(body));
+        counters.sent++;
+        int status = conn.post(body, len);
+        auto done = Clock::now();
+
+        if (status < 0) counters.ioErrors++;
+        else if (status / 100 != 2) counters.httpErrors++;
+        else counters.ok++;
+
+        if (status >= 0 && due >= measureFrom) {
+            latenciesUs.push_back(
+                (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(done - due).count());
+        }
+        due += interval;
+    }
+}
+
+// Export mode: download PATH back to back until the run ends. Latencies
+// are time to first byte and full download time, in microseconds.
+static void exportWorker(const Options& o, Clock::time_point start, Counters& counters,
+                         std::vector<uint32_t>& firstByteUs, std::vector<uint32_t>& totalUs) {
+    Connection conn(o);
+    const auto end = start + std::chrono::seconds(o.duration);
+    const auto measureFrom = start + std::chrono::seconds(o.warmup);
+    std::this_thread::sleep_until(start);
+
+    while (Clock::now() < end) {
+        auto begin = Clock::now();
+        Download download;
+        counters.sent++;
+        int status = conn.get(o.exportPath, counters, download);
+        auto done = Clock::now();
+
+        if (status < 0) counters.ioErrors++;
+        else if (status / 100 != 2) counters.httpErrors++;
+        else counters.ok++;
+
+        if (status >= 0 && begin >= measureFrom) {
+            firstByteUs.push_back(
+                (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(download.firstByte - begin).count());
+            totalUs.push_back((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(done - begin).count());
+        }
+        if (status < 0) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+static double percentile(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)] / 1000.0;
+}
+
+static std::vector<uint32_t> merged(std::vector<std::vector<uint32_t>>& parts) {
+    std::vector<uint32_t> all;
+    for (auto& p : parts) all.insert(all.end(), p.begin(), p.end());
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+static int runExport(const Options& o) {
+    printf("loadgen: export %s:%s%s%s over %d connections, %ds (+%ds warmup)\n", o.host.c_str(),
+           o.port.c_str(), o.exportPath.c_str(), o.gzip ? " (gzip)" : "", o.connections, o.duration - o.warmup,
+           o.warmup);
+
+    Counters counters;
+    std::vector<std::vector<uint32_t>> firstByte(o.connections), total(o.connections);
+    std::vector<std::thread> threads;
+    const auto start = Clock::now() + std::chrono::milliseconds(100);
+    for (int i = 0; i < o.connections; i++) {
+        threads.emplace_back(exportWorker, std::cref(o), start, std::ref(counters), std::ref(firstByte[i]),
+                             std::ref(total[i]));
+    }
+
+    // Bytes and rows are counted as they arrive, so the per-second rates
+    // hold even when a single download spans the whole run
+    uint64_t lastBytes = 0, lastRows = 0, measuredBytes = 0, measuredRows = 0;
+    for (int s = 1; s <= o.duration; s++) {
+        std::this_thread::sleep_until(start + std::chrono::seconds(s));
+        uint64_t bytes = counters.bytes.load();
+        uint64_t rows = counters.rows.load();
+        printf("[%3ds] %8llu rows/s  %7.2f MB/s  downloads %llu  http_err %llu  io_err %llu\n", s,
+               (unsigned long long)(rows - lastRows), (bytes - lastBytes) / 1e6,
+               (unsigned long long)counters.ok.load(), (unsigned long long)counters.httpErrors.load(),
+               (unsigned long long)counters.ioErrors.load());
+        if (s > o.warmup) {
+            measuredBytes += bytes - lastBytes;
+            measuredRows += rows - lastRows;
+        }
+        lastBytes = bytes;
+        lastRows = rows;
+    }
+    for (auto& t : threads) t.join();
+
+    const double window = o.duration - o.warmup;
+    std::vector<uint32_t> ttfb = merged(firstByte), all = merged(total);
+    printf("\nmeasured %.0fs: %.2f MB/s", window, measuredBytes / window / 1e6);
+    if (!o.gzip) printf(", %.0f rows/s", measuredRows / window);
+    printf("\n%zu downloads started after warmup\n", all.size());
+    printf("first byte ms  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n", percentile(ttfb, 50), percentile(ttfb, 90),
+           percentile(ttfb, 99), ttfb.empty() ? 0.0 : ttfb.back() / 1000.0);
+    printf("download ms    p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n", percentile(all, 50), percentile(all, 90),
+           percentile(all, 99), all.empty() ? 0.0 : all.back() / 1000.0);
+    printf("errors         http %llu  io %llu\n", (unsigned long long)counters.httpErrors.load(),
+           (unsigned long long)counters.ioErrors.load());
+    return counters.ioErrors.load() || counters.httpErrors.load() ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    Options o = parseArgs(argc, argv);
+    if (!o.exportPath.empty()) return runExport(o);
+    o.epoch = (uint32_t)time(nullptr);
+    printf("loadgen: %s:%s%s, %d nodes x (%d sensors + rssi) x %d gateways, %.0f req/s over %d connections, "
+           "%ds (+%ds warmup)\n",
+           o.host.c_str(), o.port.c_str(), o.path.c_str(), o.nodes, o.sensors, o.gateways, o.rate,
+           o.connections, o.duration - o.warmup, o.warmup);
+
+    Counters counters;
+    std::atomic<uint64_t> seq{0};
+    std::vector<std::vector<uint32_t>> latencies(o.connections);
+    std::vector<std::thread> threads;
+    const auto start = Clock::now() + std::chrono::milliseconds(100);
+
+    for (int i = 0; i < o.connections; i++) {
+        threads.emplace_back(worker, std::cref(o), i, start, std::ref(seq), std::ref(counters),
+                             std::ref(latencies[i]));
+    }
+
+    // Per-second progress while the run is in flight
+    uint64_t lastOk = 0;
+    for (int s = 1; s <= o.duration; s++) {
+        std::this_thread::sleep_until(start + std::chrono::seconds(s));
+        uint64_t ok = counters.ok.load();
+        printf("[%3ds] %6llu ok/s  sent %llu  http_err %llu  io_err %llu\n", s,
+               (unsigned long long)(ok - lastOk), (unsigned long long)counters.sent.load(),
+               (unsigned long long)counters.httpErrors.load(),
+               (unsigned long long)counters.ioErrors.load());
+        lastOk = ok;
+    }
+    for (auto& t : threads) t.join();
+
+    std::vector<uint32_t> all = merged(latencies);
+
+    const double window = o.duration - o.warmup;
+    const double achieved = all.size() / window;
+    printf("\nmeasured %zu responses in %.0fs: %.1f req/s (offered %.1f)\n", all.size(), window,
+           achieved, o.rate);
+    printf("latency ms  p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", percentile(all, 50),
+           percentile(all, 90), percentile(all, 99), percentile(all, 99.9),
+           all.empty() ? 0.0 : all.back() / 1000.0);
+    printf("errors      http %llu  io %llu\n", (unsigned long long)counters.httpErrors.load(),
+           (unsigned long long)counters.ioErrors.load());
+    if (o.gateways > 1) {
+        const uint64_t sent = counters.sent.load();
+        const uint64_t perNode = (uint64_t)o.sensors + 1;
+        const uint64_t readings = sent / o.gateways;
+        const uint64_t rssi = readings / perNode;     // the last slot of every node
+        printf("dedup       %llu requests, %llu unique readings expected (+%llu rssi x %d gateways)\n",
+               (unsigned long long)sent, (unsigned long long)(readings - rssi), (unsigned long long)rssi,
+               o.gateways);
+    }
+    if (achieved < o.rate * 0.95) {
+        printf("backend did not sustain the offered rate; the scaling limit is at or below %.1f req/s\n",
+               achieved);
+    }
+    return counters.ioErrors.load() || counters.httpErrors.load() ? 1 : 0;
+}
@@ -0,0 +1,224 @@
+// Report-by-exception simulator.
+//
+// Replays synthetic per-minute usage traces (water in litres, energy in kWh)
+// through the node polling protocol twice: every channel on every poll, and
+// with the deadband/heartbeat filter of Common/reportFilter.h. Prints LoRa
+// frames and airtime (Common/airtime.h), backend writes, and how far the
+// backend's latest value lags the true meter reading at each poll.
+//
+// Build (host):
+//   g++ -O2 -std=c++17 tools/rbe-sim/rbeSim.cpp -o rbe-sim
+//
+// Run:
+//   ./rbe-sim --days 7 --poll-min 15 --rooms 6 --vacant 2
+//
+// Traces: occupied rooms draw water in morning/evening peaks (flushes, taps,
+// showers) and energy from a fridge, evening lights and AC; vacant rooms only
+// have a small standby load. Two channels share one node, as on Node1/Node2.
+
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <vector>
+
+#include "../../Common/airtime.h"
+#include "../../Common/reportFilter.h"
+
+struct Options {
+    int days = 7;
+    int pollMin = 15;
+    int rooms = 6;
+    int vacant = 2;
+    float waterDeadband = 1.0f;     // L
+    float energyDeadband = 0.01f;   // kWh
+    int heartbeatH = 6;
+    unsigned seed = 1;
+};
+
+struct Channel {
+    bool water;
+    bool occupied;
+    int node;           // two channels per node
+    double truth = 0;   // meter reading
+};
+
+struct Totals {
+    uint64_t frames = 0;
+    uint64_t airtimeUs = 0;
+    uint64_t writes = 0;
+    uint64_t idleWrites = 0;    // writes from vacant rooms
+    double lagMax[2] = {0, 0};  // largest |truth - backend| at a poll: energy, water
+
+    void frame(size_t payloadLen) {
+        frames++;
+        airtimeUs += loraAirtimeUs(payloadLen + 2);   // + 2 address bytes
+    }
+};
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--days N] [--poll-min M] [--rooms R] [--vacant V]\n"
+            "          [--water-db L] [--energy-db KWH] [--heartbeat-h H] [--seed S]\n",
+            argv0);
+    exit(2);
+}
+
+static Options parseArgs(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* v = argv[++i];
+        if (arg == "--days") o.days = atoi(v);
+        else if (arg == "--poll-min") o.pollMin = atoi(v);
+        else if (arg == "--rooms") o.rooms = atoi(v);
+        else if (arg == "--vacant") o.vacant = atoi(v);
+        else if (arg == "--water-db") o.waterDeadband = atof(v);
+        else if (arg == "--energy-db") o.energyDeadband = atof(v);
+        else if (arg == "--heartbeat-h") o.heartbeatH = atoi(v);
+        else if (arg == "--seed") o.seed = atoi(v);
+        else usage(argv[0]);
+    }
+    if (o.days < 1 || o.pollMin < 1 || o.rooms < 1 || o.vacant < 0 || o.vacant > o.rooms) usage(argv[0]);
+    return o;
+}
+
+// Litres drawn by an occupied room in one minute
+static double waterStep(int hour, std::mt19937& rng, int& showerLeft) {
+    std::uniform_real_distribution<double> u(0, 1);
+    double litres = 0;
+    if (showerLeft > 0) {
+        showerLeft--;
+        litres += 8;
+    }
+    bool peak = (hour >= 6 && hour < 9) || (hour >= 18 && hour < 23);
+    bool night = hour < 6;
+    double activity = peak ? 0.05 : night ? 0.003 : 0.015;
+    if (u(rng) < activity) litres += 6;             // flush
+    if (u(rng) < activity * 2) litres += 1.5;       // tap
+    if (peak && showerLeft == 0 && u(rng) < 0.004) showerLeft = 8;
+    return litres;
+}
+
+// kWh used by a room in one minute
+static double energyStep(bool occupied, int hour, bool acOn) {
+    double kw = 0.003;                              // standby
+    if (occupied) {
+        kw += 0.08;                                 // fridge, averaged over its duty cycle
+        if (hour >= 18 && hour < 23) kw += 0.1;     // lights
+        if (acOn) kw += 1.2;
+    }
+    return kw / 60.0;
+}
+
+static size_t dataFrameLen(const Channel& c, int index, double value) {
+    char buf[160];
+    int len = c.water
+        ? snprintf(buf, sizeof(buf), "{\"nodeId\":1,\"sensorId\":\"water%d\",\"Water\":%.3f,\"ts\":1760000000}",
+                   index + 1, value)
+        : snprintf(buf, sizeof(buf),
+                   "{\"nodeId\":2,\"sensorId\":\"power%d\",\"Power\":%.3f,\"Voltage\":220.0,\"ts\":1760000000}",
+                   index + 1, value);
+    return (size_t)len;
+}
+
+int main(int argc, char** argv) {
+    Options o = parseArgs(argc, argv);
+    std::mt19937 rng(o.seed);
+    std::uniform_real_distribution<double> u(0, 1);
+
+    // Water and energy channel per room
+    std::vector<Channel> channels;
+    for (int r = 0; r < o.rooms; r++) {
+        bool occupied = r >= o.vacant;
+        channels.push_back({true, occupied, r / 2});
+        channels.push_back({false, occupied, 1000 + r / 2});
+    }
+    const int nodesPerType = (o.rooms + 1) / 2;
+
+    const Deadband waterBand = {o.waterDeadband, 0.0f, (uint32_t)o.heartbeatH * 3600};
+    const Deadband energyBand = {o.energyDeadband, 0.0f, (uint32_t)o.heartbeatH * 3600};
+    std::vector<ReportFilter> filters;
+    for (const Channel& c : channels) filters.emplace_back(c.water ? waterBand : energyBand);
+
+    std::vector<double> backendRbe(channels.size(), 0);
+    std::vector<int> showerLeft(o.rooms, 0);
+    std::vector<bool> acOn(o.rooms, false);
+    Totals all, rbe;
+
+    const size_t pollLen = strlen("{\"command\":\"getData1\",\"nodeId\":1,\"time\":1760000000}");
+    const size_t ackLen = 3, endLen = 3, ncLen = strlen(REPORT_NO_CHANGE);
+
+    for (int minute = 0; minute < o.days * 24 * 60; minute++) {
+        int hour = (minute / 60) % 24;
+        for (int r = 0; r < o.rooms; r++) {
+            if (minute % 60 == 0) {
+                bool acHours = (hour >= 13 && hour < 16) || hour >= 21 || hour < 6;
+                acOn[r] = channels[2 * r].occupied && acHours && u(rng) < 0.6;
+            }
+            if (channels[2 * r].occupied) channels[2 * r].truth += waterStep(hour, rng, showerLeft[r]);
+            channels[2 * r + 1].truth += energyStep(channels[2 * r + 1].occupied, hour, acOn[r]);
+        }
+
+        if (minute % o.pollMin != 0) continue;
+        uint32_t nowSec = (uint32_t)minute * 60;
+
+        // Group channels per node: one poll command, data frames with an ack
+        // each, then "end" (or a lone "nc" under report-by-exception)
+        for (int node = 0; node < 2 * nodesPerType; node++) {
+            int nodeId = node < nodesPerType ? node : 1000 + node - nodesPerType;
+            int sentAll = 0, sentRbe = 0;
+            all.frame(pollLen);
+            rbe.frame(pollLen);
+
+            for (size_t i = 0; i < channels.size(); i++) {
+                Channel& c = channels[i];
+                if (c.node != nodeId) continue;
+                int index = (int)(i / 2);
+                size_t len = dataFrameLen(c, index, c.truth);
+
+                all.frame(len);
+                all.frame(ackLen);
+                all.writes++;
+                if (!c.occupied) all.idleWrites++;
+                sentAll++;
+
+                if (filters[i].shouldReport((float)c.truth, nowSec)) {
+                    rbe.frame(len);
+                    rbe.frame(ackLen);
+                    rbe.writes++;
+                    if (!c.occupied) rbe.idleWrites++;
+                    filters[i].markReported((float)c.truth, nowSec);
+                    backendRbe[i] = c.truth;
+                    sentRbe++;
+                }
+
+                double lag = fabs(c.truth - backendRbe[i]);
+                if (lag > rbe.lagMax[c.water]) rbe.lagMax[c.water] = lag;
+            }
+            if (sentAll) all.frame(endLen);
+            rbe.frame(sentRbe ? endLen : ncLen);
+        }
+    }
+
+    printf("%d days, poll every %d min, %d rooms (%d vacant), deadband %.2f L / %.3f kWh, heartbeat %d h\n\n",
+           o.days, o.pollMin, o.rooms, o.vacant, o.waterDeadband, o.energyDeadband, o.heartbeatH);
+    printf("%-22s %10s %12s %10s %12s %14s %14s\n", "policy", "frames", "airtime s", "writes",
+           "idle writes", "max lag water", "max lag kWh");
+    const Totals* rows[] = {&all, &rbe};
+    const char* names[] = {"every channel", "report-by-exception"};
+    for (int k = 0; k < 2; k++) {
+        const Totals& t = *rows[k];
+        printf("%-22s %10llu %12.1f %10llu %12llu %14.2f %14.3f\n", names[k], (unsigned long long)t.frames,
+               t.airtimeUs / 1e6, (unsigned long long)t.writes, (unsigned long long)t.idleWrites,
+               t.lagMax[1], t.lagMax[0]);
+    }
+    printf("\nreduction: airtime %.1f%%, writes %.1f%%, idle-circuit writes %.1f%%\n",
+           100.0 * (1 - (double)rbe.airtimeUs / all.airtimeUs),
+           100.0 * (1 - (double)rbe.writes / all.writes),
+           all.idleWrites ? 100.0 * (1 - (double)rbe.idleWrites / all.idleWrites) : 0.0);
+    return 0;
+}
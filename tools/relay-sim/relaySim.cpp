@@ -0,0 +1,361 @@
+// Multi-hop relay simulator.
+//
+// Places a Gateway and N nodes at random in a disc, a share of them
+// mains-powered relays (NODE_RELAY), and models every link with log-distance
+// path loss, fixed per-link shadowing and per-packet fading against the SF7
+// sensitivity. Nodes learn their next hop towards the Gateway with the
+// firmware's own table (Common/mesh.h, MeshRoutes) from frames they overhear:
+// the Gateway's direct frames and the routed frames relays forward for it.
+//
+// Two measurements:
+//   exchanges  request down and reply up each node's learned path, against
+//              the same exchange single-hop. Delivery ratio and latency by
+//              path length, and the latency each hop adds.
+//   subtrees   a poll of every relay's children (2 data frames each), with
+//              each frame routed through the relay (getData/ok per frame
+//              over two hops) against the relay polling them itself and
+//              returning aggregates (pollSub). Readings delivered and time.
+// No retries beyond the firmware's: a lost frame costs the waiting side its
+// timeout. Polls run one at a time, so there are no collisions.
+//
+// Build (host):
+//   g++ -O2 -std=c++17 tools/relay-sim/relaySim.cpp -o relay-sim
+//
+// Run:
+//   ./relay-sim --nodes 30 --radius 2500 --relays 0.3 --polls 500
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "../../Common/airtime.h"
+#include "../../Common/mesh.h"
+
+// Link budget at 433 MHz: LoRa library default power, free-space loss at
+// 1 m, exponent for a built-up area, SX127x sensitivity at SF7/125 kHz
+static const double TX_POWER_DBM = 17;
+static const double LOSS_1M_DB = 25;
+static const double PATH_EXPONENT = 3.5;
+static const double SENSITIVITY_DBM = -123;
+
+// Frame sizes (payload bytes) of the firmware's poll
+static const int LEN_GETDATA = 52;      // {"command":"getData1","nodeId":1,"time":...}
+static const int LEN_DATA = 76;         // {"nodeId":1,"sensorId":"water1","Water":...,"seq":..,"ts":...}
+static const int LEN_SHORT = 4;         // ok1, end, ag2
+static const int LEN_POLLSUB = 56;      // {"command":"pollSub","nodes":[...],"time":...}
+static const int DATA_FRAMES = 2;       // channels per node
+
+// Gateway timeout of receiveAllDataFromNode()
+static const double GATEWAY_POLL_TIMEOUT_MS = 10000;
+
+static const uint8_t GATEWAY = 0;       // simulator ids: Gateway 0, nodes 1..N
+
+struct Options {
+    int nodes = 30;
+    double radius = 2500;       // m
+    double relays = 0.3;        // share of nodes that relay
+    int polls = 500;            // exchanges per node
+    double shadowDb = 6;
+    double fadingDb = 3;
+    unsigned seed = 1;
+};
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--nodes N] [--radius M] [--relays SHARE] [--polls P] [--shadow DB] [--fading DB]"
+            " [--seed S]\n",
+            argv0);
+    exit(2);
+}
+
+static Options parseArgs(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* v = argv[++i];
+        if (arg == "--nodes") o.nodes = atoi(v);
+        else if (arg == "--radius") o.radius = atof(v);
+        else if (arg == "--relays") o.relays = atof(v);
+        else if (arg == "--polls") o.polls = atoi(v);
+        else if (arg == "--shadow") o.shadowDb = atof(v);
+        else if (arg == "--fading") o.fadingDb = atof(v);
+        else if (arg == "--seed") o.seed = atoi(v);
+        else usage(argv[0]);
+    }
+    if (o.nodes < 1 || o.nodes > 200 || o.radius <= 0 || o.relays < 0 || o.relays > 1 || o.polls < 1) {
+        usage(argv[0]);
+    }
+    return o;
+}
+
+class Network {
+public:
+    Network(const Options& o) : o_(o), rng_(o.seed), n_(o.nodes + 1), meanRssi_(n_ * n_), relay_(n_) {
+        std::uniform_real_distribution<double> u(0, 1);
+        std::normal_distribution<double> shadow(0, o.shadowDb);
+        std::vector<double> x(n_), y(n_);
+        for (int i = 1; i < n_; i++) {
+            double r = o.radius * sqrt(u(rng_)), a = 2 * M_PI * u(rng_);
+            x[i] = r * cos(a);
+            y[i] = r * sin(a);
+            relay_[i] = u(rng_) < o.relays;
+        }
+        for (int i = 0; i < n_; i++) {
+            for (int j = i + 1; j < n_; j++) {
+                double d = std::max(1.0, hypot(x[i] - x[j], y[i] - y[j]));
+                double rssi = TX_POWER_DBM - LOSS_1M_DB - 10 * PATH_EXPONENT * log10(d) + shadow(rng_);
+                meanRssi_[i * n_ + j] = meanRssi_[j * n_ + i] = rssi;
+            }
+        }
+    }
+
+    int size() const { return n_; }
+    bool isRelay(int i) const { return relay_[i]; }
+
+    // One packet from a to b: RSSI as measured, or nothing below sensitivity
+    bool send(int a, int b, int& rssi) {
+        std::normal_distribution<double> fading(0, o_.fadingDb);
+        double r = meanRssi_[a * n_ + b] + fading(rng_);
+        rssi = (int)lround(r);
+        return r >= SENSITIVITY_DBM;
+    }
+
+    bool send(int a, int b) {
+        int rssi;
+        return send(a, b, rssi);
+    }
+
+    double uniform(double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(rng_); }
+
+private:
+    const Options& o_;
+    std::mt19937 rng_;
+    int n_;
+    std::vector<double> meanRssi_;
+    std::vector<bool> relay_;
+};
+
+// Time one frame holds the channel on one hop: CAD, airtime, and the
+// receiver's turnaround (loop polling, LBT of its next frame)
+static double hopMs(Network& net, int len, bool routed) {
+    double cadMs = 2.0 * (1 << LORA_SF) * 1000 / LORA_BW_HZ;
+    return cadMs + loraAirtimeUs(len + (routed ? MESH_HEADER_LEN : 2)) / 1000.0 + net.uniform(2, 12);
+}
+
+// Learning: each round every node may hear the Gateway, and every relay
+// that has a route forwards Gateway traffic that the node may overhear.
+// Routes are fed exactly as NodeRuntime feeds them.
+static std::vector<MeshRoutes> learnRoutes(Network& net, int rounds) {
+    std::vector<MeshRoutes> routes(net.size());
+    uint32_t nowMs = 0;
+    for (int round = 0; round < rounds; round++, nowMs += 60000) {
+        for (int x = 1; x < net.size(); x++) {
+            int rssi;
+            if (net.send(GATEWAY, x, rssi)) routes[x].observe(GATEWAY, GATEWAY, 1, rssi, nowMs);
+        }
+        for (int r = 1; r < net.size(); r++) {
+            uint8_t links = routes[r].links(GATEWAY, nowMs);
+            if (!net.isRelay(r) || !links) continue;
+            for (int x = 1; x < net.size(); x++) {
+                int rssi;
+                if (x != r && net.send(r, x, rssi)) routes[x].observe(GATEWAY, r, links + 1, rssi, nowMs);
+            }
+        }
+    }
+    return routes;
+}
+
+// Path from a node up to the Gateway, empty if none within the TTL
+static std::vector<int> pathOf(const std::vector<MeshRoutes>& routes, int node, uint32_t nowMs) {
+    std::vector<int> path = {node};
+    while (path.back() != GATEWAY) {
+        if (path.size() > MESH_TTL_DEFAULT) return {};
+        int next = routes[path.back()].nextHop(GATEWAY, nowMs);
+        if (std::find(path.begin(), path.end(), next) != path.end()) return {};
+        path.push_back(next);
+    }
+    return path;
+}
+
+// One frame along a path (either direction), hop by hop
+static bool carry(Network& net, const std::vector<int>& path, bool up, int len, double& ms) {
+    bool routed = path.size() > 2;
+    for (size_t h = 0; h + 1 < path.size(); h++) {
+        int a = up ? path[h] : path[path.size() - 1 - h];
+        int b = up ? path[h + 1] : path[path.size() - 2 - h];
+        ms += hopMs(net, len, routed);
+        if (!net.send(a, b)) return false;
+    }
+    return true;
+}
+
+struct ExchangeStats {
+    int nodes = 0;
+    long tries = 0;
+    long delivered = 0;
+    long directDelivered = 0;
+    double latencyMs = 0;       // of delivered exchanges
+};
+
+// getData down, one data frame up, along the node's path and single-hop
+static void runExchanges(Network& net, const Options& o, const std::vector<MeshRoutes>& routes, uint32_t nowMs,
+                         std::vector<ExchangeStats>& byLinks) {
+    for (int x = 1; x < net.size(); x++) {
+        std::vector<int> path = pathOf(routes, x, nowMs);
+        size_t links = path.empty() ? 0 : path.size() - 1;
+        ExchangeStats& s = byLinks[std::min(links, byLinks.size() - 1)];
+        s.nodes++;
+        std::vector<int> direct = {x, GATEWAY};
+        for (int p = 0; p < o.polls; p++) {
+            s.tries++;
+            double ms = 0, directMs = 0;
+            if (!path.empty() && carry(net, path, false, LEN_GETDATA, ms) && carry(net, path, true, LEN_DATA, ms)) {
+                s.delivered++;
+                s.latencyMs += ms;
+            }
+            if (carry(net, direct, false, LEN_GETDATA, directMs) && carry(net, direct, true, LEN_DATA, directMs)) {
+                s.directDelivered++;
+            }
+        }
+    }
+}
+
+// One node's getData/data/ok.../end on a path; returns data frames delivered
+// and adds the time spent, including the timeout of the waiting side when
+// a frame is lost
+static int pollOver(Network& net, const std::vector<int>& path, double timeoutMs, double& ms) {
+    if (!carry(net, path, false, LEN_GETDATA, ms)) return ms += timeoutMs, 0;
+    int delivered = 0;
+    for (int f = 0; f < DATA_FRAMES; f++) {
+        if (!carry(net, path, true, LEN_DATA, ms)) return ms += timeoutMs, delivered;
+        delivered++;
+        if (!carry(net, path, false, LEN_SHORT, ms)) return ms += timeoutMs, delivered;
+    }
+    if (!carry(net, path, true, LEN_SHORT, ms)) ms += timeoutMs;
+    return delivered;
+}
+
+struct SubtreeStats {
+    int relays = 0;
+    int children = 0;
+    long expected = 0;
+    long perFrameDelivered = 0;
+    long aggregateDelivered = 0;
+    double perFrameMs = 0;
+    double aggregateMs = 0;
+};
+
+// Every relay whose children reach the Gateway through it (two links)
+static SubtreeStats runSubtrees(Network& net, const Options& o, const std::vector<MeshRoutes>& routes,
+                                uint32_t nowMs) {
+    SubtreeStats s;
+    for (int r = 1; r < net.size(); r++) {
+        std::vector<int> children;
+        for (int x = 1; x < net.size(); x++) {
+            std::vector<int> path = pathOf(routes, x, nowMs);
+            if (path.size() == 3 && path[1] == r && children.size() < RELAY_MAX_CHILDREN) children.push_back(x);
+        }
+        if (children.empty()) continue;
+        s.relays++;
+        s.children += children.size();
+        std::vector<int> up = {r, GATEWAY};
+
+        for (int p = 0; p < o.polls; p++) {
+            s.expected += children.size() * DATA_FRAMES;
+
+            // Each child polled by the Gateway through the relay
+            for (int c : children) {
+                s.perFrameDelivered += pollOver(net, {c, r, GATEWAY}, GATEWAY_POLL_TIMEOUT_MS, s.perFrameMs);
+            }
+
+            // pollSub: the relay polls its children and sends aggregates
+            double ms = 0;
+            if (!carry(net, up, false, LEN_POLLSUB, ms)) {
+                s.aggregateMs += ms + GATEWAY_POLL_TIMEOUT_MS;
+                continue;
+            }
+            int frames = 0;
+            for (int c : children) frames += pollOver(net, {c, r}, RELAY_CHILD_TIMEOUT_MS, ms);
+
+            // Aggregates of MESH_AGG_MAX bytes, each resent until acked
+            int perAggregate = (MESH_AGG_MAX - 6) / (LEN_DATA + 1);
+            int left = frames;
+            while (left > 0) {
+                int n = std::min(left, perAggregate);
+                int len = 5 + n * (LEN_DATA + 1);
+                bool arrived = false;
+                for (int attempt = 0; attempt < RELAY_AGG_ATTEMPTS; attempt++) {
+                    bool got = carry(net, up, true, len, ms);
+                    arrived |= got;
+                    if (got && carry(net, up, false, LEN_SHORT, ms)) break;
+                    ms += RELAY_ACK_TIMEOUT_MS;
+                }
+                if (arrived) s.aggregateDelivered += n;
+                left -= n;
+            }
+            if (!carry(net, up, true, LEN_SHORT, ms)) ms += GATEWAY_POLL_TIMEOUT_MS;
+            s.aggregateMs += ms;
+        }
+    }
+    return s;
+}
+
+int main(int argc, char** argv) {
+    Options o = parseArgs(argc, argv);
+    Network net(o);
+    int relays = 0;
+    for (int i = 1; i < net.size(); i++) relays += net.isRelay(i);
+
+    const int LEARN_ROUNDS = 20;
+    std::vector<MeshRoutes> routes = learnRoutes(net, LEARN_ROUNDS);
+    uint32_t nowMs = (LEARN_ROUNDS - 1) * 60000;
+
+    printf("%d nodes (%d relays) within %.0f m, shadowing %.0f dB, fading %.0f dB, %d polls each\n", o.nodes,
+           relays, o.radius, o.shadowDb, o.fadingDb, o.polls);
+    printf("Routes: hop cost %d dB, good RSSI %d dBm, TTL %d\n\n", MESH_HOP_COST, MESH_RSSI_GOOD, MESH_TTL_DEFAULT);
+
+    // Index 0: no path; the last one collects longer paths
+    std::vector<ExchangeStats> byLinks(MESH_TTL_DEFAULT + 1);
+    runExchanges(net, o, routes, nowMs, byLinks);
+
+    printf("Exchange (getData down, data up) by learned path length\n");
+    printf("%-6s %6s %12s %12s %10s %12s\n", "links", "nodes", "single-hop %", "routed %", "mean ms", "ms per hop");
+    double oneHopMs = 0;
+    long totalTries = 0, totalDelivered = 0, totalDirect = 0;
+    for (size_t links = 0; links < byLinks.size(); links++) {
+        const ExchangeStats& s = byLinks[links];
+        totalTries += s.tries;
+        totalDelivered += s.delivered;
+        totalDirect += s.directDelivered;
+        if (!s.nodes) continue;
+        double mean = s.delivered ? s.latencyMs / s.delivered : 0;
+        if (links == 1) oneHopMs = mean;
+        char perHop[16] = "-";
+        if (links > 1 && s.delivered && oneHopMs > 0) {
+            snprintf(perHop, sizeof(perHop), "+%.1f", (mean - oneHopMs) / (links - 1));
+        }
+        char name[8];
+        snprintf(name, sizeof(name), links ? "%zu" : "none", links);
+        printf("%-6s %6d %12.1f %12.1f %10.1f %12s\n", name, s.nodes, 100.0 * s.directDelivered / s.tries,
+               100.0 * s.delivered / s.tries, mean, perHop);
+    }
+    printf("%-6s %6d %12.1f %12.1f\n\n", "all", o.nodes, 100.0 * totalDirect / totalTries,
+           100.0 * totalDelivered / totalTries);
+
+    SubtreeStats t = runSubtrees(net, o, routes, nowMs);
+    printf("Subtree polls: %d relays, %d children, %d data frames per child\n", t.relays, t.children, DATA_FRAMES);
+    if (t.relays) {
+        long polls = (long)t.relays * o.polls;
+        printf("%-12s %12s %14s\n", "mode", "delivered %", "ms per subtree");
+        printf("%-12s %12.1f %14.0f\n", "per-frame", 100.0 * t.perFrameDelivered / t.expected,
+               t.perFrameMs / polls);
+        printf("%-12s %12.1f %14.0f\n", "aggregated", 100.0 * t.aggregateDelivered / t.expected,
+               t.aggregateMs / polls);
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Host unit tests of the Gateway metrics histogram, Gateway/histogram.h:
+// bucket bounds, the overflow bucket, the totals and percentile().
+//
+// Build and run (Linux host, GoogleTest installed):
+//   g++ -std=c++17 tools/tests/histogramTest.cpp -lgtest -lgtest_main -lpthread -o histogramTest
+//   ./histogramTest
+
+#include <gtest/gtest.h>
+
+#include "../../Gateway/histogram.h"
+
+// Bounds of the poll RTT histogram in metrics.cpp
+static const uint32_t RTT_BOUNDS[] = {250, 500, 1000, 2000, 4000, 8000, 15000};
+static const uint8_t RTT_BUCKETS = sizeof(RTT_BOUNDS) / sizeof(RTT_BOUNDS[0]);
+
+class HistogramTest : public ::testing::Test {
+protected:
+    Histogram h;
+    void SetUp() override { h.init(RTT_BOUNDS, RTT_BUCKETS); }
+};
+
+TEST_F(HistogramTest, ValueOnABoundCountsInThatBucket) {
+    h.observe(250);
+    h.observe(251);
+    h.observe(0);
+    EXPECT_EQ(h.counts[0], 2u);
+    EXPECT_EQ(h.counts[1], 1u);
+}
+
+TEST_F(HistogramTest, ValuesAboveTheLastBoundOverflow) {
+    h.observe(15000);
+    h.observe(15001);
+    h.observe(0xFFFFFFFF);
+    EXPECT_EQ(h.counts[RTT_BUCKETS - 1], 1u);
+    EXPECT_EQ(h.counts[RTT_BUCKETS], 2u);
+    EXPECT_EQ(h.max, 0xFFFFFFFFu);
+}
+
+TEST_F(HistogramTest, TotalsFollowTheSamples) {
+    const uint32_t samples[] = {120, 480, 480, 3900, 9000};
+    for (uint32_t s : samples) h.observe(s);
+    EXPECT_EQ(h.count, 5u);
+    EXPECT_EQ(h.sum, 120u + 480 + 480 + 3900 + 9000);
+    EXPECT_EQ(h.max, 9000u);
+    uint32_t inBuckets = 0;
+    for (uint8_t i = 0; i <= RTT_BUCKETS; i++) inBuckets += h.counts[i];
+    EXPECT_EQ(inBuckets, h.count);
+}
+
+TEST_F(HistogramTest, InitClearsAndClampsTheBucketCount) {
+    h.observe(700);
+    static const uint32_t many[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    h.init(many, sizeof(many) / sizeof(many[0]));
+    EXPECT_EQ(h.numBounds, HIST_MAX_BUCKETS);
+    EXPECT_EQ(h.count, 0u);
+    h.observe(10);
+    EXPECT_EQ(h.counts[HIST_MAX_BUCKETS], 1u);
+}
+
+TEST_F(HistogramTest, PercentileOfAnEmptyHistogramIsZero) {
+    EXPECT_EQ(h.percentile(50), 0u);
+    EXPECT_EQ(h.percentile(95), 0u);
+}
+
+TEST_F(HistogramTest, PercentileIsTheBoundOfItsBucket) {
+    // 90 fast polls, 10 slow ones
+    for (int i = 0; i < 90; i++) h.observe(200);
+    for (int i = 0; i < 10; i++) h.observe(3000);
+    EXPECT_EQ(h.percentile(0), 250u);
+    EXPECT_EQ(h.percentile(50), 250u);
+    EXPECT_EQ(h.percentile(90), 250u);
+    EXPECT_EQ(h.percentile(91), 3000u);
+    EXPECT_EQ(h.percentile(95), 3000u);
+    EXPECT_EQ(h.percentile(100), 3000u);
+}
+
+TEST_F(HistogramTest, PercentileNeverExceedsMax) {
+    h.observe(600);
+    h.observe(700);
+    EXPECT_EQ(h.percentile(50), 700u);
+    EXPECT_EQ(h.percentile(100), 700u);
+}
+
+TEST_F(HistogramTest, PercentileInTheOverflowIsMax) {
+    for (int i = 0; i < 4; i++) h.observe(100);
+    h.observe(42000);
+    EXPECT_EQ(h.percentile(80), 250u);
+    EXPECT_EQ(h.percentile(95), 42000u);
+}
@@ -0,0 +1,187 @@
+// Host test of a relay aggregate whose ack is lost (Common/mesh.h): the
+// Gateway receives it, the relay does not hear "ag<R>", keeps it and
+// resends it as "agl<R>" at the next pollSub, hours later. Runs the relay's
+// own NodeRuntime; the test plays its child node and the Gateway, which
+// pushes frames with the rule of processNodeData (Gateway/pushedFrames.h)
+// to a backend that dedups within DEDUP_WINDOW_MS (services/dedup.js).
+//
+// Build and run (Linux host, GoogleTest installed):
+//   g++ -std=c++17 -I tools/bench/host tools/tests/lateAggregateTest.cpp -lgtest -lgtest_main -lpthread -o lateAggregateTest
+//   ./lateAggregateTest
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+
+#define NODE_RELAY 1
+#include "../../Common/nodeRuntime.h"
+#include "../../Gateway/pushedFrames.h"
+
+static const int RELAY = 2;
+static const int CHILD = 3;
+static const int GATEWAY = GATEWAY_ADDR_FIRST;
+static const unsigned long DEDUP_WINDOW_MS = 30000;
+
+struct RelaySensor {
+    struct Alert {};
+    static const int CHANNELS = 1;
+
+    void begin() {}
+    const char* id(int) const { return "power1"; }
+    Deadband deadband(int) const { return {1.0f, 0.0f, 6 * 3600UL}; }
+    void sample(const NodeClock&) {}
+    float value(int) const { return 0; }
+    uint32_t epoch(int) const { return 0; }
+    int formatFields(char* out, size_t cap, int) const { return snprintf(out, cap, "\"Power\":0"); }
+    void commit() {}
+    bool takeAlert(Alert&) { return false; }
+    int formatAlert(char*, size_t, const Alert&) const { return 0; }
+    bool batchPending() const { return false; }
+    int formatBatch(char*, size_t) { return 0; }
+    void batchSent() {}
+    void historyValues(float* out) const { out[0] = 0; }
+};
+
+// The child and the Gateway, answering the relay from LoRa.onSend
+struct Peers {
+    // Child: one reading at the first poll, no change afterwards
+    const char* childFrame = "{\"nodeId\":3,\"sensorId\":\"water1\",\"Water\":12.500,\"seq\":7,\"ts\":1760000000}";
+    bool childSent = false;
+    uint8_t childMsgId = 0;
+
+    // Gateway
+    bool loseAcks = false;
+    bool gatewayDedup = true;
+    PushedFrames pushed;
+    int aggregates = 0;
+    int lateAggregates = 0;
+
+    // Backend: first arrival of each (node, seq, ts) in its window, readings stored
+    std::map<std::tuple<int, uint32_t, uint32_t>, unsigned long> seen;
+    int stored = 0;
+
+    void toRelayFromChild(const char* payload) {
+        uint8_t packet[HOST_LORA_PACKET_MAX];
+        meshEncode(meshOriginate(CHILD, RELAY, RELAY, ++childMsgId), packet);
+        size_t n = strlen(payload);
+        memcpy(packet + MESH_HEADER_LEN, payload, n);
+        LoRa.injectRaw(packet, MESH_HEADER_LEN + n);
+    }
+
+    void child(const std::string& command) {
+        if (command.find("\"getData3\"") != std::string::npos) {
+            if (childSent) {
+                toRelayFromChild(REPORT_NO_CHANGE);
+            } else {
+                toRelayFromChild(childFrame);
+            }
+        } else if (command == "ok3") {
+            childSent = true;
+            toRelayFromChild("end");
+        }
+    }
+
+    void backend(int node, uint32_t seq, uint32_t ts) {
+        auto key = std::make_tuple(node, seq, ts);
+        auto it = seen.find(key);
+        if (it != seen.end() && millis() - it->second < DEDUP_WINDOW_MS) return;
+        seen[key] = millis();
+        stored++;
+    }
+
+    void gateway(const std::string& frame) {
+        bool late = !frame.compare(0, 3, "agl");
+        if (!late && frame.compare(0, 3, "agg")) return;
+        aggregates++;
+        lateAggregates += late;
+
+        size_t start = frame.find('\n');
+        while (start != std::string::npos) {
+            size_t end = frame.find('\n', start + 1);
+            std::string line = frame.substr(start + 1, end == std::string::npos ? end : end - start - 1);
+            if (line[0] == '{') {
+                MsgView view = {line.c_str(), line.size()};
+                int node = (int)commandUintField(view, "\"nodeId\":");
+                uint32_t seq = commandUintField(view, "\"seq\":");
+                uint32_t ts = commandUintField(view, "\"ts\":");
+                bool repeat = pushed.repeat(node, seq, ts);
+                if (!(gatewayDedup && repeat && late)) backend(node, seq, ts);
+            }
+            start = end;
+        }
+        if (!loseAcks) LoRa.inject(RELAY, GATEWAY, "ag2");
+    }
+
+    void onSend() {
+        std::string payload;
+        if (LoRa.tx[0] == MESH_MARK) {
+            MeshHeader header = meshDecode(LoRa.tx);
+            payload.assign((const char*)LoRa.tx + MESH_HEADER_LEN, LoRa.txLen - MESH_HEADER_LEN);
+            if (header.dest == CHILD) child(payload);
+        } else if (LoRa.tx[1] == GATEWAY) {
+            payload.assign((const char*)LoRa.tx + 2, LoRa.txLen - 2);
+            gateway(payload);
+        }
+    }
+};
+
+static Peers* peers;
+
+class LateAggregate : public ::testing::Test {
+protected:
+    NodeRuntime<RELAY, RelaySensor> relay;
+    Peers net;
+
+    void SetUp() override {
+        peers = &net;
+        LoRa.onSend = [] { peers->onSend(); };
+        LoRa.idleMs = 100;
+        relay.begin();
+    }
+
+    void TearDown() override {
+        LoRa.onSend = NULL;
+        LoRa.idleMs = 0;
+    }
+
+    void pollSub() {
+        LoRa.inject(RELAY, GATEWAY, "{\"command\":\"pollSub\",\"nodes\":[3],\"time\":1760000000}");
+        relay.loop();
+    }
+
+    // First poll: the Gateway takes the aggregate, the relay never hears the
+    // ack. Next poll hours later, with acks back.
+    void loseAckThenPollAgain() {
+        net.loseAcks = true;
+        pollSub();
+        ASSERT_EQ(net.aggregates, RELAY_AGG_ATTEMPTS);
+
+        hostAdvanceMillis(3 * 3600 * 1000UL);
+        net.loseAcks = false;
+        pollSub();
+        ASSERT_EQ(net.lateAggregates, 1);
+    }
+};
+
+TEST_F(LateAggregate, ResentAfterTheDedupWindowIsStoredOnce) {
+    loseAckThenPollAgain();
+    EXPECT_EQ(net.stored, 1);
+}
+
+TEST_F(LateAggregate, DeliveredBacklogIsNotSentAgain) {
+    loseAckThenPollAgain();
+    int aggregates = net.aggregates;
+    pollSub();
+    EXPECT_EQ(net.lateAggregates, 1);
+    EXPECT_EQ(net.aggregates, aggregates + 1);
+    EXPECT_EQ(net.stored, 1);
+}
+
+// Without the Gateway's record the backend stores the late copy again
+TEST_F(LateAggregate, BackendWindowAloneStoresTheLateCopyTwice) {
+    net.gatewayDedup = false;
+    loseAckThenPollAgain();
+    EXPECT_EQ(net.stored, 2);
+}
@@ -0,0 +1,229 @@
+// Host unit tests of the node core, Common/nodeRuntime.h.
+//
+// Runs NodeRuntime against the host stand-ins of tools/bench/host, with a
+// sensor policy whose values, alerts and batch frames the test sets. The
+// Gateway side is played by injecting its frames into the host radio and
+// reading back the node's last transmitted packet. Covers command dispatch
+// (cmdHash, commandToken, commandUintField), the getData -> ok<N> ->
+// end / nc exchange with its commit, and alert sending, retry and timeout.
+//
+// Build and run (Linux host, GoogleTest installed):
+//   g++ -std=c++17 -I tools/bench/host tools/tests/nodeRuntimeTest.cpp -lgtest -lgtest_main -lpthread -o nodeRuntimeTest
+//   ./nodeRuntimeTest
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../../Common/nodeRuntime.h"
+
+// ---------------------------------------------------------------------------
+// Command parsing
+
+static MsgView view(const char* s) { return MsgView{s, strlen(s)}; }
+
+TEST(CommandDispatch, HashOfNumberedCommandMatchesLiteral) {
+    static_assert(cmdHashNum(cmdHash("ok"), 1) == cmdHash("ok1"), "compile time");
+    EXPECT_EQ(cmdHashNum(cmdHash("getData"), 12), cmdHash("getData12"));
+    EXPECT_EQ(cmdHashOf(view("ak2")), cmdHash("ak2"));
+    EXPECT_NE(cmdHashOf(view("ok1")), cmdHash("ok2"));
+}
+
+TEST(CommandDispatch, TokenOfPlainCommandIsThePayload) {
+    MsgView token = commandToken(view("ok1"));
+    EXPECT_EQ(std::string(token.data, token.len), "ok1");
+}
+
+TEST(CommandDispatch, TokenOfJsonCommandIsTheCommandField) {
+    MsgView token = commandToken(view("{\"command\":\"getData2\",\"nodeId\":2,\"time\":1760000000}"));
+    EXPECT_EQ(std::string(token.data, token.len), "getData2");
+    EXPECT_EQ(cmdHashOf(token), cmdHashNum(cmdHash("getData"), 2));
+}
+
+TEST(CommandDispatch, TokenIsEmptyWithoutACommand) {
+    EXPECT_EQ(commandToken(view("{\"nodeId\":2}")).len, 0u);
+    EXPECT_EQ(commandToken(view("{\"command\":\"getDa")).len, 0u);
+}
+
+TEST(CommandDispatch, UintFieldOfJsonCommand) {
+    MsgView message = view("{\"command\":\"history\",\"since\":4711,\"win\":8}");
+    EXPECT_EQ(commandUintField(message, "\"since\":"), 4711u);
+    EXPECT_EQ(commandUintField(message, "\"win\":"), 8u);
+    EXPECT_EQ(commandUintField(message, "\"time\":"), 0u);
+    EXPECT_EQ(commandUintField(view("ok1 \"time\":5"), "\"time\":"), 0u);
+}
+
+// ---------------------------------------------------------------------------
+// Node exchange
+
+struct TestSensor {
+    struct Alert {
+        int litres;
+    };
+    static const int CHANNELS = 2;
+    float values[CHANNELS] = {10.0f, 20.0f};
+    int commits = 0;
+    int batchLeft = 0;
+    bool alertWaiting = false;
+
+    void begin() {}
+    const char* id(int ch) const { return ch == 0 ? "water1" : "water2"; }
+    Deadband deadband(int) const { return {1.0f, 0.0f, 6 * 3600UL}; }
+    void sample(const NodeClock&) {}
+    float value(int ch) const { return values[ch]; }
+    uint32_t epoch(int) const { return 1760000000; }
+    int formatFields(char* out, size_t cap, int ch) const {
+        return snprintf(out, cap, "\"Water\":%.3f", values[ch]);
+    }
+    void commit() { commits++; }
+    bool takeAlert(Alert& out) {
+        if (!alertWaiting) return false;
+        alertWaiting = false;
+        out.litres = 12;
+        return true;
+    }
+    int formatAlert(char* out, size_t cap, const Alert& alert) const {
+        return snprintf(out, cap, "\"sensorId\":\"water1\",\"alert\":\"leak\",\"lpm\":%d", alert.litres);
+    }
+    bool batchPending() const { return batchLeft > 0; }
+    int formatBatch(char* out, size_t cap) { return snprintf(out, cap, "\"batch\":%d", batchLeft); }
+    void batchSent() { batchLeft--; }
+    void historyValues(float* out) const { memcpy(out, values, sizeof(values)); }
+};
+
+class NodeExchange : public ::testing::Test {
+protected:
+    static const int NODE = 1;
+    NodeRuntime<NODE, TestSensor> node;
+
+    void SetUp() override {
+        LoRa.txLen = 0;
+        node.begin();
+    }
+
+    // Gateway frame to the node, handled by one loop() pass
+    void fromGateway(const char* payload) {
+        LoRa.inject(NODE, GATEWAY_ADDR_FIRST, payload);
+        node.loop();
+    }
+
+    std::string lastTx() const {
+        return LoRa.txLen > 2 ? std::string((const char*)LoRa.tx + 2, LoRa.txLen - 2) : std::string();
+    }
+
+    static bool contains(const std::string& s, const char* part) { return s.find(part) != std::string::npos; }
+};
+
+TEST_F(NodeExchange, HelloIsAnswered) {
+    fromGateway("Hi");
+    EXPECT_EQ(lastTx(), "Done");
+}
+
+TEST_F(NodeExchange, GetDataSendsEachChannelThenEndAndCommits) {
+    fromGateway("{\"command\":\"getData1\",\"nodeId\":1,\"time\":1760000000}");
+    EXPECT_TRUE(contains(lastTx(), "\"sensorId\":\"water1\""));
+    EXPECT_EQ(node.sensor.commits, 0);
+
+    fromGateway("ok1");
+    EXPECT_TRUE(contains(lastTx(), "\"sensorId\":\"water2\""));
+    EXPECT_EQ(node.sensor.commits, 0);
+
+    fromGateway("ok1");
+    EXPECT_EQ(lastTx(), "end");
+    EXPECT_EQ(node.sensor.commits, 1);
+}
+
+TEST_F(NodeExchange, UnchangedValuesAnswerNoChange) {
+    fromGateway("{\"command\":\"getData1\",\"nodeId\":1}");
+    fromGateway("ok1");
+    fromGateway("ok1");
+    ASSERT_EQ(lastTx(), "end");
+
+    fromGateway("{\"command\":\"getData1\",\"nodeId\":1}");
+    EXPECT_EQ(lastTx(), REPORT_NO_CHANGE);
+    EXPECT_EQ(node.sensor.commits, 2);
+}
+
+TEST_F(NodeExchange, OnlyTheChannelPastItsDeadbandIsSent) {
+    fromGateway("{\"command\":\"getData1\",\"nodeId\":1}");
+    fromGateway("ok1");
+    fromGateway("ok1");
+
+    node.sensor.values[1] += 5.0f;
+    fromGateway("{\"command\":\"getData1\",\"nodeId\":1}");
+    EXPECT_TRUE(contains(lastTx(), "\"sensorId\":\"water2\""));
+    fromGateway("ok1");
+    EXPECT_EQ(lastTx(), "end");
+}
+
+TEST_F(NodeExchange, BatchFramesFollowTheChannels) {
+    node.sensor.batchLeft = 2;
+    fromGateway("{\"command\":\"getData1\",\"nodeId\":1}");
+    fromGateway("ok1");
+    fromGateway("ok1");
+    EXPECT_TRUE(contains(lastTx(), "\"batch\":2"));
+    fromGateway("ok1");
+    EXPECT_TRUE(contains(lastTx(), "\"batch\":1"));
+    fromGateway("ok1");
+    EXPECT_EQ(lastTx(), "end");
+    EXPECT_EQ(node.sensor.batchLeft, 0);
+}
+
+TEST_F(NodeExchange, StrayOkAndOtherNodesCommandsAreIgnored) {
+    uint32_t sent = LoRa.txPackets;
+    fromGateway("ok1");
+    fromGateway("{\"command\":\"getData2\",\"nodeId\":2}");
+    EXPECT_EQ(LoRa.txPackets, sent);
+    EXPECT_EQ(node.sensor.commits, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Alerts
+
+TEST_F(NodeExchange, AlertIsSentWithoutAPollAndRetriedUntilAcked) {
+    fromGateway("Hi");
+    node.sensor.alertWaiting = true;
+    node.loop();
+    std::string alert = lastTx();
+    ASSERT_TRUE(contains(alert, "\"alert\":\"leak\""));
+
+    uint32_t sent = LoRa.txPackets;
+    node.loop();
+    EXPECT_EQ(LoRa.txPackets, sent);
+
+    // Same frame, same seq, so the backend drops the copies
+    hostAdvanceMillis(ALERT_RETRY_MS);
+    node.loop();
+    EXPECT_EQ(LoRa.txPackets, sent + 1);
+    EXPECT_EQ(lastTx(), alert);
+
+    fromGateway("ak1");
+    hostAdvanceMillis(ALERT_RETRY_MS);
+    node.loop();
+    EXPECT_EQ(LoRa.txPackets, sent + 1);
+}
+
+TEST_F(NodeExchange, AlertIsDroppedAfterMaxAttempts) {
+    fromGateway("Hi");
+    node.sensor.alertWaiting = true;
+    uint32_t sent = LoRa.txPackets;
+    for (int i = 0; i < ALERT_MAX_ATTEMPTS + 3; i++) {
+        node.loop();
+        hostAdvanceMillis(ALERT_RETRY_MS);
+    }
+    EXPECT_EQ(LoRa.txPackets, sent + ALERT_MAX_ATTEMPTS);
+}
+
+TEST_F(NodeExchange, AlertWaitsForTheExchangeUntilItTimesOut) {
+    fromGateway("{\"command\":\"getData1\",\"nodeId\":1}");
+    uint32_t sent = LoRa.txPackets;
+    node.sensor.alertWaiting = true;
+    node.loop();
+    EXPECT_EQ(LoRa.txPackets, sent);
+
+    // ok1 never comes
+    hostAdvanceMillis(NODE_EXCHANGE_TIMEOUT_MS);
+    node.loop();
+    EXPECT_TRUE(contains(lastTx(), "\"alert\":\"leak\""));
+    EXPECT_EQ(node.sensor.commits, 0);
+}
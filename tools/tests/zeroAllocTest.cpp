@@ -0,0 +1,180 @@
+// Host test that the per-packet paths never touch the heap.
+//
+// Counts malloc/calloc/realloc (tools/bench/host/heapCount.h) around the
+// node's receive/dispatch/send path in NodeRuntime (a full poll exchange
+// plus the short commands) and the Gateway payload formatters of
+// dataPush.cpp, and asserts zero allocations per packet. When ArduinoJson
+// is on the include path it does the same for the Gateway's node frame
+// parsing into a JsonArena, and checks the arena's rewinding.
+//
+// Build and run (Linux host, GoogleTest installed):
+//   g++ -std=c++17 -I tools/bench/host tools/tests/zeroAllocTest.cpp -lgtest -lgtest_main -lpthread -o zeroAllocTest
+//   ./zeroAllocTest
+// Add -I <ArduinoJson>/src (v7, as the Gateway builds with) for the parsing
+// and JsonArena tests, or -I tools/bench/third_party after
+// sh tools/bench/fetchArduinoJson.sh.
+
+#include <gtest/gtest.h>
+
+#include "../../Common/nodeRuntime.h"
+#include "../../Gateway/payload.h"
+#include "../bench/host/heapCount.h"
+
+#if __has_include(<ArduinoJson.h>)
+#include "../../Common/jsonArena.h"
+#include "../../Gateway/nodeFrame.h"
+#define TEST_ARDUINOJSON 1
+#else
+#define TEST_ARDUINOJSON 0
+#endif
+
+static const int PACKETS = 200;
+static const uint32_t EPOCH = 1760000000;
+
+// Allocations made by fn(), which runs PACKETS packets
+template <class Fn>
+static uint64_t allocsOf(Fn fn) {
+    uint64_t before = allocCount;
+    fn();
+    return allocCount - before;
+}
+
+// ---------------------------------------------------------------------------
+// Node
+
+// Values swing past the deadband on every poll, so every poll sends both
+// channels and then "end"
+struct SwingSensor {
+    struct Alert {};
+    static const int CHANNELS = 2;
+    float values[CHANNELS] = {1234.5f, 87.25f};
+    float step = 1.5f;
+
+    void begin() {}
+    const char* id(int ch) const { return ch == 0 ? "water1" : "water2"; }
+    Deadband deadband(int) const { return {1.0f, 0.0f, 6 * 3600UL}; }
+    void sample(const NodeClock&) {
+        for (float& v : values) v += step;
+        step = -step;
+    }
+    float value(int ch) const { return values[ch]; }
+    uint32_t epoch(int) const { return EPOCH; }
+    int formatFields(char* out, size_t cap, int ch) const {
+        return snprintf(out, cap, "\"Water\":%.3f", values[ch]);
+    }
+    void commit() {}
+    bool takeAlert(Alert&) { return false; }
+    int formatAlert(char*, size_t, const Alert&) const { return 0; }
+    bool batchPending() const { return false; }
+    int formatBatch(char*, size_t) { return 0; }
+    void batchSent() {}
+    void historyValues(float* out) const { memcpy(out, values, sizeof(values)); }
+};
+
+static NodeRuntime<1, SwingSensor> node;
+
+static void toNode(const char* payload) {
+    LoRa.inject(1, GATEWAY_ADDR_FIRST, payload);
+    node.loop();
+}
+
+class NodeHeap : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() { node.begin(); }
+};
+
+TEST_F(NodeHeap, PollExchangeAllocatesNothing) {
+    uint32_t sent = LoRa.txPackets;
+    uint64_t allocs = allocsOf([] {
+        for (int i = 0; i < PACKETS; i++) {
+            toNode("{\"command\":\"getData1\",\"nodeId\":1,\"time\":1760000000}");
+            toNode("ok1");
+            toNode("ok1");
+        }
+    });
+    EXPECT_EQ(allocs, 0u);
+    EXPECT_EQ(LoRa.txPackets - sent, 3u * PACKETS);
+}
+
+TEST_F(NodeHeap, ShortCommandsAllocateNothing) {
+    uint64_t allocs = allocsOf([] {
+        for (int i = 0; i < PACKETS; i++) {
+            toNode("Hi");
+            toNode("getRSSI");
+            toNode("getDiag");
+            toNode("{\"command\":\"history\",\"since\":0,\"win\":0}");
+        }
+    });
+    EXPECT_EQ(allocs, 0u);
+}
+
+// ---------------------------------------------------------------------------
+// Gateway
+
+static const PayloadLink LINK = {"gw_10", -92, 4711};
+
+TEST(GatewayHeap, PayloadFormattersAllocateNothing) {
+    char buf[192];
+    size_t total = 0;
+    uint64_t allocs = allocsOf([&] {
+        for (int i = 0; i < PACKETS; i++) {
+            total += formatPayloadW(buf, sizeof(buf), "node_1", "water1", 1234.567f, EPOCH, &LINK);
+            total += formatPayloadE(buf, sizeof(buf), "node_2", "power1", 512.125f, 229.4f, EPOCH, &LINK);
+            total += formatPayloadRssi(buf, sizeof(buf), "node_1", -87, &LINK);
+            total += formatPayloadAlert(buf, sizeof(buf), "node_1", "water2", "continuous", 2.75f, 1260, EPOCH,
+                                        &LINK);
+        }
+    });
+    EXPECT_EQ(allocs, 0u);
+    EXPECT_GT(total, 0u);
+}
+
+#if TEST_ARDUINOJSON
+static JsonArena<> arena;
+
+TEST(GatewayHeap, FrameParsingAllocatesNothing) {
+    static const char water[] = "{\"nodeId\":1,\"sensorId\":\"water1\",\"Water\":1234.567,\"seq\":42,\"ts\":1760000000}";
+    static const char rssi[] = "{\"nodeId\":1,\"status\":\"online\",\"rssi\":-87}";
+    int failures = 0;
+    uint64_t allocs = allocsOf([&] {
+        for (int i = 0; i < PACKETS; i++) {
+            JsonDocument doc(&arena);
+            NodeReading reading;
+            failures += parseNodeReading(doc, MsgView{water, sizeof(water) - 1}, reading) ? 1 : 0;
+            JsonDocument doc2(&arena);
+            NodeRssi reply;
+            failures += parseNodeRssi(doc2, MsgView{rssi, sizeof(rssi) - 1}, reply) ? 1 : 0;
+        }
+    });
+    EXPECT_EQ(allocs, 0u);
+    EXPECT_EQ(failures, 0);
+    EXPECT_EQ(arena.used(), 0u);
+}
+
+TEST(JsonArenaTest, ReleasingTheTopRewindsOverReleasedBlocks) {
+    JsonArena<256> a;
+    void* first = a.allocate(10);
+    size_t withFirst = a.used();
+    void* second = a.allocate(20);
+    void* third = a.allocate(30);
+    size_t withThird = a.used();
+
+    // Below the top: nothing to rewind yet
+    a.deallocate(second);
+    EXPECT_EQ(a.used(), withThird);
+    a.deallocate(third);
+    EXPECT_EQ(a.used(), withFirst);
+    a.deallocate(first);
+    EXPECT_EQ(a.used(), 0u);
+}
+
+TEST(JsonArenaTest, TopBlockGrowsInPlace) {
+    JsonArena<256> a;
+    void* first = a.allocate(8);
+    void* grown = a.reallocate(first, 64);
+    EXPECT_EQ(grown, first);
+    EXPECT_EQ(a.allocate(1024), nullptr);
+    a.deallocate(grown);
+    EXPECT_EQ(a.used(), 0u);
+}
+#endif
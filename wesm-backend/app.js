@@ -13,14 +13,32 @@ dotenv.config();
 var connectDB = require("./config/db.js");
 connectDB();
 
+// Queries are buffered until the connection opens
+var { warmCache } = require("./services/latestCache");
+warmCache();
+
+// Optional MQTT uplink from the Gateway, alongside POST /stream_data
+if (process.env.MQTT_URL) {
+  var { startMqttIngest } = require("./services/mqttIngest");
+  startMqttIngest(process.env.MQTT_URL);
+}
+
 const indexRouter = require("./routes/index");
 const streamDataRouter = require("./routes/stream_data");
 // const getOldWaterRouter = require('./routes/getOldWater');
 // const getOldElectricRouter = require('./routes/getOldElectric');
 const getDataRouter = require("./routes/getData");
 const getDataRangeRouter = require("./routes/getDataRange");
+const getDataBatchRouter = require("./routes/getDataBatch");
+const liveRouter = require("./routes/live");
+const getSensorStatusRouter = require("./routes/getSensorStatus");
+const getPowerQualityRouter = require("./routes/getPowerQuality");
+const exportDataRouter = require("./routes/exportData");
 const populateDataRouter = require("./routes/populateElecData");
 const populateWaterRouter = require("./routes/populateWaterData");
+const metricsRouter = require("./routes/metrics");
+const populateRollupRouter = require("./routes/populateRollup");
+const populateBucketsRouter = require("./routes/populateBuckets");
 
 var app = express();
 
@@ -39,9 +57,17 @@ app.use("/", indexRouter);
 app.use("/stream_data", streamDataRouter);
 app.use("/api/get", getDataRouter);
 app.use("/api/get/range", getDataRangeRouter);
+app.use("/api/get/batch", getDataBatchRouter);
+app.use("/api/get/live", liveRouter);
+app.use("/api/get/status", getSensorStatusRouter);
+app.use("/api/get/pq", getPowerQualityRouter);
+app.use("/api/export", exportDataRouter);
 app.use("/static", express.static(path.join(__dirname, "public")));
 app.use("/populate/elec", populateDataRouter);
 app.use("/populate/water", populateWaterRouter);
+app.use("/populate/rollup", populateRollupRouter);
+app.use("/populate/buckets", populateBucketsRouter);
+app.use("/metrics", metricsRouter);
 
 // catch 404 and forward to error handler
 app.use(function (req, res, next) {
@@ -0,0 +1,17 @@
+var mongoose = require('mongoose');
+
+// Leak/anomaly alerts raised on the nodes and forwarded by the Gateway
+const alertSchema = mongoose.Schema({
+    node_id: String,
+    sensor_id: String,
+    alert: String,      // continuous | baseline | burst
+    lpm: Number,        // litres per minute at detection
+    dur: Number,        // seconds the condition had lasted
+    timestamp: Date,
+    gateway: String,    // Gateway whose copy was kept (best RSSI)
+    gw_rssi: Number,
+});
+alertSchema.index({ sensor_id: 1, timestamp: -1 });
+const alertModel = mongoose.model('alert', alertSchema);
+
+module.exports = alertModel;
@@ -0,0 +1,29 @@
+var mongoose = require('mongoose');
+
+// Raw readings packed per sensor and time bucket (services/buckets.js).
+// Replaces one document per reading in node_1, node_2 and rssi: a range
+// query reads one document per bucket instead of one per sample.
+const sampleSchema = mongoose.Schema({
+    o: Number,          // ms from bucket start
+    v: Number,          // water, power or rssi
+    u: Number,          // voltage (elec only)
+    g: String,          // Gateway whose copy was kept (best RSSI)
+    r: Number,          // its gw_rssi
+}, { _id: false });
+
+const bucketSchema = mongoose.Schema({
+    type: String,           // "water" | "elec" | "rssi"
+    sensor_id: String,      // series key; the node_id for "rssi"
+    node_id: String,
+    bucket: Date,           // start of the bucket, GMT+7 like the readings
+    count: Number,          // samples in s, capped (a full bucket continues in a new document)
+    min: Number,
+    max: Number,
+    first_ts: Date,
+    last_ts: Date,
+    s: [sampleSchema],      // in arrival order, not necessarily by time
+});
+bucketSchema.index({ type: 1, sensor_id: 1, bucket: -1 });
+const bucketModel = mongoose.model('reading_bucket', bucketSchema);
+
+module.exports = bucketModel;
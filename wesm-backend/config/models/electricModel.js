@@ -5,8 +5,13 @@ const electricSchema = mongoose.Schema({
     node_id: String,
     timestamp: Date,
     power: Number,
-    voltage: Number
+    voltage: Number,
+    gateway: String,    // Gateway whose copy was kept (best RSSI)
+    gw_rssi: Number,
 });
+// Legacy layout, one document per reading: new readings go to bucketModel
+// and this collection is only read by the migration (/populate/buckets)
+electricSchema.index({ sensor_id: 1, timestamp: -1 });
 const electricModel = mongoose.model('node_2', electricSchema);
 
 module.exports = electricModel;
\ No newline at end of file
@@ -0,0 +1,15 @@
+var mongoose = require('mongoose');
+
+const metricsSchema = mongoose.Schema({
+    gateway_id: String,
+    node_id: String,        // set on node diagnostics, forwarded by gateway_id
+    timestamp: Date,
+    uptime_s: Number,
+    counters: mongoose.Schema.Types.Mixed,
+    gauges: mongoose.Schema.Types.Mixed,
+    hist: mongoose.Schema.Types.Mixed,
+    diag: mongoose.Schema.Types.Mixed   // stacks, heap, loop time (Common/diag.h)
+});
+const metricsModel = mongoose.model('gateway_metrics', metricsSchema);
+
+module.exports = metricsModel;
@@ -0,0 +1,23 @@
+var mongoose = require('mongoose');
+
+// One power-quality interval of a Node2 channel (Node2/powerQuality.h)
+const powerQualitySchema = mongoose.Schema({
+    sensor_id: String,
+    node_id: String,
+    timestamp: Date,    // interval start, GMT+7 like the reading collections
+    interval_s: Number,
+    v_mean: Number,     // V
+    v_min: Number,
+    v_max: Number,
+    p_mean: Number,     // W
+    p_peak: Number,
+    wh: Number,         // energy used in the interval
+    tariff: String,     // normal | peak | offpeak
+    gateway: String,    // Gateway whose copy was stored
+    gw_rssi: Number,
+});
+// A batch resent after a lost ack overwrites the same intervals
+powerQualitySchema.index({ sensor_id: 1, timestamp: 1 }, { unique: true });
+const powerQualityModel = mongoose.model('power_quality', powerQualitySchema);
+
+module.exports = powerQualityModel;
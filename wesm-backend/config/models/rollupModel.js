@@ -0,0 +1,24 @@
+var mongoose = require('mongoose');
+
+// Hourly/daily summaries of water and electricity readings, maintained at
+// ingest. Readings are cumulative meter values, so "last" is the meter value
+// at the end of the bucket and "first" the one at its start.
+const rollupSchema = mongoose.Schema({
+    type: String,           // "water" | "elec"
+    sensor_id: String,
+    node_id: String,
+    granularity: String,    // "hour" | "day"
+    bucket: Date,           // start of the bucket
+    count: Number,
+    sum: Number,
+    min: Number,
+    max: Number,
+    first: Number,
+    first_ts: Date,
+    last: Number,
+    last_ts: Date
+});
+rollupSchema.index({ type: 1, sensor_id: 1, granularity: 1, bucket: 1 }, { unique: true });
+const rollupModel = mongoose.model('rollup', rollupSchema);
+
+module.exports = rollupModel;
@@ -4,7 +4,12 @@ const rssiSchema = mongoose.Schema({
     node_id: String,
     rssi: Number,
     timestamp: Date,
+    gateway: String,    // Gateway that asked; rssi is what the node heard from it
+    gw_rssi: Number,
 });
+// Legacy layout, one document per reading: new readings go to bucketModel
+// and this collection is only read by the migration (/populate/buckets)
+rssiSchema.index({ node_id: 1, timestamp: -1 });
 const rssiModel = mongoose.model('rssi', rssiSchema);
 
 module.exports = rssiModel;
\ No newline at end of file
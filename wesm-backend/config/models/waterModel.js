@@ -4,8 +4,13 @@ const waterSchema = mongoose.Schema({
     sensor_id: String,
     node_id: String,
     timestamp: Date,
-    water: Number
+    water: Number,
+    gateway: String,    // Gateway whose copy was kept (best RSSI)
+    gw_rssi: Number,
 });
+// Legacy layout, one document per reading: new readings go to bucketModel
+// and this collection is only read by the migration (/populate/buckets)
+waterSchema.index({ sensor_id: 1, timestamp: -1 });
 const waterModel = mongoose.model('node_1', waterSchema);
 
 module.exports = waterModel;
\ No newline at end of file
@@ -0,0 +1,147 @@
+var express = require("express");
+var router = express.Router();
+
+var rollupModel = require("../config/models/rollupModel");
+var { TYPES, GRANULARITY_MS } = require("../services/rollup");
+var { SERIES, readingsInRange } = require("../services/buckets");
+var { streamLines } = require("../services/stream");
+
+const MAX_SENSORS = 200;
+
+// Bulk export of raw readings or hourly/daily rollups of many sensors over
+// any time range, streamed as NDJSON or CSV straight from Mongo cursors, one
+// sensor after the other, so memory stays flat however long the range is.
+// Responses are gzip-compressed for clients that send Accept-Encoding: gzip.
+//
+// GET /api/export?type=water&sensors=water1,water2&start=2025-01-01&end=2025-03-31
+//     [&granularity=raw|hour|day][&format=ndjson|csv]
+// start/end are yyyy-mm-dd (whole days) or ISO timestamps, in the stored
+// GMT+7 time like every other route.
+const COLUMNS = {
+  raw: (field, extra) => ["sensor_id", "node_id", "timestamp", field].concat(extra ? [extra] : []),
+  rollup: (field) => ["sensor_id", "node_id", "granularity", "bucket", "count", "sum", "min", "max", "timestamp", field],
+};
+
+function parseTime(value, endOfDay) {
+  if (typeof value !== "string") throw new Error("start or end missing.");
+  if (/^\d{4}-\d{2}-\d{2}$/.test(value)) {
+    const date = new Date(value + "T00:00:00.000Z");
+    if (endOfDay) date.setUTCHours(23, 59, 59, 999);
+    if (!isNaN(date.getTime())) return date;
+  } else {
+    const date = new Date(value);
+    if (!isNaN(date.getTime())) return date;
+  }
+  throw new Error("Invalid date '" + value + "'. Use yyyy-mm-dd or an ISO timestamp");
+}
+
+function csvCell(value) {
+  if (value === undefined || value === null) return "";
+  const text = value instanceof Date ? value.toISOString() : String(value);
+  return /[",\n]/.test(text) ? '"' + text.replace(/"/g, '""') + '"' : text;
+}
+
+async function* rawRows(type, sensors, start, end) {
+  for (const sensorId of sensors) {
+    yield* readingsInRange(type, sensorId, start, end);
+  }
+}
+
+// Rollups in the shape of /api/get/range: the bucket's last reading, plus
+// the bucket summary
+async function* rollupRows(type, sensors, granularity, start, end) {
+  const { field } = TYPES[type];
+  for (const sensorId of sensors) {
+    const cursor = rollupModel
+      .find({ type: type, sensor_id: sensorId, granularity: granularity, bucket: { $gte: start, $lte: end } })
+      .select({ _id: 0, sensor_id: 1, node_id: 1, bucket: 1, count: 1, sum: 1, min: 1, max: 1, last: 1, last_ts: 1 })
+      .sort({ bucket: 1 })
+      .lean()
+      .cursor();
+    for await (const doc of cursor) {
+      yield {
+        sensor_id: doc.sensor_id,
+        node_id: doc.node_id,
+        granularity: granularity,
+        bucket: doc.bucket,
+        count: doc.count,
+        sum: doc.sum,
+        min: doc.min,
+        max: doc.max,
+        timestamp: doc.last_ts,
+        [field]: doc.last,
+      };
+    }
+  }
+}
+
+async function* ndjsonLines(rows) {
+  for await (const row of rows) yield JSON.stringify(row) + "\n";
+}
+
+async function* csvLines(rows, columns) {
+  yield columns.join(",") + "\n";
+  for await (const row of rows) yield columns.map((c) => csvCell(row[c])).join(",") + "\n";
+}
+
+// Route GET: see above
+router.get("/", async (req, res) => {
+  var { type, sensors, start, end, granularity = "raw", format = "ndjson" } = req.query;
+
+  if (!TYPES[type]) {
+    res.status(404).send("Invalid 'type' value.");
+    return;
+  }
+  const sensorIds = typeof sensors === "string" ? sensors.split(",").filter(Boolean) : [];
+  if (sensorIds.length === 0 || sensorIds.length > MAX_SENSORS) {
+    res.status(400).send("'sensors' must list between 1 and " + MAX_SENSORS + " sensors.");
+    return;
+  }
+  if (granularity !== "raw" && !GRANULARITY_MS[granularity]) {
+    res.status(400).send("'granularity' must be raw, hour or day.");
+    return;
+  }
+  if (format !== "ndjson" && format !== "csv") {
+    res.status(400).send("'format' must be ndjson or csv.");
+    return;
+  }
+
+  let startDate, endDate;
+  try {
+    startDate = parseTime(start, false);
+    endDate = parseTime(end, true);
+  } catch (error) {
+    res.status(400).send(error.message);
+    return;
+  }
+
+  const { field, extra } = SERIES[type];
+  const rows =
+    granularity === "raw"
+      ? rawRows(type, sensorIds, startDate, endDate)
+      : rollupRows(type, sensorIds, granularity, startDate, endDate);
+  const lines =
+    format === "csv"
+      ? csvLines(rows, granularity === "raw" ? COLUMNS.raw(field, extra) : COLUMNS.rollup(field))
+      : ndjsonLines(rows);
+
+  res.type(format === "csv" ? "text/csv" : "application/x-ndjson");
+  res.set("Content-Disposition", `attachment; filename="${type}-${granularity}.${format}"`);
+  res.vary("Accept-Encoding");
+
+  try {
+    await streamLines(res, lines, /\bgzip\b/.test(req.get("Accept-Encoding") || ""));
+  } catch (error) {
+    // A client that stops reading midway is not an error worth logging
+    if (error.code !== "ERR_STREAM_PREMATURE_CLOSE") {
+      console.error("Error while exporting data: ", error);
+    }
+    if (!res.headersSent) {
+      res.status(500).json("Error while querying.");
+    } else {
+      res.destroy();
+    }
+  }
+});
+
+module.exports = router;
@@ -1,8 +1,7 @@
 var express = require("express");
 var router = express.Router();
 
-var electricModel = require("../config/models/electricModel");
-var waterModel = require("../config/models/waterModel");
+var { getLatest } = require("../services/latestCache");
 
 function convertToUTCDate(dateString) {
   try {
@@ -28,47 +27,25 @@ function convertToUTCDate(dateString) {
 
 router.get("/", async (req, res) => {
   var { type, sensor_id, date = undefined } = req.query;
-  var model;
-  console.log(date);
 
-  if (type == "elec") {
-    model = electricModel;
-  } else if (type == "water") {
-    model = waterModel;
-  } else {
+  if (type != "elec" && type != "water") {
     res.status(404).send("Invalid 'type' value.");
     return;
   }
 
   try {
-    var reqDate = new Date();
-    var startDate = new Date();
-    var endDate = new Date();
-
+    // Without a date this is "latest reading", served from the cache
+    var endDate;
     if (date !== undefined) {
-      reqDate = convertToUTCDate(date);
+      var reqDate = convertToUTCDate(date);
       endDate = new Date(reqDate.setHours(23, 59, 59, 999));
-    } else {
-      endDate = new Date(endDate.setFullYear(2077)); // OMG IS THAT A CYBERPUNK REFERENCE???????????
     }
 
-    var result = await model
-      .find({
-        sensor_id: sensor_id,
-        timestamp: { $lt: endDate },
-      })
-      .sort({ timestamp: -1 })
-      .limit(1)
-      .exec();
-
-    if (result) {
-      console.log(result);
-      res.json(result);
-    } else {
-      console.error("Unable to reach database");
-    }
+    var result = await getLatest(type, sensor_id, endDate);
+    res.json(result ? [result] : []);
   } catch (error) {
     console.error("Error while retrieving data from database: ", error.message);
+    res.status(500).json("Error while querying.");
   }
 });
 
@@ -0,0 +1,154 @@
+var express = require("express");
+var router = express.Router();
+
+var rollupModel = require("../config/models/rollupModel");
+var { TYPES, GRANULARITY_MS } = require("../services/rollup");
+
+const DAY_MS = GRANULARITY_MS.day;
+const MAX_SENSORS = 200;
+const MAX_DAYS = 366;
+
+function convertToUTCDate(dateString) {
+  const regex = /^\d{4}-\d{2}-\d{2}$/;
+  if (typeof dateString !== "string" || !regex.test(dateString)) {
+    throw new Error("Invalid date format. Use yyyy-mm-dd");
+  }
+
+  const [year, month, day] = dateString.split("-");
+  const date = new Date(Date.UTC(year, month - 1, day));
+
+  if (isNaN(date.getTime())) {
+    throw new Error("Invalid date");
+  }
+
+  return date;
+}
+
+// { _id: {type, sensor_id}, value, timestamp }[] -> { elec: { power1: {value, timestamp} }, water: {...} }
+function groupBySensor(rows) {
+  const result = {};
+  for (const type of Object.keys(TYPES)) result[type] = {};
+  for (const row of rows) {
+    result[row._id.type][row._id.sensor_id] = { value: row.value, timestamp: row.timestamp };
+  }
+  return result;
+}
+
+const LAST_PER_SENSOR = {
+  $group: {
+    _id: { type: "$type", sensor_id: "$sensor_id" },
+    value: { $last: "$last" },
+    timestamp: { $last: "$last_ts" },
+  },
+};
+
+// Route POST: latest values (now and at the end of given dates) and per-day
+// usage deltas for many sensors, answered by one aggregation over the daily
+// rollups.
+// Body: { sensors: { elec: ["power1", ...], water: ["water1", ...] },
+//         dates: ["yyyy-mm-dd", ...], start_date?: "yyyy-mm-dd", end_date?: "yyyy-mm-dd" }
+router.post("/", async (req, res) => {
+  var { sensors = {}, dates = [], start_date, end_date } = req.body ?? {};
+
+  var sensorFilters = [];
+  var sensorCount = 0;
+  for (const type of Object.keys(sensors)) {
+    if (!TYPES[type] || !Array.isArray(sensors[type])) {
+      res.status(404).send("Invalid 'type' value.");
+      return;
+    }
+    sensorCount += sensors[type].length;
+    sensorFilters.push({ type: type, sensor_id: { $in: sensors[type].map(String) } });
+  }
+  if (sensorCount === 0 || sensorCount > MAX_SENSORS || !Array.isArray(dates)) {
+    res.status(400).send("'sensors' must list between 1 and " + MAX_SENSORS + " sensors.");
+    return;
+  }
+
+  var dateBuckets, startDate, endDate, dayCount = 0;
+  try {
+    dateBuckets = dates.map(convertToUTCDate);
+    if (start_date !== undefined && end_date !== undefined) {
+      startDate = convertToUTCDate(start_date);
+      endDate = convertToUTCDate(end_date);
+      dayCount = Math.round((endDate - startDate) / DAY_MS) + 1;
+      if (dayCount < 1 || dayCount > MAX_DAYS) {
+        throw new Error("Invalid date range");
+      }
+    }
+  } catch (error) {
+    res.status(400).send(error.message);
+    return;
+  }
+
+  try {
+    // A reading at or before the end of day D lives in a daily bucket <= D
+    var facets = {
+      latest: [LAST_PER_SENSOR],
+    };
+    dateBuckets.forEach((bucket, i) => {
+      facets[`at_${i}`] = [{ $match: { bucket: { $lte: bucket } } }, LAST_PER_SENSOR];
+    });
+
+    if (dayCount > 0) {
+      facets.baseline = [{ $match: { bucket: { $lt: startDate } } }, LAST_PER_SENSOR];
+      facets.days = [
+        { $match: { bucket: { $gte: startDate, $lte: endDate } } },
+        { $project: { _id: 0, type: 1, sensor_id: 1, bucket: 1, first: 1, last: 1 } },
+      ];
+    }
+
+    var [result] = await rollupModel
+      .aggregate([
+        { $match: { $or: sensorFilters, granularity: "day" } },
+        { $sort: { bucket: 1 } },
+        { $facet: facets },
+      ])
+      .exec();
+
+    var response = { latest: groupBySensor(result.latest), at: {} };
+    dates.forEach((date, i) => {
+      response.at[date] = groupBySensor(result[`at_${i}`]);
+    });
+
+    if (dayCount > 0) {
+      // Readings are cumulative: usage on a day is its last reading minus the
+      // previous known reading (or the day's first reading if there is none).
+      var baseline = groupBySensor(result.baseline);
+      var byDay = {};
+      for (const row of result.days) {
+        byDay[`${row.type}|${row.sensor_id}|${row.bucket.getTime()}`] = row;
+      }
+
+      var daily = { days: [] };
+      for (let d = 0; d < dayCount; d++) {
+        daily.days.push(new Date(startDate.getTime() + d * DAY_MS).toISOString().slice(0, 10));
+      }
+      for (const type of Object.keys(sensors)) {
+        daily[type] = {};
+        for (const sensorId of sensors[type]) {
+          var prev = baseline[type][sensorId]?.value ?? null;
+          var deltas = [];
+          for (let d = 0; d < dayCount; d++) {
+            var row = byDay[`${type}|${sensorId}|${startDate.getTime() + d * DAY_MS}`];
+            if (row) {
+              deltas.push(row.last - (prev ?? row.first));
+              prev = row.last;
+            } else {
+              deltas.push(0);
+            }
+          }
+          daily[type][sensorId] = deltas;
+        }
+      }
+      response.daily = daily;
+    }
+
+    res.json(response);
+  } catch (error) {
+    console.error("Error while retrieving batch data from database: ", error);
+    res.status(500).json("Error while querying.");
+  }
+});
+
+module.exports = router;
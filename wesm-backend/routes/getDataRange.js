@@ -1,8 +1,10 @@
 var express = require("express");
 var router = express.Router();
 
-var electricModel = require("../config/models/electricModel");
-var waterModel = require("../config/models/waterModel");
+var rollupModel = require("../config/models/rollupModel");
+var { TYPES, pickGranularity } = require("../services/rollup");
+var { streamJsonArray } = require("../services/stream");
+var { readingsInRange } = require("../services/buckets");
 
 function convertToUTCDate(dateString) {
   try {
@@ -27,22 +29,18 @@ function convertToUTCDate(dateString) {
 }
 
 router.get("/", async (req, res) => {
-  var { type, sensor_id, start_date, end_date } = req.query;
+  var { type, sensor_id, start_date, end_date, granularity = "auto" } = req.query;
   
   if (start_date === undefined || end_date === undefined) {
     res.json('start_date or end_date missing.');
     return;
   }
 
-  var model;
-  if (type == "elec") {
-    model = electricModel;
-  } else if (type == "water") {
-    model = waterModel;
-  } else {
+  if (!TYPES[type]) {
     res.status(404).send("Invalid 'type' value.");
     return;
   }
+  var { field } = TYPES[type];
 
   try {
     let startDate = convertToUTCDate(start_date);
@@ -51,23 +49,50 @@ router.get("/", async (req, res) => {
     startDate = new Date(startDate.setUTCHours(0,0,0,0));
     endDate = new Date(endDate.setUTCHours(23,59,59,999));
 
-    let results = await model
-      .find({
-        sensor_id: sensor_id,
-        timestamp: { $gte: startDate, $lte: endDate },
-      })
-      .exec();
-    
-    if (results) {
-      for (let i = 0; i < results.length; i++) {
-        console.log(`${results[i].timestamp.toISOString()}: ${results[i].power ?? results[i].water}`);
-      }
-      res.json(results);
-    } else {
-      console.error('Unable to get data from database.');
+    // Answer from the coarsest rollup that tiles the window. Readings are
+    // cumulative, so a bucket is reported as its last reading, in the same
+    // shape as a raw document plus the bucket summary.
+    if (granularity === "auto") {
+      granularity = pickGranularity(startDate, endDate);
+    }
+
+    if (granularity === "hour" || granularity === "day") {
+      const cursor = rollupModel
+        .find({
+          type: type,
+          sensor_id: sensor_id,
+          granularity: granularity,
+          bucket: { $gte: startDate, $lte: endDate },
+        })
+        .select({ _id: 0, sensor_id: 1, node_id: 1, bucket: 1, count: 1, sum: 1, min: 1, max: 1, last: 1, last_ts: 1 })
+        .sort({ bucket: 1 })
+        .lean()
+        .cursor();
+
+      await streamJsonArray(res, cursor, (doc) => ({
+        sensor_id: doc.sensor_id,
+        node_id: doc.node_id,
+        timestamp: doc.last_ts,
+        [field]: doc.last,
+        granularity: granularity,
+        bucket: doc.bucket,
+        count: doc.count,
+        sum: doc.sum,
+        min: doc.min,
+        max: doc.max,
+      }));
+      return;
     }
+
+    // Raw readings, unpacked from one bucket document per sensor and day
+    await streamJsonArray(res, readingsInRange(type, sensor_id, startDate, endDate));
   } catch (error) {
     console.error("Error while retrieving data from database: ", error);
+    if (!res.headersSent) {
+      res.status(500).json("Error while querying.");
+    } else {
+      res.end();
+    }
   }
 });
 
@@ -0,0 +1,75 @@
+var express = require("express");
+var router = express.Router();
+
+var powerQualityModel = require("../config/models/powerQualityModel");
+var { summarizePowerQuality } = require("../services/powerQuality");
+var { streamJsonArray } = require("../services/stream");
+
+function convertToUTCDate(dateString) {
+  const regex = /^\d{4}-\d{2}-\d{2}$/;
+  if (!regex.test(dateString)) {
+    throw new Error("Invalid date format. Use yyyy-mm-dd");
+  }
+  const [year, month, day] = dateString.split("-");
+  const date = new Date(Date.UTC(year, month - 1, day));
+  if (isNaN(date.getTime())) {
+    throw new Error("Invalid date");
+  }
+  return date;
+}
+
+// Whole days [start_date, end_date], or null after answering 400
+function parseWindow(req, res) {
+  var { sensor_id, start_date, end_date } = req.query;
+  if (!sensor_id || start_date === undefined || end_date === undefined) {
+    res.status(400).json("sensor_id, start_date or end_date missing.");
+    return null;
+  }
+  try {
+    const start = convertToUTCDate(start_date);
+    const end = convertToUTCDate(end_date);
+    end.setUTCHours(23, 59, 59, 999);
+    return { sensor_id, start, end };
+  } catch (error) {
+    res.status(400).json(error.message);
+    return null;
+  }
+}
+
+// Route GET: power-quality intervals of a sensor, oldest first
+router.get("/", async (req, res) => {
+  const window = parseWindow(req, res);
+  if (!window) return;
+
+  try {
+    const cursor = powerQualityModel
+      .find({ sensor_id: window.sensor_id, timestamp: { $gte: window.start, $lte: window.end } })
+      .select({ _id: 0, __v: 0, gateway: 0, gw_rssi: 0 })
+      .sort({ timestamp: 1 })
+      .lean()
+      .cursor();
+    await streamJsonArray(res, cursor);
+  } catch (error) {
+    console.error("Error while retrieving power-quality intervals: ", error);
+    if (!res.headersSent) {
+      res.status(500).json("Error while querying.");
+    } else {
+      res.end();
+    }
+  }
+});
+
+// Route GET: energy per tariff window, peak demand and voltage extremes
+router.get("/summary", async (req, res) => {
+  const window = parseWindow(req, res);
+  if (!window) return;
+
+  try {
+    res.json(await summarizePowerQuality(window.sensor_id, window.start, window.end));
+  } catch (error) {
+    console.error("Error while summarizing power quality: ", error);
+    res.status(500).json("Error while querying.");
+  }
+});
+
+module.exports = router;
@@ -1,27 +1,19 @@
 var express = require("express");
 var router = express.Router();
 
-var rssiModel = require("../config/models/rssiModel");
+var { getRssi, cacheStats } = require("../services/latestCache");
+var { linkTable } = require("../services/gatewayLinks");
+var { dedupStats } = require("../services/dedup");
 
 router.get("/", async (req, res) => {
   var { node_id = undefined } = req.query;
-  var model = rssiModel;
   try {
     if (node_id) {
-        var data = await model
-          .find({
-            node_id: node_id,
-          })
-          .sort({ timestamp: -1 })
-          .limit(1)
-          .exec();
-        if (data) {
-          res.json(data[0].rssi);
-        } else {
-          console.error("Unable to reach database: ");
-        }
+        var data = await getRssi(node_id);
+        res.json(data ? data.rssi : null);
     } else {
         console.error("Invalid node_id");
+        res.status(400).json("Invalid node_id");
     }
   } catch (error) {
     console.error("Error while fetching sensor status: ", error);
@@ -29,4 +21,15 @@ router.get("/", async (req, res) => {
   }
 });
 
+// Route GET: hit/miss counters of the latest-value cache
+router.get("/cache", (req, res) => {
+  res.json(cacheStats());
+});
+
+// Route GET: serving gateway and per-gateway RSSI of every node, plus
+// multi-gateway deduplication counters
+router.get("/links", (req, res) => {
+  res.json({ nodes: linkTable(), dedup: dedupStats() });
+});
+
 module.exports = router;
\ No newline at end of file
@@ -0,0 +1,60 @@
+var express = require("express");
+var router = express.Router();
+
+var { subscribe } = require("../services/liveBus");
+
+const HEARTBEAT_MS = 25000;
+
+// Route GET: Server-Sent Events stream of new readings. When a client falls
+// behind (socket buffer full), updates are coalesced to the newest one per
+// sensor and flushed on 'drain', so a slow client never grows the backlog.
+router.get("/", (req, res) => {
+  res.set({
+    "Content-Type": "text/event-stream",
+    "Cache-Control": "no-cache",
+    Connection: "keep-alive",
+  });
+  res.flushHeaders();
+  res.write("retry: 5000\n\n");
+
+  const pending = new Map();
+  let blocked = false;
+
+  const send = (update) => res.write(`event: reading\ndata: ${JSON.stringify(update)}\n\n`);
+
+  const onReading = (update) => {
+    if (blocked) {
+      pending.set(`${update.t}|${update.s}`, update);
+      return;
+    }
+    blocked = !send(update);
+  };
+
+  res.on("drain", () => {
+    blocked = false;
+    for (const [key, update] of pending) {
+      pending.delete(key);
+      if (!send(update)) {
+        blocked = true;
+        break;
+      }
+    }
+  });
+
+  const heartbeat = setInterval(() => {
+    if (!blocked) res.write(": ping\n\n");
+  }, HEARTBEAT_MS);
+
+  // Alerts are rare and must not be coalesced away: always written
+  const onAlert = (alert) => res.write(`event: alert\ndata: ${JSON.stringify(alert)}\n\n`);
+
+  const unsubscribe = subscribe(onReading);
+  const unsubscribeAlerts = subscribe(onAlert, "alert");
+  req.on("close", () => {
+    clearInterval(heartbeat);
+    unsubscribe();
+    unsubscribeAlerts();
+  });
+});
+
+module.exports = router;
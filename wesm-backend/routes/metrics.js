@@ -0,0 +1,43 @@
+var express = require("express");
+var router = express.Router();
+
+var metricsModel = require("../config/models/metricsModel");
+
+// Route POST: Gateway pushes a metrics snapshot periodically
+router.post("/", async (req, res) => {
+  const data = req.body;
+
+  if (!data["gateway_id"]) {
+    return res.status(400).send("'gateway_id' missing.");
+  }
+
+  try {
+    await new metricsModel({ ...data, timestamp: new Date() }).save();
+    res.status(200).send("OK");
+  } catch (error) {
+    console.error("Error while saving gateway metrics: ", error);
+    res.status(500).send("Error while saving metrics.");
+  }
+});
+
+// Route GET: latest snapshot of a gateway, or with ?node_id= the latest
+// diagnostics of that node (through whichever gateway forwarded it)
+router.get("/", async (req, res) => {
+  var { gateway_id = "gw_10", node_id } = req.query;
+  var filter = node_id ? { node_id: node_id } : { gateway_id: gateway_id, node_id: { $exists: false } };
+
+  try {
+    var result = await metricsModel
+      .find(filter)
+      .sort({ timestamp: -1 })
+      .limit(1)
+      .lean()
+      .exec();
+    res.json(result[0] ?? null);
+  } catch (error) {
+    console.error("Error while retrieving gateway metrics: ", error);
+    res.status(500).json("Error while querying.");
+  }
+});
+
+module.exports = router;
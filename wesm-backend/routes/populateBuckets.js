@@ -0,0 +1,33 @@
+var express = require("express");
+var router = express.Router();
+var { SERIES, migrateLegacy } = require("../services/buckets");
+var { TYPES, rebuildRollups } = require("../services/rollup");
+var { warmCache } = require("../services/latestCache");
+
+// Move readings from the legacy one-document-per-reading collections (node_1,
+// node_2, rssi) into buckets, then rebuild the rollups and the latest-value
+// cache from them. Safe to call again; already moved documents are skipped.
+router.get("/", async (req, res) => {
+  var { type = undefined } = req.query;
+  var types = type ? [type] : Object.keys(SERIES);
+
+  if (!types.every((t) => SERIES[t])) {
+    res.status(404).send("Invalid 'type' value.");
+    return;
+  }
+
+  try {
+    var result = {};
+    for (const t of types) {
+      result[t] = await migrateLegacy(t);
+      if (TYPES[t]) await rebuildRollups(t);
+    }
+    await warmCache();
+    res.json(result);
+  } catch (err) {
+    console.error("Error migrating readings to buckets: ", err);
+    res.status(500).json("Unable to migrate readings.");
+  }
+});
+
+module.exports = router;
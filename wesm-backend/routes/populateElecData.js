@@ -1,6 +1,7 @@
 var express = require("express");
 var router = express.Router();
-const electricModel = require("../config/models/electricModel");
+const { appendReadings } = require("../services/buckets");
+const { recordReading } = require("../services/latestCache");
 
 async function populateData(sensorId) {
   try {
@@ -26,14 +27,15 @@ async function populateData(sensorId) {
         sensor_id: sensorId,
         node_id: "node_2",
         timestamp: date,
-        power: powerValues[day],
+        power: Number(powerValues[day]),
         voltage: 220,
       };
       documents.push(doc);
     }
 
     // Insert all documents into the database
-    await electricModel.insertMany(documents);
+    await appendReadings("elec", documents);
+    recordReading("elec", documents[documents.length - 1]);
     console.log(`Data inserted successfully for ${sensorId}`);
   } catch (err) {
     console.error("Error inserting data", err);
@@ -0,0 +1,27 @@
+var express = require("express");
+var router = express.Router();
+var { TYPES, rebuildRollups } = require("../services/rollup");
+
+// Rebuild hourly/daily rollups from the reading buckets, e.g. after
+// /populate/elec or /populate/water, which bypass the ingest path.
+router.get("/", async (req, res) => {
+  var { type = undefined } = req.query;
+  var types = type ? [type] : Object.keys(TYPES);
+
+  if (!types.every((t) => TYPES[t])) {
+    res.status(404).send("Invalid 'type' value.");
+    return;
+  }
+
+  try {
+    for (const t of types) {
+      await rebuildRollups(t);
+    }
+    res.json("Rollups rebuilt successfully.");
+  } catch (err) {
+    console.error("Error rebuilding rollups: ", err);
+    res.status(500).json("Unable to rebuild rollups.");
+  }
+});
+
+module.exports = router;
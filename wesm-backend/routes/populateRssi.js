@@ -1,6 +1,6 @@
 var express = require("express");
 var router = express.Router();
-const rssiModel = require("../config/models/rssiModel");
+const { appendReadings } = require("../services/buckets");
 
 async function populateRssi(nodeId) {
   try {
@@ -29,7 +29,7 @@ async function populateRssi(nodeId) {
     }
 
     // Insert all documents into the database
-    await rssiModel.insertMany(documents);
+    await appendReadings("rssi", documents);
     console.log(`Data inserted successfully for ${nodeId}`);
   } catch (err) {
     console.error("Error inserting data: ", err);
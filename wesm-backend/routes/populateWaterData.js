@@ -1,6 +1,7 @@
 var express = require("express");
 var router = express.Router();
-const waterModel = require("../config/models/waterModel");
+const { appendReadings } = require("../services/buckets");
+const { recordReading } = require("../services/latestCache");
 
 async function populateData(sensorId) {
   try {
@@ -26,13 +27,14 @@ async function populateData(sensorId) {
         sensor_id: sensorId,
         node_id: "node_1",
         timestamp: date,
-        water: waterValues[day],
+        water: Number(waterValues[day]),
       };
       documents.push(doc);
     }
 
     // Insert all documents into the database
-    await waterModel.insertMany(documents);
+    await appendReadings("water", documents);
+    recordReading("water", documents[documents.length - 1]);
     console.log(`Data inserted successfully to ${sensorId}`);
   } catch (err) {
     console.error("Error inserting data", err);
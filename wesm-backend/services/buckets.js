@@ -0,0 +1,210 @@
+var bucketModel = require("../config/models/bucketModel");
+var waterModel = require("../config/models/waterModel");
+var electricModel = require("../config/models/electricModel");
+var rssiModel = require("../config/models/rssiModel");
+
+// Bucketed storage of raw readings: one document per series and time bucket
+// with the samples packed in an array and min/max/count kept up to date on
+// append. Readers unpack buckets back into plain readings shaped like the
+// legacy one-document-per-reading collections, which are now only read by
+// the migration.
+const HOUR_MS = 60 * 60 * 1000;
+const DAY_MS = 24 * HOUR_MS;
+
+// Water and electricity report at most once per poll, tens of samples a
+// day; the Gateway asks every node for RSSI once a minute.
+const SERIES = {
+  water: { field: "water", span: DAY_MS, legacy: waterModel },
+  elec: { field: "power", extra: "voltage", span: DAY_MS, legacy: electricModel },
+  rssi: { field: "rssi", span: HOUR_MS, legacy: rssiModel },
+};
+
+// Samples per document; a full bucket continues in another document
+const MAX_SAMPLES = 512;
+
+function seriesKey(type, reading) {
+  return type === "rssi" ? reading.node_id : reading.sensor_id;
+}
+
+function bucketStart(type, timestamp) {
+  const span = SERIES[type].span;
+  return new Date(Math.floor(timestamp.getTime() / span) * span);
+}
+
+function toSample(type, reading, bucket) {
+  const { field, extra } = SERIES[type];
+  const sample = { o: reading.timestamp.getTime() - bucket.getTime(), v: Number(reading[field]) };
+  if (extra && Number.isFinite(Number(reading[extra]))) sample.u = Number(reading[extra]);
+  if (reading.gateway != null) sample.g = String(reading.gateway);
+  if (Number.isFinite(reading.gw_rssi)) sample.r = reading.gw_rssi;
+  return sample;
+}
+
+// Sample of a bucket document -> reading. withLink adds gateway/gw_rssi.
+function toReading(type, doc, sample, withLink = true) {
+  const { field, extra } = SERIES[type];
+  const reading = type === "rssi" ? { node_id: doc.sensor_id } : { sensor_id: doc.sensor_id, node_id: doc.node_id };
+  reading.timestamp = new Date(doc.bucket.getTime() + sample.o);
+  reading[field] = sample.v;
+  if (extra && sample.u !== undefined) reading[extra] = sample.u;
+  if (withLink && sample.g !== undefined) reading.gateway = sample.g;
+  if (withLink && sample.r !== undefined) reading.gw_rssi = sample.r;
+  return reading;
+}
+
+function isValidReading(type, reading) {
+  return (
+    seriesKey(type, reading) != null &&
+    reading.timestamp instanceof Date &&
+    Number.isFinite(Number(reading[SERIES[type].field]))
+  );
+}
+
+// Upsert into the open document of the reading's bucket. The count filter
+// sends a full bucket to a fresh document; two racing first appends may also
+// create two documents for one bucket, which readers merge.
+function appendOp(type, reading) {
+  const bucket = bucketStart(type, reading.timestamp);
+  const sample = toSample(type, reading, bucket);
+  const key = { type: type, sensor_id: String(seriesKey(type, reading)), bucket: bucket };
+  const update = {
+    $push: { s: sample },
+    $inc: { count: 1 },
+    $min: { min: sample.v, first_ts: reading.timestamp },
+    $max: { max: sample.v, last_ts: reading.timestamp },
+  };
+  if (type !== "rssi") update.$set = { node_id: reading.node_id };
+  return { key, bucket, sample, op: { filter: { ...key, count: { $lt: MAX_SAMPLES } }, update, upsert: true } };
+}
+
+// Append one reading (see isValidReading). Returns the stored reading and
+// upgrade(gateway, gwRssi), which repoints the sample to a better gateway
+// copy (services/dedup.js).
+async function appendReading(type, reading) {
+  const { key, bucket, sample, op } = appendOp(type, reading);
+  await bucketModel.collection.updateOne(op.filter, op.update, { upsert: true });
+  return {
+    reading: toReading(type, { ...key, node_id: reading.node_id }, sample),
+    upgrade: (gateway, gwRssi) =>
+      bucketModel.collection.updateOne(
+        { ...key, "s.o": sample.o },
+        { $set: { "s.$.g": gateway, "s.$.r": gwRssi } }
+      ),
+  };
+}
+
+// Append many readings in one round trip, e.g. from the populate routes
+async function appendReadings(type, readings) {
+  const ops = readings.map((reading) => ({ updateOne: appendOp(type, reading).op }));
+  if (ops.length) await bucketModel.collection.bulkWrite(ops, { ordered: true });
+}
+
+// Newest reading of a series, optionally only one older than `before`.
+// Buckets are walked newest first and every sample lies inside its bucket's
+// span, so the walk stops at the first bucket that ends before the best
+// sample found so far (normally after one or two documents).
+async function latestReading(type, key, before) {
+  const filter = { type: type, sensor_id: key };
+  if (before) filter.bucket = { $lt: before };
+  const cursor = bucketModel.find(filter).sort({ bucket: -1 }).batchSize(2).lean().cursor();
+
+  let best = null;
+  let bestTime = -Infinity;
+  for await (const doc of cursor) {
+    const base = doc.bucket.getTime();
+    if (base + SERIES[type].span <= bestTime) break;
+    for (const sample of doc.s) {
+      const time = base + sample.o;
+      if (time > bestTime && (!before || time < before.getTime())) {
+        best = { doc, sample };
+        bestTime = time;
+      }
+    }
+  }
+  return best ? toReading(type, best.doc, best.sample) : null;
+}
+
+// Newest reading of every series of a type, for warming the cache
+async function newestPerSeries(type) {
+  const rows = await bucketModel
+    .aggregate([
+      { $match: { type: type } },
+      { $sort: { sensor_id: 1, bucket: -1, last_ts: -1 } },
+      { $group: { _id: "$sensor_id", doc: { $first: "$$ROOT" } } },
+    ])
+    .allowDiskUse(true)
+    .exec();
+
+  return rows
+    .filter((row) => row.doc.s.length)
+    .map(({ doc }) => toReading(type, doc, doc.s.reduce((a, b) => (b.o > a.o ? b : a))));
+}
+
+// Readings of a series in [start, end] in time order, without gateway
+// fields. All documents of a bucket are gathered and sorted before their
+// samples are yielded, since samples are stored in arrival order.
+async function* readingsInRange(type, key, start, end) {
+  const cursor = bucketModel
+    .find({ type: type, sensor_id: key, bucket: { $gte: bucketStart(type, start), $lte: end } })
+    .sort({ bucket: 1 })
+    .lean()
+    .cursor();
+
+  let group = [];
+  let groupBucket = null;
+  const flush = function* () {
+    group.sort((a, b) => a.sample.o - b.sample.o);
+    for (const { doc, sample } of group) yield toReading(type, doc, sample, false);
+    group = [];
+  };
+
+  for await (const doc of cursor) {
+    const base = doc.bucket.getTime();
+    if (base !== groupBucket) {
+      yield* flush();
+      groupBucket = base;
+    }
+    for (const sample of doc.s) {
+      const time = base + sample.o;
+      if (time >= start.getTime() && time <= end.getTime()) group.push({ doc, sample });
+    }
+  }
+  yield* flush();
+}
+
+// Move a legacy one-document-per-reading collection into buckets. Each
+// migrated document is flagged "bucketed", so an interrupted migration can
+// simply be run again; drop the legacy collection once a run moves nothing.
+async function migrateLegacy(type, batchSize = 1000) {
+  const legacy = SERIES[type].legacy;
+  const cursor = legacy.find({ bucketed: { $ne: true } }).lean().cursor();
+  const stats = { moved: 0, skipped: 0 };
+  let batch = [];
+
+  const flush = async () => {
+    const readings = batch.filter((doc) => isValidReading(type, doc));
+    await appendReadings(type, readings);
+    await legacy.collection.updateMany({ _id: { $in: batch.map((doc) => doc._id) } }, { $set: { bucketed: true } });
+    stats.moved += readings.length;
+    stats.skipped += batch.length - readings.length;
+    batch = [];
+  };
+
+  for await (const doc of cursor) {
+    batch.push(doc);
+    if (batch.length >= batchSize) await flush();
+  }
+  if (batch.length) await flush();
+  return stats;
+}
+
+module.exports = {
+  SERIES,
+  isValidReading,
+  appendReading,
+  appendReadings,
+  latestReading,
+  newestPerSeries,
+  readingsInRange,
+  migrateLegacy,
+};
@@ -0,0 +1,79 @@
+// Deduplication of readings forwarded by several gateways. Every gateway that
+// hears a node frame posts it, stamped with its id, the frame RSSI and the
+// node's frame counter "seq". (node_id, sensor_id, seq, ts) identifies the
+// reading: the first copy is stored at once, later copies inside the window
+// only move the stored gateway/gw_rssi to the best-RSSI copy.
+const WINDOW_MS = Number(process.env.DEDUP_WINDOW_MS) || 30000;
+const MAX_ENTRIES = 100000;
+
+// key -> { key, at, gateway, rssi, saved: Promise<upgrade(gateway, gwRssi) | null> }
+const seen = new Map();
+// Entries in arrival order for expiry. A plain array with a moving head:
+// deleting from the front of a large Map and iterating it again from the
+// start gets slower with every deleted slot.
+let order = [];
+let head = 0;
+const stats = { unique: 0, duplicates: 0, upgraded: 0 };
+
+function readingKey(data) {
+  if (!Number.isFinite(data.seq)) return null;
+  return `${data.node_id}|${data.sensor_id}|${data.seq}|${data.ts || ""}`;
+}
+
+function prune(now) {
+  while (head < order.length) {
+    const entry = order[head];
+    const live = seen.get(entry.key) === entry;
+    if (live && now - entry.at < WINDOW_MS && seen.size <= MAX_ENTRIES) break;
+    if (live) seen.delete(entry.key);
+    head++;
+  }
+  if (head > 1024 && head * 2 > order.length) {
+    order = order.slice(head);
+    head = 0;
+  }
+}
+
+// First copy of a reading: returns settle(upgrade), which the caller invokes
+// once the reading is stored, with a function that repoints the stored copy
+// to another gateway (or with null if storing failed, so a retry is stored
+// again). Any later copy: returns null and, when its RSSI is better, calls
+// that upgrade. Readings without "seq" are never deduped.
+async function claimReading(data, now = Date.now()) {
+  const key = readingKey(data);
+  if (key === null) return () => {};
+  prune(now);
+
+  const entry = seen.get(key);
+  if (!entry) {
+    let resolve;
+    const saved = new Promise((r) => (resolve = r));
+    const fresh = { key, at: now, gateway: data.gateway, rssi: data.gw_rssi, saved };
+    seen.set(key, fresh);
+    order.push(fresh);
+    stats.unique++;
+    return (upgrade) => {
+      if (!upgrade && seen.get(key) === fresh) seen.delete(key);
+      resolve(upgrade || null);
+    };
+  }
+
+  stats.duplicates++;
+  if (!Number.isFinite(data.gw_rssi) || (Number.isFinite(entry.rssi) && entry.rssi >= data.gw_rssi)) {
+    return null;
+  }
+  entry.gateway = data.gateway;
+  entry.rssi = data.gw_rssi;
+  const upgrade = await entry.saved;
+  if (upgrade && entry.gateway === data.gateway) {
+    await upgrade(data.gateway, data.gw_rssi);
+    stats.upgraded++;
+  }
+  return null;
+}
+
+function dedupStats() {
+  return { ...stats, windowMs: WINDOW_MS, tracked: seen.size };
+}
+
+module.exports = { claimReading, dedupStats };
@@ -0,0 +1,54 @@
+// Which gateway serves each node. Every copy of every frame updates a
+// smoothed RSSI per (node, gateway); the serving gateway is the one with the
+// best smoothed RSSI among those that heard the node recently.
+const STALE_MS = Number(process.env.LINK_STALE_MS) || 60 * 60 * 1000;
+const ALPHA = 0.25; // weight of the newest frame in the smoothed RSSI
+
+const links = new Map(); // node_id -> Map(gateway -> { rssi, lastSeen, frames })
+
+function observeLink(nodeId, gateway, rssi, now = Date.now()) {
+  if (!nodeId || !gateway || !Number.isFinite(rssi)) return;
+  let perNode = links.get(nodeId);
+  if (!perNode) {
+    perNode = new Map();
+    links.set(nodeId, perNode);
+  }
+  const link = perNode.get(gateway);
+  if (!link) {
+    perNode.set(gateway, { rssi, lastSeen: now, frames: 1 });
+    return;
+  }
+  link.rssi += ALPHA * (rssi - link.rssi);
+  link.lastSeen = now;
+  link.frames++;
+}
+
+function servingGateway(nodeId, now = Date.now()) {
+  const perNode = links.get(nodeId);
+  if (!perNode) return null;
+  let best = null;
+  for (const [gateway, link] of perNode) {
+    if (now - link.lastSeen > STALE_MS) continue;
+    if (!best || link.rssi > best.rssi) best = { gateway, rssi: link.rssi };
+  }
+  return best ? best.gateway : null;
+}
+
+function linkTable(now = Date.now()) {
+  const table = {};
+  for (const [nodeId, perNode] of links) {
+    const gateways = {};
+    for (const [gateway, link] of perNode) {
+      gateways[gateway] = {
+        rssi: Math.round(link.rssi * 10) / 10,
+        lastSeen: new Date(link.lastSeen),
+        frames: link.frames,
+        stale: now - link.lastSeen > STALE_MS,
+      };
+    }
+    table[nodeId] = { serving: servingGateway(nodeId, now), gateways };
+  }
+  return table;
+}
+
+module.exports = { observeLink, servingGateway, linkTable };
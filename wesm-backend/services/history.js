@@ -0,0 +1,90 @@
+var { SERIES, appendReadings, readingsInRange } = require("./buckets");
+var { updateRollups } = require("./rollup");
+var { recordReading } = require("./latestCache");
+
+// Interval records backfilled from a node's flash history
+// (Common/historyLog.h), base64 of little-endian records: ts (u32, epoch s)
+// then one float32 per channel. ts 0 marks a record the node could not read
+// back, NaN a channel without a value. Channel i is the i-th sensor below.
+const RECORD_BYTES = 12;
+const CHANNELS = 2;
+const NODES = {
+  node_1: { type: "water", sensors: ["water1", "water2"] },
+  node_2: { type: "elec", sensors: ["power1", "power2"] },
+};
+
+function decodeHistory(data) {
+  const records = Buffer.from(String(data.hist), "base64");
+  if (!records.length || records.length % RECORD_BYTES !== 0) return null;
+
+  const out = [];
+  for (let offset = 0; offset < records.length; offset += RECORD_BYTES) {
+    const values = [];
+    for (let ch = 0; ch < CHANNELS; ch++) values.push(records.readFloatLE(offset + 4 + ch * 4));
+    out.push({ seq: Number(data.h) + offset / RECORD_BYTES, ts: records.readUInt32LE(offset), values: values });
+  }
+  return out;
+}
+
+// Readings whose sensor already has a sample at the same time are left out:
+// a batch resent after a lost response, or fetched by two gateways, lands once
+async function dropStored(type, readings) {
+  const bySensor = new Map();
+  for (const reading of readings) {
+    if (!bySensor.has(reading.sensor_id)) bySensor.set(reading.sensor_id, []);
+    bySensor.get(reading.sensor_id).push(reading);
+  }
+
+  const fresh = [];
+  for (const [sensorId, list] of bySensor) {
+    const times = list.map((r) => r.timestamp.getTime());
+    const stored = new Set();
+    const range = readingsInRange(type, sensorId, new Date(Math.min(...times)), new Date(Math.max(...times)));
+    for await (const reading of range) stored.add(reading.timestamp.getTime());
+    fresh.push(...list.filter((r) => !stored.has(r.timestamp.getTime())));
+  }
+  return fresh;
+}
+
+// Store a history batch as ordinary readings of the node's sensors, so the
+// intervals a failed poll missed fill the same series, rollups and charts
+async function ingestHistory(data) {
+  const node = NODES[data.node_id];
+  const records = decodeHistory(data);
+  if (!node || records === null) {
+    return { status: 400, message: "Malformed 'hist' batch." };
+  }
+
+  const field = SERIES[node.type].field;
+  const readings = [];
+  for (const { ts, values } of records) {
+    if (!ts) continue;
+    const timestamp = new Date(ts * 1000);
+    timestamp.setHours(timestamp.getHours() + 7); // GMT+7 (Indochina Time)
+    values.forEach((value, ch) => {
+      if (ch >= node.sensors.length || !Number.isFinite(value)) return;
+      readings.push({
+        node_id: data.node_id,
+        sensor_id: node.sensors[ch],
+        timestamp: timestamp,
+        [field]: value,
+        gateway: data.gateway,
+        gw_rssi: data.gw_rssi,
+      });
+    });
+  }
+
+  const fresh = await dropStored(node.type, readings);
+  await appendReadings(node.type, fresh);
+  try {
+    for (const reading of fresh) {
+      recordReading(node.type, reading);
+      await updateRollups(node.type, reading);
+    }
+  } catch (err) {
+    console.error("❌ Lỗi cập nhật rollup:", err);
+  }
+  return { status: 200, message: `Stored ${fresh.length} history readings` };
+}
+
+module.exports = { decodeHistory, ingestHistory };
@@ -0,0 +1,122 @@
+var alertModel = require('../config/models/alertModel');
+var { updateRollups } = require('./rollup');
+var { publishReading, publishAlert } = require('./liveBus');
+var { recordReading, recordRssi } = require('./latestCache');
+var { claimReading } = require('./dedup');
+var { observeLink } = require('./gatewayLinks');
+var { ingestPowerQuality } = require('./powerQuality');
+var { ingestHistory } = require('./history');
+var { isValidReading, appendReading } = require('./buckets');
+
+// Loại bản ghi theo trường nó mang chứ không theo node_id: Gateway poll
+// node bất kỳ (GATEWAY_NODES) và node nào cũng có thể gắn cảm biến nước
+// hoặc điện
+function getType(data) {
+    // Cảnh báo rò rỉ do node phát hiện, Gateway chuyển tiếp ngay
+    if (data["alert"]) return "alert";
+    // Gateway gửi RSSI của từng node với sensor_id "rssi"
+    if (data["sensor_id"] == "rssi") return "rssi";
+    // Lô chất lượng điện và bản ghi lịch sử có đường riêng bên dưới
+    if (data["pq"] || data["hist"]) return "batch";
+    if (data["water"] !== undefined) return "water";
+    if (data["power"] !== undefined) return "elec";
+    return null;
+}
+
+const MISMATCH = 'Error: Data structure mismatch between sensor and designated schema.';
+
+// Cảnh báo vẫn lưu mỗi bản ghi một document
+async function ingestAlert(data, fields, timestamp) {
+    try {
+        var saveModel = new alertModel({ ...fields, timestamp: timestamp });
+    } catch(err) {
+        console.error(`${MISMATCH}\nMessage: ${err}`);
+        return { status: 500, message: `${MISMATCH}\nMessage: ${err}` };
+    }
+
+    const settle = await claimReading(data);
+    if (settle === null) {
+        return { status: 200, message: 'Bản trùng từ Gateway khác, đã bỏ qua' };
+    }
+    try {
+        await saveModel.save();
+    } catch (err) {
+        settle(null);
+        throw err;
+    }
+    settle((gateway, gwRssi) => alertModel.updateOne({ _id: saveModel._id }, { $set: { gateway: gateway, gw_rssi: gwRssi } }));
+
+    console.warn(`🚨 Cảnh báo ${data["alert"]} tại ${data["sensor_id"]}:`, data);
+    publishAlert(saveModel);
+    return { status: 200, message: 'Đã lưu thành công' };
+}
+
+// Lưu một bản ghi từ Gateway, dùng chung cho HTTP (/stream_data) và MQTT.
+// Trả về { status, message }; lỗi ghi database được throw cho nơi gọi.
+async function ingestReading(data) {
+    if (!data || !data["sensor_id"]) {
+        return { status: 400, message: "'sensor_id' missing." };
+    }
+
+    const type = getType(data);
+    if (type === null) {
+        return { status: 500, message: "Neither 'water' nor 'power' in the reading." };
+    }
+
+    // Mỗi bản sao (kể cả bản trùng) cho biết Gateway nào nghe được node
+    observeLink(data["node_id"], data["gateway"], data["gw_rssi"]);
+
+    // Lô khoảng chất lượng điện của Node2, lưu vào collection riêng
+    if (data["pq"]) return ingestPowerQuality(data);
+
+    // Bản ghi lịch sử Gateway lấy bù từ flash của node sau các lần poll lỗi
+    if (data["hist"]) return ingestHistory(data);
+
+    // "ts" là thời điểm node đo (epoch UTC, giây) nếu node đã đồng bộ giờ
+    // với Gateway; nếu không có thì dùng thời điểm nhận. "seq" chỉ dùng để
+    // khử trùng lặp, không lưu.
+    const { ts, seq, ...fields } = data;
+    const currentTime = Number.isFinite(ts) && ts > 0 ? new Date(ts * 1000) : new Date();
+    currentTime.setHours(currentTime.getHours() + 7); // GMT+7 (Indochina Time)
+
+    if (type === "alert") return ingestAlert(data, fields, currentTime);
+
+    // Số đo được nối vào bucket giờ/ngày của cảm biến (services/buckets.js)
+    const incoming = { ...fields, timestamp: currentTime };
+    if (!isValidReading(type, incoming)) {
+        console.error(`${MISMATCH}\nMessage: ${JSON.stringify(data)}`);
+        return { status: 500, message: `${MISMATCH}\nMessage: missing or non-numeric value` };
+    }
+
+    // Nhiều Gateway cùng nghe một frame: chỉ bản đầu tiên được lưu
+    const settle = await claimReading(data);
+    if (settle === null) {
+        return { status: 200, message: 'Bản trùng từ Gateway khác, đã bỏ qua' };
+    }
+    try {
+        var { reading, upgrade } = await appendReading(type, incoming);
+    } catch (err) {
+        settle(null);
+        throw err;
+    }
+    settle(upgrade);
+
+    if (type === "rssi") {
+        recordRssi(reading);
+        return { status: 200, message: 'Đã lưu thành công' };
+    }
+
+    recordReading(type, reading);
+    publishReading(type, reading);
+
+    // Cập nhật rollup giờ/ngày; lỗi rollup không làm hỏng việc ghi dữ liệu
+    try {
+        await updateRollups(type, reading);
+    } catch (err) {
+        console.error('❌ Lỗi cập nhật rollup:', err);
+    }
+    console.log(`📥 Dữ liệu từ ${data["sensor_id"]}:`, data);
+    return { status: 200, message: 'Đã lưu thành công' };
+}
+
+module.exports = { ingestReading };
@@ -0,0 +1,92 @@
+var { latestReading, newestPerSeries } = require("./buckets");
+
+// Write-through cache of the newest reading per sensor and the newest RSSI
+// per node. Ingest updates it, startup warms it, and the "latest value"
+// endpoints answer from it without a database round trip.
+const TYPES = ["water", "elec"];
+
+const readings = new Map(); // "type|sensor_id" -> plain document
+const rssi = new Map(); // node_id -> plain document
+const stats = { hits: 0, misses: 0, writes: 0, warmed: false };
+
+function toPlain(doc) {
+  return typeof doc.toObject === "function" ? doc.toObject() : doc;
+}
+
+// Keep whichever document is newer; late or backfilled readings never
+// replace a fresher one.
+function storeNewer(map, key, doc) {
+  if (!doc || !(doc.timestamp instanceof Date)) return;
+  const current = map.get(key);
+  if (current && current.timestamp >= doc.timestamp) return;
+  map.set(key, toPlain(doc));
+  stats.writes++;
+}
+
+function recordReading(type, reading) {
+  if (!reading) return;
+  storeNewer(readings, `${type}|${reading.sensor_id}`, reading);
+}
+
+function recordRssi(reading) {
+  if (!reading) return;
+  storeNewer(rssi, reading.node_id, reading);
+}
+
+// Newest reading of a sensor, optionally only if it is older than `before`.
+// A cached reading newer than `before` cannot answer the question, so that
+// case (and a cold key) falls through to the database and counts as a miss.
+async function getLatest(type, sensorId, before) {
+  const cached = readings.get(`${type}|${sensorId}`);
+  if (cached && (!before || cached.timestamp < before)) {
+    stats.hits++;
+    return cached;
+  }
+  stats.misses++;
+
+  const doc = await latestReading(type, sensorId, before);
+  if (doc && !before) recordReading(type, doc);
+  return doc;
+}
+
+async function getRssi(nodeId) {
+  const cached = rssi.get(nodeId);
+  if (cached) {
+    stats.hits++;
+    return cached;
+  }
+  stats.misses++;
+
+  const doc = await latestReading("rssi", nodeId);
+  if (doc) recordRssi(doc);
+  return doc;
+}
+
+async function warmCache() {
+  try {
+    for (const type of TYPES) {
+      for (const reading of await newestPerSeries(type)) {
+        recordReading(type, reading);
+      }
+    }
+    for (const reading of await newestPerSeries("rssi")) {
+      recordRssi(reading);
+    }
+    stats.warmed = true;
+    console.log(`Latest-value cache warmed: ${readings.size} sensors, ${rssi.size} nodes`);
+  } catch (err) {
+    console.error("Error while warming latest-value cache: ", err);
+  }
+}
+
+function cacheStats() {
+  const lookups = stats.hits + stats.misses;
+  return {
+    ...stats,
+    hitRatio: lookups ? stats.hits / lookups : null,
+    sensors: readings.size,
+    nodes: rssi.size,
+  };
+}
+
+module.exports = { recordReading, recordRssi, getLatest, getRssi, warmCache, cacheStats };
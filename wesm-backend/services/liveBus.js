@@ -0,0 +1,37 @@
+var EventEmitter = require("events");
+
+// In-process fan-out of freshly ingested readings to live subscribers
+const bus = new EventEmitter();
+bus.setMaxListeners(0);
+
+const VALUE_FIELD = { water: "water", elec: "power" };
+
+// Compact delta: type, sensor, node, value, timestamp (ms)
+function publishReading(type, reading) {
+  bus.emit("reading", {
+    t: type,
+    s: reading.sensor_id,
+    n: reading.node_id,
+    v: reading[VALUE_FIELD[type]],
+    ts: reading.timestamp instanceof Date ? reading.timestamp.getTime() : Date.now(),
+  });
+}
+
+function publishAlert(alert) {
+  bus.emit("alert", {
+    s: alert.sensor_id,
+    n: alert.node_id,
+    a: alert.alert,
+    lpm: alert.lpm,
+    dur: alert.dur,
+    ts: alert.timestamp instanceof Date ? alert.timestamp.getTime() : Date.now(),
+  });
+}
+
+// Returns an unsubscribe function. event is "reading" or "alert".
+function subscribe(listener, event = "reading") {
+  bus.on(event, listener);
+  return () => bus.off(event, listener);
+}
+
+module.exports = { publishReading, publishAlert, subscribe };
@@ -0,0 +1,63 @@
+var metricsModel = require("../config/models/metricsModel");
+var { ingestReading } = require("./ingest");
+
+// Topics published by the Gateway (Gateway/mqttUplink.h)
+const READING_TOPIC = "w/+"; // w/<node_id>, QoS1
+const METRICS_TOPIC = "m/+"; // m/<gateway_id>, QoS0
+
+// Subscribe to the Gateway uplink and feed readings through the same ingest
+// path as POST /stream_data. The session is persistent (fixed client id,
+// clean: false), and a QoS1 reading is acknowledged only after it has been
+// stored, so nothing is lost while the backend restarts or MongoDB is down.
+function startMqttIngest(url) {
+  var mqtt;
+  try {
+    mqtt = require("mqtt");
+  } catch (err) {
+    console.error("MQTT_URL is set but the 'mqtt' package is not installed: ", err.message);
+    return null;
+  }
+
+  const client = mqtt.connect(url, {
+    clientId: process.env.MQTT_CLIENT_ID || "wesm-backend",
+    clean: false,
+  });
+
+  // Called before PUBACK is sent; an error withholds the ack so the broker
+  // redelivers the message on the next session
+  client.handleMessage = async (packet, callback) => {
+    let data;
+    try {
+      data = JSON.parse(packet.payload.toString());
+    } catch (err) {
+      console.error(`Invalid JSON on ${packet.topic}: `, err.message);
+      return callback();
+    }
+
+    const [kind, source] = packet.topic.split("/");
+    try {
+      if (kind === "m") {
+        await new metricsModel({ gateway_id: source, ...data, timestamp: new Date() }).save();
+      } else {
+        const result = await ingestReading({ node_id: source, ...data });
+        if (result.status !== 200) {
+          console.error(`Rejected reading on ${packet.topic}: ${result.message}`);
+        }
+      }
+      callback();
+    } catch (err) {
+      console.error(`Error while ingesting ${packet.topic}: `, err);
+      callback(err);
+    }
+  };
+
+  client.on("connect", (connack) => {
+    console.log(`MQTT connected to ${url}, session present: ${connack.sessionPresent}`);
+    client.subscribe({ [READING_TOPIC]: { qos: 1 }, [METRICS_TOPIC]: { qos: 0 } });
+  });
+  client.on("error", (err) => console.error("MQTT error: ", err.message));
+
+  return client;
+}
+
+module.exports = { startMqttIngest };
@@ -0,0 +1,102 @@
+var powerQualityModel = require("../config/models/powerQualityModel");
+
+// Record layout of a "pq" batch (Node2/powerQuality.h), little-endian u16:
+// v_mean, v_min, v_max (0.1 V), p_mean, p_peak (W), wh (bits 0-13) | tariff (bits 14-15)
+const RECORD_BYTES = 12;
+const TARIFFS = ["normal", "peak", "offpeak"];
+const MAX_INTERVAL_S = 24 * 3600;
+
+function decodeIntervals(data) {
+  const records = Buffer.from(String(data.pq), "base64");
+  const t0 = Number(data.t0);
+  const iv = Number(data.iv);
+  if (!(t0 > 0) || !(iv > 0) || iv > MAX_INTERVAL_S || records.length % RECORD_BYTES !== 0) {
+    return null;
+  }
+
+  const intervals = [];
+  for (let offset = 0; offset < records.length; offset += RECORD_BYTES) {
+    const whTariff = records.readUInt16LE(offset + 10);
+    intervals.push({
+      start: t0 + (offset / RECORD_BYTES) * iv,
+      interval_s: iv,
+      v_mean: records.readUInt16LE(offset) / 10,
+      v_min: records.readUInt16LE(offset + 2) / 10,
+      v_max: records.readUInt16LE(offset + 4) / 10,
+      p_mean: records.readUInt16LE(offset + 6),
+      p_peak: records.readUInt16LE(offset + 8),
+      wh: whTariff & 0x3fff,
+      tariff: TARIFFS[whTariff >> 14] || "normal",
+    });
+  }
+  return intervals;
+}
+
+// Store a batch as one document per interval. Upserts keyed by sensor and
+// start make a batch that the node resends (lost ack) or that several
+// gateways forward land on the same documents.
+async function ingestPowerQuality(data) {
+  const intervals = decodeIntervals(data);
+  if (intervals === null) {
+    return { status: 400, message: "Malformed 'pq' batch." };
+  }
+
+  const ops = intervals.map(({ start, ...fields }) => {
+    const timestamp = new Date(start * 1000);
+    timestamp.setHours(timestamp.getHours() + 7); // GMT+7 (Indochina Time)
+    return {
+      updateOne: {
+        filter: { sensor_id: data.sensor_id, timestamp: timestamp },
+        update: {
+          $set: { ...fields, node_id: data.node_id },
+          $setOnInsert: { gateway: data.gateway, gw_rssi: data.gw_rssi },
+        },
+        upsert: true,
+      },
+    };
+  });
+  if (ops.length) await powerQualityModel.bulkWrite(ops, { ordered: false });
+  return { status: 200, message: `Stored ${ops.length} power-quality intervals` };
+}
+
+// Energy per tariff window, demand and voltage extremes of a sensor over [start, end]
+async function summarizePowerQuality(sensorId, start, end) {
+  const match = { sensor_id: sensorId, timestamp: { $gte: start, $lte: end } };
+  const [byTariff, overall] = await Promise.all([
+    powerQualityModel.aggregate([
+      { $match: match },
+      { $group: { _id: "$tariff", wh: { $sum: "$wh" }, intervals: { $sum: 1 } } },
+    ]),
+    powerQualityModel.aggregate([
+      { $match: match },
+      {
+        $group: {
+          _id: null,
+          intervals: { $sum: 1 },
+          wh: { $sum: "$wh" },
+          v_min: { $min: "$v_min" },
+          v_max: { $max: "$v_max" },
+          p_peak: { $max: "$p_peak" },
+          // Demand: mean power over the interval, the basis of demand charges
+          demand_w: { $max: { $divide: [{ $multiply: ["$wh", 3600] }, "$interval_s"] } },
+        },
+      },
+    ]),
+  ]);
+
+  const tariffs = {};
+  for (const t of byTariff) tariffs[t._id] = { kwh: t.wh / 1000, intervals: t.intervals };
+  const total = overall[0] || { intervals: 0, wh: 0, v_min: null, v_max: null, p_peak: null, demand_w: null };
+  return {
+    sensor_id: sensorId,
+    intervals: total.intervals,
+    kwh: total.wh / 1000,
+    tariffs: tariffs,
+    max_demand_w: total.demand_w,
+    p_peak: total.p_peak,
+    v_min: total.v_min,
+    v_max: total.v_max,
+  };
+}
+
+module.exports = { decodeIntervals, ingestPowerQuality, summarizePowerQuality };
@@ -0,0 +1,154 @@
+var rollupModel = require("../config/models/rollupModel");
+var bucketModel = require("../config/models/bucketModel");
+
+const GRANULARITY_MS = {
+  hour: 60 * 60 * 1000,
+  day: 24 * 60 * 60 * 1000,
+};
+
+const TYPES = {
+  water: { field: "water" },
+  elec: { field: "power" },
+};
+
+function bucketStart(timestamp, granularity) {
+  const ms = GRANULARITY_MS[granularity];
+  return new Date(Math.floor(timestamp.getTime() / ms) * ms);
+}
+
+// Fold one reading into its hourly and daily rollups. A single upsert per
+// granularity; the update pipeline keeps first/last ordered by timestamp so
+// late or replayed readings land correctly.
+async function updateRollups(type, reading) {
+  const field = TYPES[type].field;
+  const value = reading[field];
+  const timestamp = reading.timestamp;
+  if (typeof value !== "number" || !(timestamp instanceof Date)) return;
+
+  await Promise.all(
+    Object.keys(GRANULARITY_MS).map((granularity) =>
+      rollupModel.collection.updateOne(
+        {
+          type: type,
+          sensor_id: reading.sensor_id,
+          granularity: granularity,
+          bucket: bucketStart(timestamp, granularity),
+        },
+        [
+          {
+            $set: {
+              node_id: { $literal: reading.node_id },
+              count: { $add: [{ $ifNull: ["$count", 0] }, 1] },
+              sum: { $add: [{ $ifNull: ["$sum", 0] }, value] },
+              min: { $min: ["$min", value] },
+              max: { $max: ["$max", value] },
+              first: {
+                $cond: [
+                  { $lt: [timestamp, { $ifNull: ["$first_ts", new Date(8.64e15)] }] },
+                  value,
+                  "$first",
+                ],
+              },
+              first_ts: { $min: ["$first_ts", timestamp] },
+              last: {
+                $cond: [
+                  { $gte: [timestamp, { $ifNull: ["$last_ts", new Date(0)] }] },
+                  value,
+                  "$last",
+                ],
+              },
+              last_ts: { $max: ["$last_ts", timestamp] },
+            },
+          },
+        ],
+        { upsert: true }
+      )
+    )
+  );
+}
+
+// Recompute every rollup of a type from the reading buckets. Needed once for
+// data written before rollups existed or inserted by the populate routes.
+async function rebuildRollups(type) {
+  for (const granularity of Object.keys(GRANULARITY_MS)) {
+    const ms = GRANULARITY_MS[granularity];
+    await bucketModel
+      .aggregate([
+        { $match: { type: type } },
+        { $unwind: "$s" },
+        { $match: { "s.v": { $type: "number" } } },
+        {
+          $project: {
+            sensor_id: 1,
+            node_id: 1,
+            timestamp: { $add: ["$bucket", "$s.o"] },
+            value: "$s.v",
+          },
+        },
+        { $sort: { timestamp: 1 } },
+        {
+          $group: {
+            _id: {
+              sensor_id: "$sensor_id",
+              bucket: {
+                $toDate: {
+                  $subtract: [{ $toLong: "$timestamp" }, { $mod: [{ $toLong: "$timestamp" }, ms] }],
+                },
+              },
+            },
+            node_id: { $last: "$node_id" },
+            count: { $sum: 1 },
+            sum: { $sum: "$value" },
+            min: { $min: "$value" },
+            max: { $max: "$value" },
+            first: { $first: "$value" },
+            first_ts: { $first: "$timestamp" },
+            last: { $last: "$value" },
+            last_ts: { $last: "$timestamp" },
+          },
+        },
+        {
+          $project: {
+            _id: 0,
+            type: { $literal: type },
+            sensor_id: "$_id.sensor_id",
+            granularity: { $literal: granularity },
+            bucket: "$_id.bucket",
+            node_id: 1,
+            count: 1,
+            sum: 1,
+            min: 1,
+            max: 1,
+            first: 1,
+            first_ts: 1,
+            last: 1,
+            last_ts: 1,
+          },
+        },
+        {
+          $merge: {
+            into: rollupModel.collection.name,
+            on: ["type", "sensor_id", "granularity", "bucket"],
+            whenMatched: "replace",
+            whenNotMatched: "insert",
+          },
+        },
+      ])
+      .allowDiskUse(true)
+      .exec();
+  }
+}
+
+// Coarsest granularity whose buckets tile [startDate, endDate] exactly
+// (endDate inclusive, e.g. 23:59:59.999).
+function pickGranularity(startDate, endDate) {
+  const start = startDate.getTime();
+  const end = endDate.getTime() + 1;
+  for (const granularity of ["day", "hour"]) {
+    const ms = GRANULARITY_MS[granularity];
+    if (end > start && start % ms === 0 && end % ms === 0) return granularity;
+  }
+  return "raw";
+}
+
+module.exports = { TYPES, GRANULARITY_MS, updateRollups, rebuildRollups, pickGranularity };
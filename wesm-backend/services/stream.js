@@ -0,0 +1,51 @@
+var { once } = require("events");
+var { Readable } = require("stream");
+var { pipeline } = require("stream/promises");
+var zlib = require("zlib");
+
+// Write a Mongo cursor as a JSON array, one document at a time, honouring
+// backpressure so memory stays flat regardless of the result size.
+async function streamJsonArray(res, cursor, mapDoc = (doc) => doc) {
+  res.type("application/json");
+  res.write("[");
+  let first = true;
+  for await (const doc of cursor) {
+    const chunk = (first ? "" : ",") + JSON.stringify(mapDoc(doc));
+    first = false;
+    if (!res.write(chunk)) {
+      await once(res, "drain");
+    }
+  }
+  res.end("]");
+}
+
+// Lines are packed into chunks of about this many characters before they
+// are written, instead of one write (and one gzip call) per row
+const CHUNK_CHARS = 16 * 1024;
+
+async function* chunked(lines) {
+  let chunk = "";
+  for await (const line of lines) {
+    chunk += line;
+    if (chunk.length >= CHUNK_CHARS) {
+      yield chunk;
+      chunk = "";
+    }
+  }
+  if (chunk) yield chunk;
+}
+
+// Pipe an async iterable of text lines to the response, gzip-compressed
+// when asked. pipeline() waits on backpressure at every stage and, when the
+// client goes away, stops pulling lines, which closes the Mongo cursors.
+async function streamLines(res, lines, gzip = false) {
+  const source = Readable.from(chunked(lines));
+  if (gzip) {
+    res.set("Content-Encoding", "gzip");
+    await pipeline(source, zlib.createGzip(), res);
+  } else {
+    await pipeline(source, res);
+  }
+}
+
+module.exports = { streamJsonArray, streamLines };
@@ -1,11 +1,26 @@
-import { Component, inject, OnInit, ChangeDetectorRef } from '@angular/core';
+import {
+  Component,
+  inject,
+  OnInit,
+  OnDestroy,
+  ChangeDetectorRef,
+} from '@angular/core';
 import { CommonModule } from '@angular/common';
 import { SensorDataService } from '../../services/sensor-data.service';
-import { lastValueFrom } from 'rxjs';
+import { lastValueFrom, Subscription } from 'rxjs';
 import { RoomBriefComponent } from '../room-brief/room-brief.component';
 import { ElectricityBriefComponent } from '../electricity-brief/electricity-brief.component';
 import { WaterBriefComponent } from '../water-brief/water-brief.component';
 import { RoomBriefData } from '../../interfaces/room-brief-data';
+import { BatchData } from '../../interfaces/batch-data';
+import { LiveReading } from '../../interfaces/live-reading';
+
+const DAY_MS = 24 * 60 * 60 * 1000;
+
+// Currently there are only 6 rooms available, so it will be hardcoded.
+// Should use something like $ROOMS env variable instead.
+const ROOM_COUNT = 6;
+
 @Component({
   imports: [
     CommonModule,
@@ -17,7 +32,7 @@ import { RoomBriefData } from '../../interfaces/room-brief-data';
   templateUrl: './dashboard.component.html',
   styleUrls: ['./dashboard.component.css'],
 })
-export class DashboardComponent implements OnInit {
+export class DashboardComponent implements OnInit, OnDestroy {
   private sensorDataService: SensorDataService = inject(SensorDataService);
   private cdr: ChangeDetectorRef = inject(ChangeDetectorRef);
   public roomsBriefData: RoomBriefData[] = [];
@@ -29,21 +44,71 @@ export class DashboardComponent implements OnInit {
   public waterChartData: number[] = [];
   public elecFetchedUsage: number[][] = [];
   public waterFetchedUsage: number[][] = [];
+  private latest: { [key: string]: number } = {};
+  private liveSubscription?: Subscription;
 
   async ngOnInit() {
-    await Promise.all([
-      this.getBriefAllRooms(),
-      this.getTotalWaterUsageLast30Days(),
-      this.getTotalElecUsageLast30Days(),
-      this.buildChartLabels(),
-      this.buildElecChartData(6),
-      this.buildWaterChartData(6),
-    ]);
+    this.buildChartLabels();
+    try {
+      const batch = await lastValueFrom(this.fetchDashboardData());
+      this.rememberLatest(batch);
+      this.getBriefAllRooms(batch);
+      this.getTotalUsageLast30Days(batch);
+      this.buildChartData(batch);
+    } catch (error) {
+      console.error('Error while fetching dashboard data: ', error);
+    }
     this.filteredRoomsBriefData = this.roomsBriefData;
     this.chartLabels = [...this.chartLabels];
     this.elecChartData = [...this.elecChartData];
     this.waterChartData = [...this.waterChartData];
     this.cdr.detectChanges();
+
+    this.liveSubscription = this.sensorDataService
+      .liveUpdates()
+      .subscribe((reading) => this.applyLiveReading(reading));
+  }
+
+  ngOnDestroy() {
+    this.liveSubscription?.unsubscribe();
+  }
+
+  // Fold a pushed reading into the cards and today's bar without refetching
+  private applyLiveReading(reading: LiveReading) {
+    const prefix = reading.t === 'elec' ? 'power' : 'water';
+    const index = Number(reading.s.slice(prefix.length));
+    if (!reading.s.startsWith(prefix) || !(index >= 1 && index <= ROOM_COUNT)) {
+      return;
+    }
+
+    const key = `${reading.t}|${reading.s}`;
+    const delta = reading.v - (this.latest[key] ?? reading.v);
+    this.latest[key] = reading.v;
+
+    const room = this.roomsBriefData[index - 1];
+    if (room) {
+      if (reading.t === 'elec') {
+        room.elecCurrent = Math.floor(reading.v);
+        room.elecDue = (room.elecCurrent - (room.elecPast ?? 0)) * 3500;
+      } else {
+        room.waterCurrent = Math.floor(reading.v);
+        room.waterDue = (room.waterCurrent - (room.waterPast ?? 0)) * 15000;
+      }
+      room.totalDue = (room.elecDue ?? 0) + (room.waterDue ?? 0);
+    }
+
+    if (reading.t === 'elec') {
+      this.totalElecUsageLast30Days = Math.floor(this.totalElecUsageLast30Days + delta);
+      this.elecChartData[29] += delta;
+      this.elecChartData = [...this.elecChartData];
+    } else {
+      this.totalWaterUsageLast30Days = Math.floor(this.totalWaterUsageLast30Days + delta);
+      this.waterChartData[29] += delta;
+      this.waterChartData = [...this.waterChartData];
+    }
+    this.roomsBriefData = [...this.roomsBriefData];
+    this.filteredRoomsBriefData = [...this.filteredRoomsBriefData];
+    this.cdr.detectChanges();
   }
 
   filterRooms(roomName: string) {
@@ -56,285 +121,104 @@ export class DashboardComponent implements OnInit {
     );
   }
 
-  // The following functions assume that the sensors only send data to database once a day.
-  // Beware of that.
+  private toDateString(date: Date) {
+    return date.toISOString().slice(0, 10);
+  }
 
-  // TODO: Handle a case when there're no data available for requested day (Should get
-  // the nearest lower date's record instead)
-  private async getWaterUsage(
-    index: number,
-    date: string | undefined = undefined
-  ) {
-    try {
-      const result = await lastValueFrom(
-        this.sensorDataService.fetchWaterData(`water${index}`, date)
-      );
-      if (result) {
-        return result[0].water ?? -1;
-      } else {
-        console.error('Result is undefined or not an array with data');
-      }
-    } catch (error) {
-      console.error('Error fetching water data:', error);
-    }
+  private pastDate() {
+    return this.toDateString(new Date(new Date().setDate(1)));
+  }
 
-    return -1;
+  private date30DaysAgo() {
+    return this.toDateString(new Date(new Date().getTime() - 30 * DAY_MS));
   }
 
-  private async getElecUsage(
-    index: number,
-    date: string | undefined = undefined
-  ) {
-    try {
-      const result = await lastValueFrom(
-        this.sensorDataService.fetchElecData(`power${index}`, date)
-      );
-      if (result) {
-        return result[0].power ?? -1;
-      } else {
-        console.error('Result is undefined or not an array with data');
-      }
-    } catch (error) {
-      console.error('Error/Warning fetching electricity data:', error);
+  // One request for everything the dashboard shows: latest values, values at
+  // the start of the month and 30 days ago, and per-day usage for the charts.
+  private fetchDashboardData() {
+    const elec: string[] = [];
+    const water: string[] = [];
+    for (let i = 1; i <= ROOM_COUNT; i++) {
+      elec.push(`power${i}`);
+      water.push(`water${i}`);
     }
 
-    return -1;
+    return this.sensorDataService.fetchBatch({
+      sensors: { elec, water },
+      dates: [this.pastDate(), this.date30DaysAgo()],
+      start_date: this.toDateString(new Date(new Date().getTime() - 29 * DAY_MS)),
+      end_date: this.toDateString(new Date()),
+    });
   }
 
-  private async getRoomBrief(index: number) {
-    var roomBrief!: RoomBriefData;
-    var pastDate: string = new Date(new Date().setDate(1))
-      .toISOString()
-      .slice(0, 10);
-    try {
-      roomBrief = roomBrief || {};
-
-      roomBrief.elecPast = Math.floor(await this.getElecUsage(index, pastDate));
-      roomBrief.elecCurrent = Math.floor(await this.getElecUsage(index));
-      roomBrief.waterPast = Math.floor(
-        await this.getWaterUsage(index, pastDate)
-      );
-      roomBrief.waterCurrent = Math.floor(await this.getWaterUsage(index));
-      roomBrief.elecDue =
-        ((roomBrief.elecCurrent ?? 0) - (roomBrief.elecPast ?? 0)) * 3500;
-      roomBrief.waterDue =
-        ((roomBrief.waterCurrent ?? 0) - (roomBrief.waterPast ?? 0)) * 15000;
-      roomBrief.totalDue =
-        roomBrief.totalDue || roomBrief.elecDue + roomBrief.waterDue;
-    } catch (error) {
-      console.error(
-        `Unable to get completed data for room ${index}. Error: `,
-        error
-      );
-    }
+  private getBriefAllRooms(batch: BatchData) {
+    const past = batch.at[this.pastDate()];
+    for (let i = 1; i <= ROOM_COUNT; i++) {
+      const roomBrief: RoomBriefData = {};
 
-    // Placeholder
-    roomBrief.roomName = `10${index}`;
+      roomBrief.elecPast = Math.floor(past?.elec[`power${i}`]?.value ?? -1);
+      roomBrief.elecCurrent = Math.floor(batch.latest.elec[`power${i}`]?.value ?? -1);
+      roomBrief.waterPast = Math.floor(past?.water[`water${i}`]?.value ?? -1);
+      roomBrief.waterCurrent = Math.floor(batch.latest.water[`water${i}`]?.value ?? -1);
+      roomBrief.elecDue = (roomBrief.elecCurrent - roomBrief.elecPast) * 3500;
+      roomBrief.waterDue = (roomBrief.waterCurrent - roomBrief.waterPast) * 15000;
+      roomBrief.totalDue = roomBrief.elecDue + roomBrief.waterDue;
 
-    return roomBrief;
-  }
+      // Placeholder
+      roomBrief.roomName = `10${i}`;
 
-  // Currently there are only 2 rooms available, so it will be hardcoded.
-  // Should use something like $ROOMS env variable instead.
-  private async getBriefAllRooms() {
-    for (let i = 1; i <= 6; i++) {
-      let roomBrief: RoomBriefData = await this.getRoomBrief(i);
       this.roomsBriefData.push(roomBrief);
     }
   }
 
-  private async getTotalWaterUsageLast30Days() {
-    var latest: number = 0;
-
-    try {
-      for (let i = 1; i <= 6; i++) {
-        let a = await lastValueFrom(
-          this.sensorDataService.fetchWaterData(`water${i}`)
-        );
-        if (a) {
-          latest += a[0]?.water ?? 0;
-        }
-
-        let b = await lastValueFrom(
-          this.sensorDataService.fetchWaterData(
-            `water${i}`,
-            new Date(new Date().getTime() - 30 * 24 * 60 * 60 * 1000)
-              .toISOString()
-              .slice(0, 10)
-          )
-        );
-        if (b) {
-          latest -= b[0]?.water ?? 0;
-        }
-      }
-    } catch (error) {
-      console.error('Error while fetching total water usage: ', error);
+  private rememberLatest(batch: BatchData) {
+    for (const [sensorId, latest] of Object.entries(batch.latest.elec)) {
+      this.latest[`elec|${sensorId}`] = latest.value;
+    }
+    for (const [sensorId, latest] of Object.entries(batch.latest.water)) {
+      this.latest[`water|${sensorId}`] = latest.value;
     }
-
-    this.totalWaterUsageLast30Days = Math.floor(latest);
   }
 
-  private async getTotalElecUsageLast30Days() {
-    var latest: number = 0;
-
-    try {
-      for (let i = 1; i <= 6; i++) {
-        let a = await lastValueFrom(
-          this.sensorDataService.fetchElecData(`power${i}`)
-        );
-        if (a) {
-          latest += a[0]?.power ?? 0;
-        }
+  private getTotalUsageLast30Days(batch: BatchData) {
+    const before = batch.at[this.date30DaysAgo()];
+    var elec = 0;
+    var water = 0;
 
-        let b = await lastValueFrom(
-          this.sensorDataService.fetchElecData(
-            `power${i}`,
-            new Date(new Date().getTime() - 30 * 24 * 60 * 60 * 1000)
-              .toISOString()
-              .slice(0, 10)
-          )
-        );
-        if (b) {
-          latest -= b[0]?.power ?? 0;
-        }
-      }
-    } catch (error) {
-      console.error('Error while fetching total electricity usage: ', error);
+    for (let i = 1; i <= ROOM_COUNT; i++) {
+      elec += batch.latest.elec[`power${i}`]?.value ?? 0;
+      elec -= before?.elec[`power${i}`]?.value ?? 0;
+      water += batch.latest.water[`water${i}`]?.value ?? 0;
+      water -= before?.water[`water${i}`]?.value ?? 0;
     }
 
-    this.totalElecUsageLast30Days = Math.floor(latest);
+    this.totalElecUsageLast30Days = Math.floor(elec);
+    this.totalWaterUsageLast30Days = Math.floor(water);
   }
 
-  private async buildChartLabels() {
+  private buildChartLabels() {
     for (let i = -29; i <= 0; i++) {
       this.chartLabels.push(
-        new Date(new Date().getTime() + i * 24 * 60 * 60 * 1000)
-          .getUTCDate()
-          .toString()
+        new Date(new Date().getTime() + i * DAY_MS).getUTCDate().toString()
       );
     }
   }
 
-  private async buildElecChartData(sensorCount: number) {
-    try {
-      let elecFetchedUsageData: { [date: string]: number } = {};
-      for (let i = -29; i <= 0; i++) {
-        elecFetchedUsageData[this.chartLabels[i + 29]] = 0;
-        this.elecChartData.push(0);
-      }
-
-      var startDate = new Date(
-        new Date(new Date().getTime() - 29 * 24 * 60 * 60 * 1000)
-      );
-      var endDate = new Date();
-
-      for (let i = 1; i <= sensorCount; i++) {
-        this.elecFetchedUsage.push([]);
-        var lastUsageData = await lastValueFrom(
-          this.sensorDataService.fetchElecData(
-            `power${i}`,
-            new Date(startDate.getTime() - 24 * 60 * 60 * 1000)
-              .toISOString()
-              .slice(0, 10)
-          )
-        );
-
-        var lastUsage = 0;
-        if (lastUsageData) {
-          lastUsage = lastUsageData[0]?.power ?? 0;
-        }
-
-        var elecData = await lastValueFrom(
-          this.sensorDataService.fetchElecDataRange(
-            `power${i}`,
-            startDate.toISOString().slice(0, 10),
-            endDate.toISOString().slice(0, 10)
-          )
-        );
+  // Per-day usage summed over all rooms, plus each room's own series
+  private buildChartData(batch: BatchData) {
+    this.elecChartData = new Array(30).fill(0);
+    this.waterChartData = new Array(30).fill(0);
 
-        if (elecData === undefined) {
-          throw new Error('Unable to fetch data for elecData.');
-        }
+    for (let i = 1; i <= ROOM_COUNT; i++) {
+      const elecUsage = batch.daily?.elec?.[`power${i}`] ?? [];
+      const waterUsage = batch.daily?.water?.[`water${i}`] ?? [];
+      this.elecFetchedUsage.push(elecUsage);
+      this.waterFetchedUsage.push(waterUsage);
 
-        for (let j = 0; j < elecData.length; j++) {
-          let date = elecData[j]?.timestamp?.slice(8, 10);
-          if (date?.slice(0, 1) === '0') date = date.slice(1, 2); // Silly fix
-          if (date !== undefined) {
-            let usage = elecData[j]?.power;
-            if (usage) {
-              this.elecFetchedUsage[i - 1].push(usage - lastUsage);
-              elecFetchedUsageData[date] += usage - lastUsage;
-              lastUsage = usage;
-            }
-          }
-        }
+      for (let d = 0; d < 30; d++) {
+        this.elecChartData[d] += elecUsage[d] ?? 0;
+        this.waterChartData[d] += waterUsage[d] ?? 0;
       }
-
-      for (let i = 0; i < 30; i++) {
-        this.elecChartData[i] = elecFetchedUsageData[this.chartLabels[i]];
-      }
-    } catch (error) {
-      console.error('Error while building data for electricity chart: ', error);
-    }
-  }
-
-  private async buildWaterChartData(sensorCount: number) {
-    try {
-      let waterFetchedUsageData: { [date: string]: number } = {};
-      for (let i = -29; i <= 0; i++) {
-        waterFetchedUsageData[this.chartLabels[i + 29]] = 0;
-        this.waterChartData.push(0);
-      }
-
-      var startDate = new Date(
-        new Date(new Date().getTime() - 29 * 24 * 60 * 60 * 1000)
-      );
-      var endDate = new Date();
-
-      for (let i = 1; i <= sensorCount; i++) {
-        this.waterFetchedUsage.push([]);
-        var lastUsageData = await lastValueFrom(
-          this.sensorDataService.fetchWaterData(
-            `water${i}`,
-            new Date(startDate.getTime() - 24 * 60 * 60 * 1000)
-              .toISOString()
-              .slice(0, 10)
-          )
-        );
-
-        var lastUsage = lastUsageData?.[0]?.water ?? 0;
-
-        var waterData = await lastValueFrom(
-          this.sensorDataService.fetchWaterDataRange(
-            `water${i}`,
-            startDate.toISOString().slice(0, 10),
-            endDate.toISOString().slice(0, 10)
-          )
-        );
-
-        if (waterData === undefined) {
-          throw new Error('Unable to fetch data for waterData.');
-        }
-
-        for (let j = 0; j < waterData.length; j++) {
-          let date = waterData[j]?.timestamp?.slice(8, 10);
-          if (date?.slice(0, 1) === '0') date = date.slice(1, 2); // Silly fix
-          if (date !== undefined) {
-            let usage = waterData[j]?.water;
-            if (usage) {
-              this.waterFetchedUsage[i - 1].push(usage - lastUsage);
-              waterFetchedUsageData[date] += usage - lastUsage;
-              lastUsage = usage;
-            }
-          }
-        }
-      }
-
-      for (let i = 0; i < 30; i++) {
-        this.waterChartData[i] = waterFetchedUsageData[this.chartLabels[i]];
-      }
-    } catch (error) {
-      console.error('Error while building data for water chart: ', error);
     }
   }
 }
@@ -0,0 +1,26 @@
+export interface BatchRequest {
+  sensors: { elec?: string[]; water?: string[] };
+  dates?: string[];
+  start_date?: string;
+  end_date?: string;
+}
+
+export interface LatestValue {
+  value: number;
+  timestamp: string;
+}
+
+export interface LatestByType {
+  elec: { [sensorId: string]: LatestValue };
+  water: { [sensorId: string]: LatestValue };
+}
+
+export interface BatchData {
+  latest: LatestByType;
+  at: { [date: string]: LatestByType };
+  daily?: {
+    days: string[];
+    elec?: { [sensorId: string]: number[] };
+    water?: { [sensorId: string]: number[] };
+  };
+}
@@ -0,0 +1,8 @@
+// Compact update pushed by the backend as soon as a reading is ingested
+export interface LiveReading {
+  t: 'water' | 'elec';
+  s: string;
+  n: string;
+  v: number;
+  ts: number;
+}
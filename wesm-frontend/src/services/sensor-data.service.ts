@@ -2,6 +2,9 @@ import { HttpClient, HttpParams } from '@angular/common/http';
 import { inject, Injectable } from '@angular/core';
 import { ElecData } from '../interfaces/elec-data';
 import { WaterData } from '../interfaces/water-data';
+import { BatchData, BatchRequest } from '../interfaces/batch-data';
+import { LiveReading } from '../interfaces/live-reading';
+import { Observable } from 'rxjs';
 
 @Injectable({
   providedIn: 'root',
@@ -56,5 +59,22 @@ export class SensorDataService {
     });
   }
 
+  // Latest values (now and at given dates) plus per-day usage deltas for many
+  // sensors in a single request.
+  fetchBatch(request: BatchRequest) {
+    return this.http.post<BatchData>(`${this.baseUrl}/batch`, request);
+  }
+
+  // Server-Sent Events stream of new readings; closes when unsubscribed
+  liveUpdates(): Observable<LiveReading> {
+    return new Observable<LiveReading>((subscriber) => {
+      const source = new EventSource(`${this.baseUrl}/live`);
+      source.addEventListener('reading', (event) => {
+        subscriber.next(JSON.parse((event as MessageEvent).data));
+      });
+      return () => source.close();
+    });
+  }
+
   constructor() {}
 }